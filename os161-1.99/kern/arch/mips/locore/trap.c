@@ -185,14 +185,33 @@ mips_trap(struct trapframe *tf)
 			curthread->t_curspl = IPL_HIGH;
 			curthread->t_iplhigh_count++;
 			doadjust = true;
+#if OPT_IRQSTATS
+			spl_irqoff_begin();
+#endif
 		}
 		else {
 			doadjust = false;
 		}
 
+		/*
+		 * Charge user time up to now. This has to wait until
+		 * the spl state has been adjusted above, because
+		 * reading the clock does splhigh()/splx().
+		 */
+		if (!iskern) {
+			thread_account_user();
+		}
+
 		mainbus_interrupt(tf);
 
+		if (!iskern) {
+			thread_account_system();
+		}
+
 		if (doadjust) {
+#if OPT_IRQSTATS
+			spl_irqoff_end();
+#endif
 			KASSERT(curthread->t_curspl == IPL_HIGH);
 			KASSERT(curthread->t_iplhigh_count == 1);
 			curthread->t_iplhigh_count--;
@@ -217,6 +236,11 @@ mips_trap(struct trapframe *tf)
 	spl = splhigh();
 	splx(spl);
 
+	/* Coming from user mode, charge the time up to now as user time. */
+	if (!iskern) {
+		thread_account_user();
+	}
+
 	/* Syscall? Call the syscall handler and return. */
 	if (code == EX_SYS) {
 		/* Interrupts should have been on while in user mode. */
@@ -320,6 +344,11 @@ mips_trap(struct trapframe *tf)
 	panic("I can't handle this... I think I'll just die now...\n");
 
  done:
+	/* Going back to user mode; charge the time in here as system time. */
+	if (!iskern) {
+		thread_account_system();
+	}
+
 	/*
 	 * Turn interrupts off on the processor, without affecting the
 	 * stored interrupt state.
@@ -380,6 +409,10 @@ mips_usermode(struct trapframe *tf)
 	 * above, we explicitly call spl0() and then call cpu_irqoff().
 	 */
 	spl0();
+
+	/* Charge the time since we last did so as system time. */
+	thread_account_system();
+
 	cpu_irqoff();
 
 	cputhreads[curcpu->c_number] = (vaddr_t)curthread;
@@ -35,6 +35,14 @@
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <addrspace.h>
+#include <endian.h>
+#include <copyinout.h>
+#include "opt-A2.h"
+#include "opt-systrace.h"
+#if OPT_SYSTRACE
+#include <systrace.h>
+#endif
 
 
 /*
@@ -81,12 +89,25 @@ syscall(struct trapframe *tf)
 	int callno;
 	int32_t retval;
 	int err;
+#if OPT_A2
+	uint64_t pos64;
+	off_t retval64;
+	bool is64;
+	int whence;
+	userptr_t uptr;
+#endif
+#if OPT_SYSTRACE
+	struct systrace_call sc;
+#endif
 
 	KASSERT(curthread != NULL);
 	KASSERT(curthread->t_curspl == 0);
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+#if OPT_SYSTRACE
+	systrace_enter(&sc, callno, tf);
+#endif
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -98,6 +119,10 @@ syscall(struct trapframe *tf)
 	 */
 
 	retval = 0;
+#if OPT_A2
+	/* set for calls that return 64 bits, in retval64 */
+	is64 = false;
+#endif
 
 	switch (callno) {
 	    case SYS_reboot:
@@ -108,6 +133,20 @@ syscall(struct trapframe *tf)
 		err = sys___time((userptr_t)tf->tf_a0,
 				 (userptr_t)tf->tf_a1);
 		break;
+
+	    case SYS_setaffinity:
+		err = sys_setaffinity(tf->tf_a0);
+		break;
+
+	    case SYS_futex_wait:
+		err = sys_futex_wait((userptr_t)tf->tf_a0, tf->tf_a1,
+				     tf->tf_a2);
+		break;
+
+	    case SYS_futex_wake:
+		err = sys_futex_wake((userptr_t)tf->tf_a0, tf->tf_a1,
+				     &retval);
+		break;
 #ifdef UW
 	case SYS_write:
 	  err = sys_write((int)tf->tf_a0,
@@ -123,12 +162,141 @@ syscall(struct trapframe *tf)
 	case SYS_getpid:
 	  err = sys_getpid((pid_t *)&retval);
 	  break;
+#if OPT_A2
+	case SYS_fork:
+	  err = sys_fork(tf, (pid_t *)&retval);
+	  break;
+	case SYS_vfork:
+	  err = sys_vfork(tf, (pid_t *)&retval);
+	  break;
+	case SYS_execv:
+	  err = sys_execv((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+	  break;
+	case SYS_open:
+	  err = sys_open((userptr_t)tf->tf_a0,
+			 (int)tf->tf_a1,
+			 (mode_t)tf->tf_a2,
+			 (int *)(&retval));
+	  break;
+	case SYS_read:
+	  err = sys_read((int)tf->tf_a0,
+			 (userptr_t)tf->tf_a1,
+			 (int)tf->tf_a2,
+			 (int *)(&retval));
+	  break;
+	case SYS_pread:
+	case SYS_pwrite:
+	  /* the offset is on the stack, since a2 is taken */
+	  err = copyin((const_userptr_t)(tf->tf_sp + 16), &pos64,
+		       sizeof(pos64));
+	  if (err) {
+	    break;
+	  }
+	  if (callno == SYS_pread) {
+	    err = sys_pread((int)tf->tf_a0,
+			    (userptr_t)tf->tf_a1,
+			    (int)tf->tf_a2,
+			    (off_t)pos64,
+			    (int *)(&retval));
+	  }
+	  else {
+	    err = sys_pwrite((int)tf->tf_a0,
+			     (userptr_t)tf->tf_a1,
+			     (int)tf->tf_a2,
+			     (off_t)pos64,
+			     (int *)(&retval));
+	  }
+	  break;
+	case SYS_readv:
+	  err = sys_readv((int)tf->tf_a0,
+			  (userptr_t)tf->tf_a1,
+			  (int)tf->tf_a2,
+			  (int *)(&retval));
+	  break;
+	case SYS_writev:
+	  err = sys_writev((int)tf->tf_a0,
+			   (userptr_t)tf->tf_a1,
+			   (int)tf->tf_a2,
+			   (int *)(&retval));
+	  break;
+	case SYS_lseek:
+	  /* the offset is in a2/a3; whence is on the stack */
+	  join32to64(tf->tf_a2, tf->tf_a3, &pos64);
+	  err = copyin((const_userptr_t)(tf->tf_sp + 16), &whence,
+		       sizeof(whence));
+	  if (err) {
+	    break;
+	  }
+	  err = sys_lseek((int)tf->tf_a0, (off_t)pos64, whence, &retval64);
+	  is64 = true;
+	  break;
+	case SYS_close:
+	  err = sys_close((int)tf->tf_a0);
+	  break;
+	case SYS_dup2:
+	  err = sys_dup2((int)tf->tf_a0,
+			 (int)tf->tf_a1,
+			 (int *)(&retval));
+	  break;
+	case SYS_pipe:
+	  err = sys_pipe((userptr_t)tf->tf_a0);
+	  break;
+	case SYS_ioctl:
+	  err = sys_ioctl((int)tf->tf_a0,
+			  (int)tf->tf_a1,
+			  (userptr_t)tf->tf_a2);
+	  break;
+	case SYS_fsync:
+	  err = sys_fsync((int)tf->tf_a0);
+	  break;
+	case SYS_select:
+	  /* the timeout is the fifth argument, so on the stack */
+	  err = copyin((const_userptr_t)(tf->tf_sp + 16), &uptr,
+		       sizeof(uptr));
+	  if (err) {
+	    break;
+	  }
+	  err = sys_select((int)tf->tf_a0,
+			   (userptr_t)tf->tf_a1,
+			   (userptr_t)tf->tf_a2,
+			   (userptr_t)tf->tf_a3,
+			   uptr,
+			   (int *)(&retval));
+	  break;
+	case SYS_poll:
+	  err = sys_poll((userptr_t)tf->tf_a0,
+			 (unsigned)tf->tf_a1,
+			 (int)tf->tf_a2,
+			 (int *)(&retval));
+	  break;
+	case SYS_aring_setup:
+	  err = sys_aring_setup((userptr_t)tf->tf_a0,
+				(userptr_t)tf->tf_a1,
+				(userptr_t)tf->tf_a2,
+				(unsigned)tf->tf_a3);
+	  break;
+	case SYS_aring_enter:
+	  err = sys_aring_enter((unsigned)tf->tf_a0,
+				(int *)(&retval));
+	  break;
+#endif // OPT_A2
 	case SYS_waitpid:
 	  err = sys_waitpid((pid_t)tf->tf_a0,
 			    (userptr_t)tf->tf_a1,
 			    (int)tf->tf_a2,
 			    (pid_t *)&retval);
 	  break;
+	case SYS_wait4:
+	  err = sys_wait4((pid_t)tf->tf_a0,
+			  (userptr_t)tf->tf_a1,
+			  (int)tf->tf_a2,
+			  (userptr_t)tf->tf_a3,
+			  (pid_t *)&retval);
+	  break;
+	case SYS_getrusage:
+	  err = sys_getrusage((int)tf->tf_a0,
+			      (userptr_t)tf->tf_a1);
+	  break;
 #endif // UW
 
 	    /* Add stuff here */
@@ -149,11 +317,22 @@ syscall(struct trapframe *tf)
 		tf->tf_v0 = err;
 		tf->tf_a3 = 1;      /* signal an error */
 	}
+#if OPT_A2
+	else if (is64) {
+		/* Success, with a 64-bit value in v0 (high) and v1 (low). */
+		split64to32(retval64, &tf->tf_v0, &tf->tf_v1);
+		tf->tf_a3 = 0;      /* signal no error */
+	}
+#endif
 	else {
 		/* Success. */
 		tf->tf_v0 = retval;
 		tf->tf_a3 = 0;      /* signal no error */
 	}
+
+#if OPT_SYSTRACE
+	systrace_exit(&sc, tf);
+#endif
 	
 	/*
 	 * Now, advance the program counter, to avoid restarting
@@ -171,13 +350,22 @@ syscall(struct trapframe *tf)
 /*
  * Enter user mode for a newly forked process.
  *
- * This function is provided as a reminder. You need to write
- * both it and the code that calls it.
- *
- * Thus, you can trash it and do things another way if you prefer.
+ * TF is a copy of the parent's trapframe from the fork system call,
+ * which must be on the child's own stack (see mips_usermode). The
+ * child returns 0 from fork, without error, at the instruction after
+ * the syscall. The child's address space must already be in place.
  */
 void
 enter_forked_process(struct trapframe *tf)
 {
+#if OPT_A2
+	tf->tf_v0 = 0;
+	tf->tf_a3 = 0;
+	tf->tf_epc += 4;
+
+	as_activate();
+	mips_usermode(tf);
+#else
 	(void)tf;
+#endif
 }
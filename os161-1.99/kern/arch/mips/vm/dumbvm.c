@@ -433,14 +433,17 @@ as_destroy(struct addrspace *as)
 	// allocated to a user program, we need to:
 	
 	// STEP 1: Free all pages pointed by the PTEs
-	for (unsigned int i = 0; i < as->as_npages1; ++i) {
+	for (unsigned int i = 0; as->as_table1 != NULL && i < as->as_npages1; ++i) {
 		free_kpages(PADDR_TO_KVADDR(as->as_table1[i].addr));
 	}
-	for (unsigned int i = 0; i < as->as_npages2; ++i) {
+	for (unsigned int i = 0; as->as_table2 != NULL && i < as->as_npages2; ++i) {
 		free_kpages(PADDR_TO_KVADDR(as->as_table2[i].addr));
 	}
-	for (unsigned int i = 0; i < DUMBVM_STACKPAGES; ++i) {
-		free_kpages(PADDR_TO_KVADDR(as->as_stacktable[i].addr));
+	if (as->as_stacktable != NULL) {
+		/* (it has none if as_movestack took it away) */
+		for (unsigned int i = 0; i < DUMBVM_STACKPAGES; ++i) {
+			free_kpages(PADDR_TO_KVADDR(as->as_stacktable[i].addr));
+		}
 	}
 
 	// STEP 2: Free the PTEs in kernel space
@@ -529,6 +532,27 @@ as_zero_region(paddr_t paddr, unsigned npages)
 	bzero((void *)PADDR_TO_KVADDR(paddr), npages * PAGE_SIZE);
 }
 
+#ifdef OPT_A3
+/*
+ * Undo as_prepare_load's page table allocations after it runs out of
+ * memory, leaving AS safe to pass to as_destroy. A stack that came
+ * from as_movestack stays, so it can be moved back.
+ */
+static
+void
+as_unprepare(struct addrspace *as, bool newstack)
+{
+	kfree(as->as_table1);
+	as->as_table1 = NULL;
+	kfree(as->as_table2);
+	as->as_table2 = NULL;
+	if (newstack) {
+		kfree(as->as_stacktable);
+		as->as_stacktable = NULL;
+	}
+}
+#endif // OPT_A3
+
 int
 as_prepare_load(struct addrspace *as)
 {
@@ -538,6 +562,7 @@ as_prepare_load(struct addrspace *as)
 	struct PTE *table1, *table2, *stacktable;  // quick aliases for allocated tables
 	size_t npages1, npages2;                   // quick aliases for page sizes
 	paddr_t paddr;                             // temp var
+	bool newstack;                             // not from as_movestack
 
 	// Set up three page tables in kernel addrspace for managing the three 
 	// segments (code, data, stack) in user addrspace of the program
@@ -547,13 +572,18 @@ as_prepare_load(struct addrspace *as)
 	}
 	table2 = as->as_table2 = kmalloc(sizeof(struct PTE) * (npages2 = as->as_npages2));
 	if (table2 == NULL) {
-		kfree(table1);
+		as_unprepare(as, false);
 		return ENOMEM;
 	}
-	stacktable = as->as_stacktable = kmalloc(sizeof(struct PTE) * DUMBVM_STACKPAGES);
-	if (stacktable == NULL) {
-		kfree(table1); kfree(table2);
-		return ENOMEM;
+	// The stack may already be there, from as_movestack
+	stacktable = as->as_stacktable;
+	newstack = (stacktable == NULL);
+	if (newstack) {
+		stacktable = as->as_stacktable = kmalloc(sizeof(struct PTE) * DUMBVM_STACKPAGES);
+		if (stacktable == NULL) {
+			as_unprepare(as, false);
+			return ENOMEM;
+		}
 	}
 
 	// Build up three page tables by allocating physical frames from the coremap
@@ -561,7 +591,7 @@ as_prepare_load(struct addrspace *as)
 		paddr =  getppages(1);
 		if (paddr == 0) {
 			// TODO: FREE PREVIOUSLY ALLOCATED PAGES
-			kfree(table1); kfree(table2); kfree(stacktable);
+			as_unprepare(as, newstack);
 			return ENOMEM;
 		}
 		as_zero_region(paddr, 1);
@@ -571,17 +601,17 @@ as_prepare_load(struct addrspace *as)
 		paddr =  getppages(1);
 		if (paddr == 0) {
 			// TODO: FREE PREVIOUSLY ALLOCATED PAGES
-			kfree(table1); kfree(table2); kfree(stacktable);
+			as_unprepare(as, newstack);
 			return ENOMEM;
 		}
 		as_zero_region(paddr, 1);
 		table2[i].addr = paddr;
 	}
-	for (unsigned int i = 0; i < DUMBVM_STACKPAGES; ++i) {
+	for (unsigned int i = 0; newstack && i < DUMBVM_STACKPAGES; ++i) {
 		paddr =  getppages(1);
 		if (paddr == 0) {
 			// TODO: FREE PREVIOUSLY ALLOCATED PAGES
-			kfree(table1); kfree(table2); kfree(stacktable);
+			as_unprepare(as, newstack);
 			return ENOMEM;
 		}
 		as_zero_region(paddr, 1);
@@ -591,7 +621,6 @@ as_prepare_load(struct addrspace *as)
 #else
 	KASSERT(as->as_pbase1 == 0);
 	KASSERT(as->as_pbase2 == 0);
-	KASSERT(as->as_stackpbase == 0);
 
 	as->as_pbase1 = getppages(as->as_npages1);
 	if (as->as_pbase1 == 0) {
@@ -603,14 +632,17 @@ as_prepare_load(struct addrspace *as)
 		return ENOMEM;
 	}
 
-	as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+	/* The stack may already be there, from as_movestack. */
 	if (as->as_stackpbase == 0) {
-		return ENOMEM;
+		as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+		if (as->as_stackpbase == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
 	}
 	
 	as_zero_region(as->as_pbase1, as->as_npages1);
 	as_zero_region(as->as_pbase2, as->as_npages2);
-	as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
 #endif // OPT_A3
 
 	return 0;
@@ -640,6 +672,28 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * Give FROM's stack pages to TO, which mustn't have any yet. execv
+ * uses this to recycle the old program's stack for the new one: it
+ * saves allocating and zeroing the pages, and the old contents are
+ * the same process's anyway.
+ */
+void
+as_movestack(struct addrspace *to, struct addrspace *from)
+{
+#ifdef OPT_A3
+	KASSERT(to->as_stacktable == NULL);
+	KASSERT(from->as_stacktable != NULL);
+	to->as_stacktable = from->as_stacktable;
+	from->as_stacktable = NULL;
+#else
+	KASSERT(to->as_stackpbase == 0);
+	KASSERT(from->as_stackpbase != 0);
+	to->as_stackpbase = from->as_stackpbase;
+	from->as_stackpbase = 0;
+#endif // OPT_A3
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
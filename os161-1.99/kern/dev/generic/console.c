@@ -52,6 +52,8 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <thread.h>
@@ -194,6 +196,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 		
 	V(cs->cs_rsem);
+	pollq_wakeup(&cs->cs_pollq);
 }
 
 /*
@@ -360,6 +363,26 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Readable once a character has come in. Output doesn't wait for
+ * long, so it's always writable.
+ */
+static
+int
+con_poll(struct device *dev, int events, struct poller *pl, int *revents)
+{
+	struct con_softc *cs = dev->d_data;
+
+	(void)events;
+
+	poller_add(pl, &cs->cs_pollq);
+	*revents = POLLOUT;
+	if (cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+		*revents |= POLLIN;
+	}
+	return 0;
+}
+
 static
 int
 attach_console_to_vfs(struct con_softc *cs)
@@ -376,6 +399,7 @@ attach_console_to_vfs(struct con_softc *cs)
 	dev->d_close = con_close;
 	dev->d_io = con_io;
 	dev->d_ioctl = con_ioctl;
+	dev->d_poll = con_poll;
 	dev->d_blocks = 0;
 	dev->d_blocksize = 1;
 	dev->d_data = cs;
@@ -441,6 +465,7 @@ config_con(struct con_softc *cs, int unit)
 	cs->cs_wsem = wsem; 
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	pollq_init(&cs->cs_pollq);
 
 	the_console = cs;
 	con_userlock_read = rlk;
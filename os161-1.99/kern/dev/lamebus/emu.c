@@ -118,7 +118,23 @@ emu_wreg(struct emu_softc *sc, uint32_t reg, uint32_t val)
 }
 
 /*
- * Called by the underlying bus code when an interrupt happens
+ * Wake up the thread waiting for an operation. Deferred from the
+ * interrupt handler to the work queue.
+ */
+static
+void
+emu_done_work(void *dev)
+{
+	struct emu_softc *sc = dev;
+
+	V(sc->e_sem);
+}
+
+/*
+ * Called by the underlying bus code when an interrupt happens.
+ * Collect the result and acknowledge; the wakeup is done later.
+ * Operations are serialized by e_lock, so the work item is never
+ * queued twice.
  */
 void
 emu_irq(void *dev)
@@ -128,7 +144,7 @@ emu_irq(void *dev)
 	sc->e_result = emu_rreg(sc, REG_RESULT);
 	emu_wreg(sc, REG_RESULT, 0);
 
-	V(sc->e_sem);
+	work_queue(&sc->e_work);
 }
 
 /*
@@ -1092,6 +1108,7 @@ static const struct vnode_ops emufs_fileops = {
 	emufs_mmap,
 	emufs_truncate,
 	emufs_uio_op_notdir, /* namefile */
+	vnode_poll_ready,
 
 	emufs_creat_notdir,
 	emufs_symlink_notdir,
@@ -1127,6 +1144,7 @@ static const struct vnode_ops emufs_dirops = {
 	emufs_void_op_isdir,  /* mmap */
 	emufs_truncate_isdir,
 	emufs_namefile,
+	vnode_poll_ready,
 
 	emufs_creat,
 	emufs_symlink,
@@ -1334,7 +1352,7 @@ config_emu(struct emu_softc *sc, int emuno)
 {
 	char name[32];
 
-	sc->e_lock = lock_create("emufs-lock");
+	sc->e_lock = lock_create_flags("emufs-lock", LOCK_ADAPTIVE);
 	if (sc->e_lock == NULL) {
 		return ENOMEM;
 	}
@@ -1344,6 +1362,7 @@ config_emu(struct emu_softc *sc, int emuno)
 		sc->e_lock = NULL;
 		return ENOMEM;
 	}
+	work_init(&sc->e_work, emu_done_work, sc);
 	sc->e_iobuf = bus_map_area(sc->e_busdata, sc->e_buspos, EMU_BUFFER);
 
 	snprintf(name, sizeof(name), "emu%d", emuno);
@@ -30,6 +30,7 @@
 #ifndef _LAMEBUS_EMU_H_
 #define _LAMEBUS_EMU_H_
 
+#include <workqueue.h>
 
 #define EMU_MAXIO       16384
 #define EMU_ROOTHANDLE  0
@@ -53,6 +54,7 @@ struct emu_softc {
 
 	/* Written by the interrupt handler */
 	uint32_t e_result;
+	struct work e_work;		/* Wakeup, deferred from irq */
 };
 
 /* Functions called by lower-level drivers */
@@ -95,15 +95,29 @@ int lhd_code_to_errno(struct lhd_softc *lh, int code)
 }
 
 /*
- * Record that an I/O has completed: save the result and poke the
- * completion semaphore.
+ * Deferred part of I/O completion: poke the completion semaphore.
+ * Runs from the work queue, not in the interrupt handler.
+ */
+static
+void
+lhd_iodone_work(void *vlh)
+{
+	struct lhd_softc *lh = vlh;
+
+	V(lh->lh_done);
+}
+
+/*
+ * Record that an I/O has completed: save the result and arrange for
+ * the waiter to be woken. There's only ever one I/O outstanding
+ * (lh_clear sees to that) so the work item can't be queued twice.
  */
 static
 void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
 	lh->lh_result = err;
-	V(lh->lh_done);
+	work_queue(&lh->lh_work);
 }
 
 /*
@@ -300,12 +314,14 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 		lh->lh_clear = NULL;
 		return ENOMEM;
 	}
+	work_init(&lh->lh_work, lhd_iodone_work, lh);
 
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_open = lhd_open;
 	lh->lh_dev.d_close = lhd_close;
 	lh->lh_dev.d_io = lhd_io;
 	lh->lh_dev.d_ioctl = lhd_ioctl;
+	lh->lh_dev.d_poll = NULL;
 	lh->lh_dev.d_blocks = bus_read_register(lh->lh_busdata, lh->lh_buspos,
 						LHD_REG_NSECT);
 	lh->lh_dev.d_blocksize = LHD_SECTSIZE;
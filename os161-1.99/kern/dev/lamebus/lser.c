@@ -43,14 +43,52 @@
 #define LSER_IRQ_ENABLE  1
 #define LSER_IRQ_ACTIVE  2
 
+/*
+ * Hand what the interrupt handler collected to the higher-level
+ * driver. This runs from the work queue, so the console's wakeups
+ * happen with interrupts on.
+ */
+static
+void
+lser_work(void *vsc)
+{
+	struct lser_softc *sc = vsc;
+	char buf[LSER_INBUFSIZE];
+	unsigned i, n;
+	bool start;
+
+	spinlock_acquire(&sc->ls_lock);
+	sc->ls_workqueued = false;
+	start = sc->ls_startpending;
+	sc->ls_startpending = false;
+	for (n = 0; sc->ls_intail != sc->ls_inhead; n++) {
+		buf[n] = sc->ls_inbuf[sc->ls_intail];
+		sc->ls_intail = (sc->ls_intail + 1) % LSER_INBUFSIZE;
+	}
+	spinlock_release(&sc->ls_lock);
+
+	if (start && sc->ls_start != NULL) {
+		sc->ls_start(sc->ls_devdata);
+	}
+	if (sc->ls_input != NULL) {
+		for (i = 0; i < n; i++) {
+			sc->ls_input(sc->ls_devdata, buf[i]);
+		}
+	}
+}
+
+/*
+ * Interrupt handler: acknowledge the hardware, stash any input, and
+ * queue the rest of the work.
+ */
 void
 lser_irq(void *vsc)
 {
 	struct lser_softc *sc = vsc;
 	uint32_t x;
-	bool clear_to_write = false;
-	bool got_a_read = false;
-	uint32_t ch = 0;
+	uint32_t ch;
+	unsigned nexthead;
+	bool queue = false;
 
 	spinlock_acquire(&sc->ls_lock);
 
@@ -58,7 +96,7 @@ lser_irq(void *vsc)
 	if (x & LSER_IRQ_ACTIVE) {
 		x = LSER_IRQ_ENABLE;
 		sc->ls_wbusy = 0;
-		clear_to_write = true;
+		sc->ls_startpending = true;
 		bus_write_register(sc->ls_busdata, sc->ls_buspos,
 				   LSER_REG_WIRQ, x);
 	}
@@ -68,18 +106,26 @@ lser_irq(void *vsc)
 		x = LSER_IRQ_ENABLE;
 		ch = bus_read_register(sc->ls_busdata, sc->ls_buspos,
 				       LSER_REG_CHAR);
-		got_a_read = true;
 		bus_write_register(sc->ls_busdata, sc->ls_buspos, 
 				   LSER_REG_RIRQ, x);
+		nexthead = (sc->ls_inhead + 1) % LSER_INBUFSIZE;
+		if (nexthead != sc->ls_intail) {
+			sc->ls_inbuf[sc->ls_inhead] = ch;
+			sc->ls_inhead = nexthead;
+		}
+		/* else overflow; drop character */
+	}
+
+	if ((sc->ls_startpending || sc->ls_inhead != sc->ls_intail) &&
+	    !sc->ls_workqueued) {
+		sc->ls_workqueued = true;
+		queue = true;
 	}
 
 	spinlock_release(&sc->ls_lock);
 
-	if (clear_to_write && sc->ls_start != NULL) {
-		sc->ls_start(sc->ls_devdata);
-	}
-	if (got_a_read && sc->ls_input != NULL) {
-		sc->ls_input(sc->ls_devdata, ch);
+	if (queue) {
+		work_queue(&sc->ls_work);
 	}
 }
 
@@ -191,6 +237,10 @@ config_lser(struct lser_softc *sc, int lserno)
 
 	spinlock_init(&sc->ls_lock);
 	sc->ls_wbusy = false;
+	work_init(&sc->ls_work, lser_work, sc);
+	sc->ls_workqueued = false;
+	sc->ls_startpending = false;
+	sc->ls_inhead = sc->ls_intail = 0;
 
 	bus_write_register(sc->ls_busdata, sc->ls_buspos,
 			   LSER_REG_RIRQ, LSER_IRQ_ENABLE);
@@ -31,12 +31,27 @@
 #define _LAMEBUS_LSER_H_
 
 #include <spinlock.h>
+#include <workqueue.h>
+
+/* Input characters held for the work queue */
+#define LSER_INBUFSIZE 32
 
 struct lser_softc {
 	/* Initialized by config function */
 	struct spinlock ls_lock;    /* protects ls_wbusy and device regs */
 	volatile bool ls_wbusy;     /* true if write in progress */
 
+	/*
+	 * Work deferred from the interrupt handler; also protected
+	 * by ls_lock.
+	 */
+	struct work ls_work;
+	bool ls_workqueued;         /* ls_work is on a queue */
+	bool ls_startpending;       /* need to call ls_start */
+	unsigned ls_inhead;         /* next slot to put input in */
+	unsigned ls_intail;         /* next input to hand up */
+	char ls_inbuf[LSER_INBUFSIZE];
+
 	/* Initialized by lower-level attachment function */
 	void *ls_busdata;
 	uint32_t ls_buspos;
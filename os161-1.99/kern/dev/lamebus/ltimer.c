@@ -48,6 +48,8 @@
 
 static bool havetimerclock;
 
+static void ltimer_work(void *vlt);
+
 /*
  * Setup routine called by autoconf stuff when an ltimer is found.
  */
@@ -80,6 +82,11 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 	(void)ltimerno;
 	lt->lt_hardclock = 0;
 
+	spinlock_init(&lt->lt_lock);
+	lt->lt_ticks = 0;
+	lt->lt_workqueued = false;
+	work_init(&lt->lt_work, ltimer_work, lt);
+
 	/*
 	 * We do, however, use ltimer for the timer clock, since the
 	 * on-chip timer can't do that.
@@ -98,6 +105,29 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 	return 0;
 }
 
+/*
+ * Call timerclock() once for each tick the interrupt handler saw.
+ * This runs from the work queue; timerclock() wakes up everything
+ * sleeping on lbolt, which is too much to do with interrupts off.
+ */
+static
+void
+ltimer_work(void *vlt)
+{
+	struct ltimer_softc *lt = vlt;
+	unsigned ticks;
+
+	spinlock_acquire(&lt->lt_lock);
+	ticks = lt->lt_ticks;
+	lt->lt_ticks = 0;
+	lt->lt_workqueued = false;
+	spinlock_release(&lt->lt_lock);
+
+	while (ticks-- > 0) {
+		timerclock();
+	}
+}
+
 /*
  * Interrupt handler.
  */
@@ -106,6 +136,7 @@ ltimer_irq(void *vlt)
 {
 	struct ltimer_softc *lt = vlt;
 	uint32_t val;
+	bool queue;
 
 	val = bus_read_register(lt->lt_bus, lt->lt_buspos, LT_REG_IRQ);
 	if (val) {
@@ -117,10 +148,19 @@ ltimer_irq(void *vlt)
 			hardclock();
 		}
 		/*
-		 * Likewise for timerclock.
+		 * Likewise for timerclock, which is deferred. If the
+		 * work is already queued (perhaps on another cpu),
+		 * just count the tick.
 		 */
 		if (lt->lt_timerclock) {
-			timerclock();
+			spinlock_acquire(&lt->lt_lock);
+			lt->lt_ticks++;
+			queue = !lt->lt_workqueued;
+			lt->lt_workqueued = true;
+			spinlock_release(&lt->lt_lock);
+			if (queue) {
+				work_queue(&lt->lt_work);
+			}
 		}
 	}
 }
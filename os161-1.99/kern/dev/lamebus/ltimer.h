@@ -30,6 +30,9 @@
 #ifndef _LAMEBUS_LTIMER_H_
 #define _LAMEBUS_LTIMER_H_
 
+#include <spinlock.h>
+#include <workqueue.h>
+
 /*
  * Hardware device data for LAMEbus timer device
  */
@@ -38,6 +41,12 @@ struct ltimer_softc {
 	int lt_hardclock;        /* true if we should call hardclock() */
 	int lt_timerclock;        /* true if we should call timerclock() */
 
+	/* timerclock() calls deferred from the interrupt handler */
+	struct spinlock lt_lock;  /* protects the next two */
+	unsigned lt_ticks;        /* timerclock() calls owed */
+	bool lt_workqueued;       /* lt_work is on a queue */
+	struct work lt_work;
+
 	/* Initialized by lower-level attach routine */
 	void *lt_bus;		/* bus we're on */
 	uint32_t lt_buspos;	/* position (slot) on that bus */
@@ -1594,6 +1594,7 @@ static const struct vnode_ops sfs_fileops = {
 	sfs_mmap,
 	sfs_truncate,
 	NOTDIR,  /* namefile */
+	vnode_poll_ready,
 
 	NOTDIR,  /* creat */
 	NOTDIR,  /* symlink */
@@ -1629,6 +1630,7 @@ static const struct vnode_ops sfs_dirops = {
 	ISDIR,   /* mmap */
 	ISDIR,   /* truncate */
 	sfs_namefile,
+	vnode_poll_ready,
 
 	sfs_creat,
 	UNIMP,   /* symlink */
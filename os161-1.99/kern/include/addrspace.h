@@ -111,6 +111,10 @@ struct addrspace {
  *    as_define_stack - set up the stack region in the address space.
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
+ *
+ *    as_movestack - move the stack pages of one address space to
+ *                another that has none yet (which as_prepare_load
+ *                then doesn't allocate). Used by execv.
  */
 
 struct addrspace *as_create(void);
@@ -127,6 +131,8 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+void              as_movestack(struct addrspace *to,
+                               struct addrspace *from);
 
 
 /*
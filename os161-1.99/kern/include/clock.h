@@ -42,6 +42,9 @@
  * timed operations. (This is a fairly simpleminded interface.)
  *
  * gettime() may be used to fetch the current time of day.
+ * gettime_nsecs() returns the same thing as a single count of
+ * nanoseconds, for timestamps; it returns 0 before the clock device
+ * has attached instead of panicking.
  * getinterval() computes the time from time1 to time2.
  *
  * XXX we have struct timespec now, let's use it.
@@ -62,6 +65,7 @@ void hardclock(void);
 void timerclock(void);
 
 void gettime(time_t *seconds, uint32_t *nanoseconds);
+uint64_t gettime_nsecs(void);
 
 void getinterval(time_t secs1, uint32_t nsecs,
                  time_t secs2, uint32_t nsecs2,
@@ -83,5 +87,38 @@ void clocksleep(int seconds);
  */
 void clocknap(int ticks);
 
+/*
+ * Timeouts: call a function once some number of timer ticks (the
+ * same ticks as clocknap) have gone by. The function is called from
+ * timerclock, which runs on the timer's work queue thread, so it
+ * mustn't sleep; it should just do something quick like waking a
+ * thread up. The struct timeout belongs to the caller and can be on
+ * its stack, as long as it isn't left pending.
+ *
+ *     timeout_init   - set up TO to call FUNC(DATA).
+ *     timeout_add    - make TO go off TICKS ticks from now (at least
+ *                      one). It must not already be pending.
+ *     timeout_cancel - stop TO if it hasn't gone off yet. Returns true
+ *                      if it was stopped, false if it had already
+ *                      gone off. Either way, FUNC is not running when
+ *                      this returns and won't be called again; if it
+ *                      was running, this sleeps until it's done, so
+ *                      don't call it from an interrupt handler.
+ *     timeout_nsecs2ticks - how many ticks cover NSECS nanoseconds,
+ *                      rounded up so a wait is never cut short.
+ */
+struct timeout {
+	struct timeout *to_next;	/* link on the pending list */
+	uint64_t to_when;		/* tick it's due on */
+	void (*to_func)(void *);	/* what to call */
+	void *to_data;			/* argument for to_func */
+	bool to_pending;		/* on the pending list */
+};
+
+void timeout_init(struct timeout *to, void (*func)(void *), void *data);
+void timeout_add(struct timeout *to, unsigned ticks);
+bool timeout_cancel(struct timeout *to);
+unsigned timeout_nsecs2ticks(uint64_t nsecs);
+
 
 #endif /* _CLOCK_H_ */
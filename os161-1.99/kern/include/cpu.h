@@ -33,7 +33,12 @@
 
 #include <spinlock.h>
 #include <threadlist.h>
+#include <histogram.h>
+#include <cpucounter.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
+#include "opt-irqstats.h"
+
+struct work;
 
 
 /*
@@ -60,6 +65,42 @@ struct cpu {
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
+	struct wchan *c_migrate_wchan;	/* Migration thread sleeps here */
+#if OPT_IRQSTATS
+	uint64_t c_irqoff_stamp;	/* When interrupts last went off */
+	uint64_t c_irqoff_max;		/* Longest time they stayed off */
+	unsigned c_irqoff_count;	/* Times they went off */
+#endif
+
+	/*
+	 * Accessed only by this cpu, but protected by the runqueue
+	 * lock because threads are put here in thread_switch.
+	 */
+	struct threadlist c_migrating;	/* Threads waiting to leave */
+	struct histogram c_schedlat;	/* Run queue wait times (ns) */
+
+	/*
+	 * Deferred work queue (see workqueue.h). Accessed only by this
+	 * cpu, including from interrupt handlers, so protected by its
+	 * own spinlock.
+	 */
+	struct work *c_work_head;
+	struct work *c_work_tail;
+	struct spinlock c_work_lock;
+	struct wchan *c_work_wchan;	/* Worker thread sleeps here */
+
+	/*
+	 * Event counters (see cpucounter.h). Written only by this cpu,
+	 * with interrupts off; read by other cpus without locking.
+	 */
+	volatile unsigned long c_counters[CPUCOUNTER_MAX];
+
+	/*
+	 * RCU state (see rcu.h). Written only by this cpu, with
+	 * interrupts off; read by rcu_synchronize on other cpus.
+	 */
+	volatile unsigned c_rcu_qs;	/* Quiescent states passed */
+	volatile bool c_rcu_online;	/* Started; can hold read sections */
 
 	/*
 	 * Accessed by other cpus.
@@ -170,4 +211,13 @@ void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
 void interprocessor_interrupt(void);
 
 
+#if OPT_IRQSTATS
+/*
+ * Print the longest time each cpu has had interrupts off, and how
+ * many times they went off; then clear the numbers if RESET is set.
+ */
+void cpu_printirqstats(bool reset);
+#endif
+
+
 #endif /* _CPU_H_ */
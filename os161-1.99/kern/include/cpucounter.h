@@ -0,0 +1,37 @@
+#ifndef _CPUCOUNTER_H_
+#define _CPUCOUNTER_H_
+
+/*
+ * Per-cpu event counters.
+ *
+ * Each cpu has an array of CPUCOUNTER_MAX counters in its struct cpu.
+ * Bumping one touches only the current cpu's copy, with interrupts
+ * off for the moment it takes, so there's no lock and no shared cache
+ * line on the fast path. Reading a counter adds up all the cpus'
+ * copies; that's done without locking, so a sum taken while other
+ * cpus are counting is a snapshot and may be a hair behind.
+ *
+ * Users reserve a block of counters once (e.g. one per statistic
+ * they keep) and then refer to them by index.
+ *
+ * Functions:
+ *     cpucounter_alloc - reserve N consecutive counters and return the
+ *                        index of the first. Panics if they run out.
+ *     cpucounter_add   - add VAL to counter IDX on this cpu.
+ *     cpucounter_inc   - add 1.
+ *     cpucounter_sum   - total of counter IDX over all cpus.
+ *     cpucounter_zero  - zero counter IDX on all cpus. Counts that
+ *                        happen at the same time can be lost.
+ */
+
+#define CPUCOUNTER_MAX 64
+
+unsigned cpucounter_alloc(unsigned n);
+void cpucounter_add(unsigned idx, unsigned long val);
+unsigned long cpucounter_sum(unsigned idx);
+void cpucounter_zero(unsigned idx);
+
+#define cpucounter_inc(idx) cpucounter_add(idx, 1)
+
+
+#endif /* _CPUCOUNTER_H_ */
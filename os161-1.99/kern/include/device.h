@@ -36,16 +36,20 @@
 
 
 struct uio;  /* in <uio.h> */
+struct poller;  /* in <poll.h> */
 
 /*
  * Filesystem-namespace-accessible device.
  * d_io is for both reads and writes; the uio indicates the direction.
+ * d_poll is vop_poll for the device; it's NULL if I/O never blocks.
  */
 struct device {
 	int (*d_open)(struct device *, int flags_from_open);
 	int (*d_close)(struct device *);
 	int (*d_io)(struct device *, struct uio *);
 	int (*d_ioctl)(struct device *, int op, userptr_t data);
+	int (*d_poll)(struct device *, int events, struct poller *pl,
+		      int *revents);
 
 	blkcnt_t d_blocks;
 	blksize_t d_blocksize;
@@ -0,0 +1,81 @@
+#ifndef _FILE_H_
+#define _FILE_H_
+
+/*
+ * Open files and per-process file tables.
+ *
+ * An openfile is what open() makes: a vnode, the open flags, and the
+ * seek position. It's shared, with a reference count, by every
+ * descriptor that refers to it, whether through dup2 or fork. The
+ * seek position is protected by of_offsetlock, a sleep lock held
+ * across the I/O, so that two reads or writes on one open file each
+ * get their own part of it. Files that can't seek (the console,
+ * pipes) have no position and skip the lock.
+ *
+ * A filetable maps a process's descriptors to openfiles. It has its
+ * own spinlock, and each openfile has a spinlock for its reference
+ * count, so looking up a descriptor on the read/write path touches
+ * nothing shared with other processes (except an openfile they share
+ * with us). A lookup hands back a reference, so the openfile stays
+ * valid even if another thread closes the descriptor meanwhile.
+ *
+ * Openfile functions:
+ *     openfile_create  - make an openfile for VN, which it takes over
+ *                        the caller's reference to, opened with FLAGS.
+ *     openfile_incref  - add a reference.
+ *     openfile_decref  - drop a reference; the last one closes the vnode.
+ *
+ * Filetable functions:
+ *     filetable_create  - make an empty table.
+ *     filetable_destroy - close everything and free the table.
+ *     filetable_copy    - copy a table, for fork.
+ *     filetable_get     - look up FD; hands back a reference to the
+ *                         openfile, or fails with EBADF.
+ *     filetable_place   - put an openfile in the lowest free descriptor.
+ *                         Takes over the caller's reference.
+ *     filetable_placeat - put an openfile at FD, handing back what was
+ *                         there before (or NULL). Takes over the
+ *                         caller's reference, and hands one back.
+ *     filetable_remove  - take FD out of the table, handing back its
+ *                         openfile (and the table's reference to it).
+ *     filetable_opencons - open the console as stdin, stdout and
+ *                         stderr, for a new program.
+ */
+
+#include <limits.h>
+#include <spinlock.h>
+
+struct vnode;
+struct lock;
+
+struct openfile {
+	struct vnode *of_vnode;
+	int of_flags;			/* O_ACCMODE and O_APPEND bits */
+	bool of_seekable;
+	struct lock *of_offsetlock;	/* NULL if not seekable */
+	off_t of_offset;		/* protected by of_offsetlock */
+	struct spinlock of_reflock;
+	unsigned of_refcount;		/* protected by of_reflock */
+};
+
+struct filetable {
+	struct spinlock ft_lock;
+	struct openfile *ft_files[OPEN_MAX];	/* protected by ft_lock */
+};
+
+int openfile_create(struct vnode *vn, int flags, struct openfile **ret);
+void openfile_incref(struct openfile *of);
+void openfile_decref(struct openfile *of);
+
+struct filetable *filetable_create(void);
+void filetable_destroy(struct filetable *ft);
+int filetable_copy(struct filetable *ft, struct filetable **ret);
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_place(struct filetable *ft, struct openfile *of, int *fd);
+int filetable_placeat(struct filetable *ft, struct openfile *of, int fd,
+		      struct openfile **oldof);
+int filetable_remove(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_opencons(struct filetable *ft);
+
+
+#endif /* _FILE_H_ */
@@ -0,0 +1,38 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+/*
+ * Log2 histogram, for latencies and the like.
+ *
+ * Bucket N counts values in [2^N, 2^(N+1)); bucket 0 also gets 0,
+ * and the last bucket gets everything too big for the others. Values
+ * are nanoseconds as far as hist_print is concerned, but nothing else
+ * cares.
+ *
+ * There is no locking; a histogram is meant to be embedded in
+ * something (e.g. struct cpu) whose lock covers it. To print one
+ * under a spinlock, copy it out first, since kprintf may sleep.
+ *
+ * Functions:
+ *     hist_init  - zero a histogram.
+ *     hist_add   - count one value.
+ *     hist_merge - add the counts in one histogram to another.
+ *     hist_print - print the non-empty buckets, with a bar graph.
+ */
+
+#define HIST_BUCKETS 32
+
+struct histogram {
+	uint32_t h_count[HIST_BUCKETS];	/* counts per bucket */
+	uint32_t h_total;		/* number of values */
+	uint64_t h_sum;			/* sum of values, for the mean */
+	uint64_t h_max;			/* largest value */
+};
+
+void hist_init(struct histogram *h);
+void hist_add(struct histogram *h, uint64_t value);
+void hist_merge(struct histogram *to, const struct histogram *from);
+void hist_print(const struct histogram *h);
+
+
+#endif /* _HISTOGRAM_H_ */
@@ -0,0 +1,70 @@
+#ifndef _KERN_ARING_H_
+#define _KERN_ARING_H_
+
+/*
+ * Definitions for aring_setup and aring_enter, which let a process
+ * queue up reads, writes, opens, closes and fsyncs in its own memory
+ * and have the kernel run a whole batch of them for one trap.
+ *
+ * The process sets aside a struct aring and two arrays of ENTRIES
+ * (a power of two) submission and completion entries, zeroes the
+ * header, and registers them with aring_setup. To make calls it fills
+ * in submission entries at sq[ar_sqtail % ENTRIES] and moves ar_sqtail
+ * on, then calls aring_enter. The kernel runs the entries from
+ * ar_sqhead on, in order, and puts one completion for each at
+ * cq[ar_cqtail % ENTRIES]; the process takes those from ar_cqhead
+ * and moves it on. The counters run freely and wrap.
+ *
+ * The kernel never writes more completions than there is room for;
+ * entries it doesn't get to because the completion ring is full are
+ * left for the next aring_enter. If the completion ring can't be
+ * written, aring_enter still moves ar_sqhead past the entries it ran
+ * (they aren't run twice), but not ar_cqtail, and their results are
+ * lost.
+ */
+
+/* Largest ring aring_setup will take */
+#define ARING_MAXENTRIES  1024
+
+/* Submission entry operations */
+#define ARING_OP_NOP      0	/* Nothing; just completes. */
+#define ARING_OP_READ     1	/* read(fd, buf, len) */
+#define ARING_OP_WRITE    2	/* write(fd, buf, len) */
+#define ARING_OP_OPEN     3	/* open(buf, len, mode) */
+#define ARING_OP_CLOSE    4	/* close(fd) */
+#define ARING_OP_FSYNC    5	/* fsync(fd) */
+
+/* Submission entry flags */
+#define ARING_F_POS       1	/* read/write at off, like pread/pwrite */
+
+struct aring_sqe {
+	__u64 sqe_data;		/* handed back in the completion */
+	__u64 sqe_off;		/* file position, with ARING_F_POS */
+#ifdef _KERNEL
+	userptr_t sqe_buf;	/* read/write: buffer; open: path */
+#else
+	void *sqe_buf;		/* read/write: buffer; open: path */
+#endif
+	__u32 sqe_len;		/* read/write: length; open: flags */
+	__i32 sqe_fd;		/* file, for everything but open */
+	__u16 sqe_op;		/* ARING_OP_* */
+	__u16 sqe_flags;	/* ARING_F_* */
+	__u32 sqe_mode;		/* open: mode */
+};
+
+struct aring_cqe {
+	__u64 cqe_data;		/* sqe_data from the submission */
+	__i32 cqe_res;		/* what the call returned, or -errno */
+	__u32 cqe_unused;
+};
+
+struct aring {
+	/* Written by the kernel */
+	__u32 ar_sqhead;	/* next submission to run */
+	__u32 ar_cqtail;	/* where the next completion goes */
+	/* Written by the process */
+	__u32 ar_sqtail;	/* end of the submissions */
+	__u32 ar_cqhead;	/* next completion to look at */
+};
+
+#endif /* _KERN_ARING_H_ */
@@ -34,6 +34,16 @@
  * ioctl operation codes
  */
 
-/* (none yet) */
+/*
+ * For the systrace: device (see kern/systrace.h). The buffer for
+ * SYSTRACE_IOC_STATS is struct systrace_stat[SYSTRACE_NSYS]; for
+ * SYSTRACE_IOC_LOST it's an unsigned int, which gets the number of
+ * trace records dropped because nobody read them in time.
+ */
+#define SYSTRACE_IOC_TRACE    1	/* Trace the caller and its new children. */
+#define SYSTRACE_IOC_UNTRACE  2	/* Stop tracing the caller. */
+#define SYSTRACE_IOC_STATS    3	/* Get per-call statistics. */
+#define SYSTRACE_IOC_RESET    4	/* Zero the statistics. */
+#define SYSTRACE_IOC_LOST     5	/* Get (and zero) the lost record count. */
 
 #endif /* _KERN_IOCTL_H_*/
@@ -0,0 +1,54 @@
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+/*
+ * Definitions for poll() and select().
+ *
+ * FD_SETSIZE needs __OPEN_MAX from <kern/limits.h>.
+ */
+
+/* One descriptor to poll. */
+struct pollfd {
+	int fd;			/* descriptor; negative means skip it */
+	short events;		/* what to wait for */
+	short revents;		/* what happened */
+};
+
+/*
+ * Bits for events and revents. The last three are only ever returned,
+ * whether asked for or not.
+ */
+#define POLLIN     0x0001	/* Data can be read without blocking. */
+#define POLLPRI    0x0002	/* Urgent data can be read. */
+#define POLLOUT    0x0004	/* Data can be written without blocking. */
+#define POLLERR    0x0008	/* Error, e.g. pipe with no reader left. */
+#define POLLHUP    0x0010	/* Hangup, e.g. pipe with no writer left. */
+#define POLLNVAL   0x0020	/* Not an open descriptor. */
+
+/*
+ * Descriptor sets for select(), with one bit for each possible
+ * descriptor.
+ */
+#define FD_SETSIZE  __OPEN_MAX
+#define __NFDBITS   32
+#define __NFDWORDS  ((FD_SETSIZE + __NFDBITS - 1) / __NFDBITS)
+
+typedef struct {
+	__u32 fds_bits[__NFDWORDS];
+} fd_set;
+
+#define FD_SET(fd, s)   ((s)->fds_bits[(fd) / __NFDBITS] |= \
+			 (__u32)1 << ((fd) % __NFDBITS))
+#define FD_CLR(fd, s)   ((s)->fds_bits[(fd) / __NFDBITS] &= \
+			 ~((__u32)1 << ((fd) % __NFDBITS)))
+#define FD_ISSET(fd, s) (((s)->fds_bits[(fd) / __NFDBITS] >> \
+			  ((fd) % __NFDBITS)) & 1)
+#define FD_ZERO(s)      do {						\
+				unsigned __i;				\
+				for (__i = 0; __i < __NFDWORDS; __i++) { \
+					(s)->fds_bits[__i] = 0;		\
+				}					\
+			} while (0)
+
+
+#endif /* _KERN_POLL_H_ */
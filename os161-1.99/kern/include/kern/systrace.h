@@ -0,0 +1,44 @@
+#ifndef _KERN_SYSTRACE_H_
+#define _KERN_SYSTRACE_H_
+
+/*
+ * Definitions for the systrace: device, which reports system call
+ * statistics and traces (kernels built with options systrace). The
+ * ioctl codes are in <kern/ioctl.h>.
+ */
+
+/* System call numbers are all below this. */
+#define SYSTRACE_NSYS      128
+
+/* Buckets in a latency histogram; bucket N is [2^N, 2^(N+1)) ns. */
+#define SYSTRACE_BUCKETS   32
+
+/*
+ * One traced system call. Reading systrace: hands back as many of
+ * these as fit, oldest first, removing them from the kernel's buffer.
+ */
+struct systrace_rec {
+	__u64 sr_start;		/* when it was made, in ns since boot */
+	__pid_t sr_pid;		/* who made it */
+	__u32 sr_callno;	/* SYS_* */
+	__u32 sr_args[4];	/* a0-a3 */
+	__i32 sr_retval;	/* what it returned, if it worked */
+	__i32 sr_error;		/* errno, or 0 if it worked */
+	__u32 sr_nsecs;		/* how long it took */
+	__u32 sr_unused;
+};
+
+/*
+ * Statistics for one system call, summed over all cpus. The
+ * SYSTRACE_IOC_STATS ioctl copies out an array of SYSTRACE_NSYS of
+ * these, indexed by call number.
+ */
+struct systrace_stat {
+	__u32 ss_count;		/* calls that returned */
+	__u32 ss_errors;	/* ...with an error */
+	__u64 ss_totalns;	/* total time in them */
+	__u64 ss_maxns;		/* longest */
+	__u32 ss_hist[SYSTRACE_BUCKETS];	/* latency histogram */
+};
+
+#endif /* _KERN_SYSTRACE_H_ */
@@ -0,0 +1,61 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock contention statistics (options lockstat).
+ *
+ * Spinlocks, sleep locks and semaphores each embed a struct lockstat
+ * when the kernel is built with lockstat. It counts acquisitions,
+ * how many of those had to wait, how many times a spinlock spun,
+ * the total time spent waiting, and the longest time the lock was
+ * held (not tracked for semaphores, which have no holder).
+ *
+ * The counters are updated while holding the lock being counted (or,
+ * for sleep locks and semaphores, their internal spinlock). Every
+ * lockstat is also on a global list so the menu can find the worst
+ * offenders; spinlocks declared with SPINLOCK_INITIALIZER join the
+ * list the first time they are acquired.
+ *
+ * Functions:
+ *     lockstat_init     - set up and list a lockstat. Calling it again
+ *                         on one already listed just zeroes it.
+ *     lockstat_cleanup  - take a lockstat off the list.
+ *     lockstat_acquired - count an acquisition. CONTENDED says whether
+ *                         we had to wait, and if so WAITSTART is when
+ *                         we started to; SPINS is how many times we
+ *                         went around a spin loop.
+ *     lockstat_released - count the end of a hold.
+ *     lockstat_print    - print the N locks with the most wait time,
+ *                         and maybe zero all the counters.
+ */
+
+#define LOCKSTAT_SPIN	0	/* spinlock */
+#define LOCKSTAT_LOCK	1	/* sleep lock */
+#define LOCKSTAT_SEM	2	/* semaphore */
+
+struct lockstat {
+	struct lockstat *ls_self;	/* points to itself iff listed */
+	struct lockstat *ls_prev;	/* global list */
+	struct lockstat *ls_next;
+	const char *ls_name;		/* owner's name, or NULL */
+	unsigned ls_kind;		/* LOCKSTAT_* */
+	unsigned ls_acquires;		/* number of acquisitions */
+	unsigned ls_contended;		/* ...that had to wait */
+	uint64_t ls_spins;		/* spin loop iterations */
+	uint64_t ls_waitns;		/* total time waited */
+	uint64_t ls_maxhold;		/* longest hold */
+	uint64_t ls_holdstart;		/* when the current hold began */
+};
+
+#define LOCKSTAT_INITIALIZER \
+	{ NULL, NULL, NULL, NULL, LOCKSTAT_SPIN, 0, 0, 0, 0, 0, 0 }
+
+void lockstat_init(struct lockstat *ls, unsigned kind, const char *name);
+void lockstat_cleanup(struct lockstat *ls);
+void lockstat_acquired(struct lockstat *ls, bool contended,
+		       uint64_t spins, uint64_t waitstart);
+void lockstat_released(struct lockstat *ls);
+void lockstat_print(unsigned n, bool reset);
+
+
+#endif /* _LOCKSTAT_H_ */
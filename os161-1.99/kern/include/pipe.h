@@ -0,0 +1,20 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Pipes.
+ *
+ * pipe_create makes a pipe and hands back two vnodes for it, one to
+ * read from and one to write to. They're already open (as if by
+ * vfs_open, with O_RDONLY and O_WRONLY), so the caller just wraps
+ * them in openfiles; vfs_close gets rid of them as usual. Reading
+ * after the last writer has gone away gets end of file, and writing
+ * after the last reader has gone away fails with EPIPE.
+ */
+
+struct vnode;
+
+int pipe_create(struct vnode **readvn, struct vnode **writevn);
+
+
+#endif /* _PIPE_H_ */
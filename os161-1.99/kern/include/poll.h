@@ -0,0 +1,67 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Kernel support for poll() and select().
+ *
+ * Anything a thread can wait on with poll (a pipe end, the console)
+ * has a pollq, a queue of the pollers interested in it. A thread
+ * polling several objects makes one poller and adds it to each
+ * object's pollq; when an object might have become ready, it calls
+ * pollq_wakeup, which wakes only the threads polling that object.
+ * Nobody has to look at every descriptor on every wakeup, and
+ * objects nobody is polling pay only for checking an empty list.
+ *
+ * An object's vop_poll reports which of the POLL* bits (see
+ * kern/poll.h) are true right now, and calls poller_add with the
+ * poller it was given, which may be NULL if the caller is already
+ * on the object's queue or doesn't want to wait. It should add itself
+ * before looking at its state, so a change in between isn't missed;
+ * a wakeup that turns out to be spurious just costs another look.
+ *
+ * Pollq functions:
+ *     pollq_init     - set up an empty queue.
+ *     pollq_cleanup  - tear it down. It must be empty.
+ *     pollq_wakeup   - wake everyone polling. May be called from an
+ *                      interrupt handler.
+ *
+ * Poller functions:
+ *     poller_init    - set up a poller with room for MAXQS queues.
+ *     poller_cleanup - take the poller off every queue and free it.
+ *     poller_add     - put the poller on PQ. Does nothing if PL is NULL.
+ *     poller_wait    - sleep until a queue the poller is on is woken
+ *                      (returning right away if that's already
+ *                      happened since the last poller_wait), or for
+ *                      at most TICKS timer ticks if TICKS isn't 0.
+ *                      Returns ETIMEDOUT if the time ran out.
+ */
+
+#include <spinlock.h>
+
+struct pollent;
+struct wchan;
+
+struct pollq {
+	struct spinlock pq_lock;
+	struct pollent *pq_head;	/* protected by pq_lock */
+};
+
+struct poller {
+	struct wchan *pl_wchan;
+	bool pl_woken;			/* protected by pl_wchan's lock */
+	struct pollent *pl_ents;	/* one for each queue we're on */
+	unsigned pl_nents;
+	unsigned pl_maxents;
+};
+
+void pollq_init(struct pollq *pq);
+void pollq_cleanup(struct pollq *pq);
+void pollq_wakeup(struct pollq *pq);
+
+int poller_init(struct poller *pl, unsigned maxqs);
+void poller_cleanup(struct poller *pl);
+void poller_add(struct poller *pl, struct pollq *pq);
+int poller_wait(struct poller *pl, unsigned ticks);
+
+
+#endif /* _POLL_H_ */
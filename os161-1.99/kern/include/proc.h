@@ -38,12 +38,19 @@
 
 #include <spinlock.h>
 #include <thread.h> /* required for struct threadarray */
+#include "opt-A2.h"
+#include "opt-systrace.h"
 
 struct addrspace;
 struct vnode;
 #ifdef UW
 struct semaphore;
 #endif // UW
+#if OPT_A2
+struct cv;
+struct filetable;
+struct aringreg;
+#endif
 
 /*
  * Process structure.
@@ -59,6 +66,38 @@ struct proc {
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
 
+	/* Cpu usage (protected by p_lock) */
+	struct cputimes p_times;	/* of threads that have left */
+	struct cputimes p_ctimes;	/* of children that have been reaped */
+
+#if OPT_A2
+	/*
+	 * Process table and family (protected by the process table
+	 * lock in proc.c). The children are a doubly linked list
+	 * through p_sibnext/p_sibprev so one can be unlinked without
+	 * a search.
+	 */
+	pid_t p_pid;			/* 0 for kproc */
+	struct proc *p_parent;		/* NULL if none, or it has exited */
+	struct proc *p_children;	/* Most recent child */
+	struct proc *p_sibnext;		/* Next (older) sibling */
+	struct proc *p_sibprev;		/* Previous (newer) sibling */
+	bool p_exited;			/* Has exited; waiting to be reaped */
+	int p_exitstatus;		/* Encoded as in <kern/wait.h> */
+	struct cv *p_waitcv;		/* Signalled when a child exits */
+	bool p_vforked;			/* p_addrspace is the parent's */
+
+	/* Open files (see file.h); NULL until the process runs a program */
+	struct filetable *p_files;
+
+	/* Batched syscall ring (see kern/aring.h), or NULL */
+	struct aringreg *p_aring;
+#endif
+
+#if OPT_SYSTRACE
+	bool p_systrace;		/* Record our syscalls (see systrace.h) */
+#endif
+
 #ifdef UW
   /* a vnode to refer to the console device */
   /* this is a quick-and-dirty way to get console writes working */
@@ -94,6 +133,47 @@ int proc_addthread(struct proc *proc, struct thread *t);
 /* Detach a thread from its process. */
 void proc_remthread(struct thread *t);
 
+/*
+ * Get the cpu usage of PROC so far: that of its threads, both exited
+ * and still running.
+ */
+void proc_gettimes(struct proc *proc, struct cputimes *ct);
+
+#if OPT_A2
+/* Make CHILD, which is new, a child of PARENT. */
+void proc_addchild(struct proc *parent, struct proc *child);
+
+/* Undo proc_addchild, if the child never got started. */
+void proc_remchild(struct proc *child);
+
+/*
+ * vfork: the parent waits in proc_vforkwait until the child, which
+ * is running in the parent's address space, calls proc_vforkdone
+ * (from execv or _exit) to say it no longer needs it.
+ */
+void proc_vforkwait(struct proc *child);
+void proc_vforkdone(struct proc *child);
+
+/*
+ * Called by the last thread of PROC, after proc_remthread, to make it
+ * exit with STATUS (encoded as in <kern/wait.h>). It's then either
+ * left for its parent to reap or destroyed right away.
+ */
+void proc_exit(struct proc *proc, int status);
+
+/*
+ * Wait for a child of the current process to exit, and reap it. PID
+ * is a child's pid or WAIT_ANY. Hands back the pid reaped (0 if
+ * WNOHANG was given and there wasn't one yet) and, if USAGE isn't
+ * NULL, its cpu usage (including its own reaped children's). The
+ * usage is added to curproc->p_ctimes either way. Unless STATUS is
+ * NULL, the exit status is copied out to it first; if that fails,
+ * the child isn't reaped and can still be waited for.
+ */
+int proc_wait(pid_t pid, int options, pid_t *retpid, userptr_t status,
+	      struct cputimes *usage);
+#endif
+
 /* Fetch the address space of the current process. */
 struct addrspace *curproc_getas(void);
 
@@ -0,0 +1,61 @@
+#ifndef _RCU_H_
+#define _RCU_H_
+
+/*
+ * Read-copy-update, for data that's read all the time and changed
+ * hardly ever (the VFS device list, the boot filesystem).
+ *
+ * Readers bracket their use of the data with rcu_read_lock and
+ * rcu_read_unlock, which take no lock and write nothing shared; they
+ * just turn interrupts off on this cpu, so the reader can't be
+ * switched away from. A read section must therefore be short and
+ * must not sleep (no lock_acquire, P, wchan_sleep, copyin, etc.),
+ * though spinlocks are fine. Pointers to protected data are fetched
+ * with rcu_dereference and can't be kept past rcu_read_unlock unless
+ * something else (e.g. a reference count taken inside the section)
+ * keeps the object alive.
+ *
+ * Writers serialize among themselves with an ordinary lock. To
+ * change something they build a new copy, publish it with
+ * rcu_assign_pointer, call rcu_synchronize, and then free the old
+ * copy. rcu_synchronize waits out a grace period: it returns once
+ * every other cpu has been through a quiescent state, a point where
+ * it can't be in a read section (a context switch or a timer
+ * interrupt), so no reader can still be looking at the old copy.
+ * It sleeps, usually for a timer tick or so, so writers pay for
+ * everything.
+ *
+ * Functions:
+ *     rcu_read_lock     - start a read section. Nests.
+ *     rcu_read_unlock   - end one.
+ *     rcu_read_held     - true if we're in a read section.
+ *     rcu_synchronize   - wait for all read sections in progress to end.
+ *     rcu_quiescent     - called by the thread code when this cpu
+ *                         passes a quiescent state.
+ *
+ * Macros:
+ *     rcu_dereference(p)      - fetch protected pointer P.
+ *     rcu_assign_pointer(p,v) - publish V in P. Everything written to
+ *                               *V beforehand is visible to a reader
+ *                               that sees V.
+ *
+ * System/161 cpus see each other's stores in order, so the macros
+ * only need to keep the compiler from reordering around them.
+ */
+
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+bool rcu_read_held(void);
+void rcu_synchronize(void);
+void rcu_quiescent(void);
+
+#define rcu_dereference(p) (*(volatile __typeof__(p) *)&(p))
+
+#define rcu_assign_pointer(p, v) \
+	do { \
+		__asm volatile("" ::: "memory"); \
+		*(volatile __typeof__(p) *)&(p) = (v); \
+	} while (0)
+
+
+#endif /* _RCU_H_ */
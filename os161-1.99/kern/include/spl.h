@@ -31,6 +31,7 @@
 #define _SPL_H_
 
 #include <cdefs.h>
+#include "opt-irqstats.h"
 
 /*
  * Machine-independent interface to interrupt enable/disable.
@@ -84,6 +85,17 @@ int splx(int);
 void splraise(int oldipl, int newipl);
 void spllower(int oldipl, int newipl);
 
+#if OPT_IRQSTATS
+/*
+ * Bracket a stretch of time with interrupts off, for the per-cpu
+ * maximum interrupts-off time. splraise and spllower do this
+ * themselves; these are for code that changes the hardware state
+ * behind their backs. See cpu_printirqstats in cpu.h.
+ */
+void spl_irqoff_begin(void);
+void spl_irqoff_end(void);
+#endif
+
 ////////////////////////////////////////////////////////////
 
 /* Inlining support - for making sure an out-of-line copy gets built */
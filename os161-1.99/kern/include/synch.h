@@ -42,15 +42,31 @@
  *
  * The name field is for easier debugging. A copy of the name is made
  * internally.
+ *
+ * A semaphore created with SEM_HANDOFF is strictly FIFO: V hands the
+ * count straight to the thread that has waited longest, instead of
+ * leaving it for whoever gets to it first, so a thread that has just
+ * arrived can't cut in front of one that was asleep.
  */
 struct semaphore {
         char *sem_name;
 	struct wchan *sem_wchan;
 	struct spinlock sem_lock;
         volatile int sem_count;
+	unsigned sem_flags;
+	unsigned sem_nwaiting;		/* threads asleep in P */
+	unsigned sem_handoffs;		/* V's handed to woken threads */
+#if OPT_LOCKSTAT
+	struct lockstat sem_stat;	/* protected by sem_lock */
+#endif
 };
 
+/* Flags for sem_create_flags */
+#define SEM_HANDOFF	0x1	/* FIFO; V hands off to the oldest waiter */
+
 struct semaphore *sem_create(const char *name, int initial_count);
+struct semaphore *sem_create_flags(const char *name, int initial_count,
+				   unsigned flags);
 void sem_destroy(struct semaphore *);
 
 /*
@@ -71,6 +87,24 @@ void V(struct semaphore *);
  *
  * The name field is for easier debugging. A copy of the name is
  * (should be) made internally.
+ *
+ * A lock created with LOCK_ADAPTIVE is adaptive: a thread that finds
+ * it held spins for a while, instead of going to sleep, as long as
+ * the holder is running on another cpu. This is for locks held over
+ * short critical sections, where a context switch costs more than
+ * the wait. lk_spins and lk_sleeps count acquisitions that had to
+ * spin and that had to sleep, respectively, so the effect can be seen.
+ *
+ * lock_release wakes the highest priority thread waiting for the
+ * lock, the one that has been asleep longest if there's a tie. A lock
+ * created with LOCK_HANDOFF, like a SEM_HANDOFF semaphore, gives the
+ * lock directly to that thread instead of letting it compete for it.
+ *
+ * Locks do priority inheritance: while a thread is asleep waiting for
+ * a lock, the holder runs at the waiter's priority if that's higher,
+ * and so on down a chain of holders blocked on other locks, up to
+ * LOCK_PI_MAXDEPTH of them. The boost lasts until the holder lets go
+ * of the lock(s) the higher priority threads are waiting for.
  */
 struct lock {
         char *lk_name;
@@ -80,9 +114,24 @@ struct lock {
         volatile struct thread *holder;
         struct spinlock spin;
         struct wchan *wc;
+        unsigned lk_flags;
+        unsigned lk_spins;              /* protected by spin */
+        unsigned lk_sleeps;             /* protected by spin */
+        unsigned lk_nwaiting;           /* protected by spin */
+        bool lk_handoff;                /* protected by spin */
+        struct thread *lk_piwaiters;    /* sleepers, for inheritance */
+        struct lock *lk_heldnext;       /* holder's t_heldlocks list */
+#if OPT_LOCKSTAT
+        struct lockstat lk_stat;        /* protected by spin */
+#endif
 };
 
+/* Flags for lock_create_flags */
+#define LOCK_ADAPTIVE   0x1     /* spin while the holder is running */
+#define LOCK_HANDOFF    0x2     /* release hands off to the thread it wakes */
+
 struct lock *lock_create(const char *name);
+struct lock *lock_create_flags(const char *name, unsigned flags);
 void lock_acquire(struct lock *);
 
 /*
@@ -100,6 +149,12 @@ void lock_release(struct lock *);
 bool lock_do_i_hold(struct lock *);
 void lock_destroy(struct lock *);
 
+/*
+ * Recompute the current thread's effective priority after its base
+ * priority changes. For thread_setpriority.
+ */
+void lock_pi_update(void);
+
 
 /*
  * Condition variable.
@@ -130,18 +185,89 @@ void cv_destroy(struct cv *);
  * Operations:
  *    cv_wait      - Release the supplied lock, go to sleep, and, after
  *                   waking up again, re-acquire the lock.
+ *    cv_timedwait - Same, but give up waiting after TICKS timer ticks
+ *                   (see clock.h). Returns 0 if woken up, ETIMEDOUT if
+ *                   the time ran out; the lock is held again either way.
  *    cv_signal    - Wake up one thread that's sleeping on this CV.
- *    cv_broadcast - Wake up all threads sleeping on this CV.
+ *    cv_broadcast - Wake up all threads sleeping on this CV. They're
+ *                   moved to the lock's queue and woken one at a time
+ *                   as the lock comes free, rather than all at once.
  *
- * For all three operations, the current thread must hold the lock passed 
- * in. Note that under normal circumstances the same lock should be used
- * on all operations with any particular CV.
+ * For all of these operations, the current thread must hold the lock
+ * passed in. Note that under normal circumstances the same lock should
+ * be used on all operations with any particular CV.
  *
  * These operations must be atomic. You get to write them.
  */
 void cv_wait(struct cv *cv, struct lock *lock);
+int cv_timedwait(struct cv *cv, struct lock *lock, unsigned ticks);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
 
 
+/*
+ * Reader-writer lock.
+ *
+ * Any number of readers may hold the lock at once, or one writer.
+ * Once a writer is waiting, new readers wait behind it, so writers
+ * are not starved; when a writer lets go, the readers that queued up
+ * meanwhile all get in before the next writer does.
+ *
+ * Readers are counted in per-cpu slots, each with its own spinlock
+ * and on its own cache line, so readers on different cpus do not
+ * write to any shared memory while no writer is around. A reader
+ * may release on a different cpu than it acquired on; only the sum
+ * over all slots means anything.
+ *
+ * The name field is for easier debugging. A copy of the name is made
+ * internally.
+ */
+
+#define RW_NSLOTS	8	/* cpus share slots beyond this many */
+#define RW_SLOTALIGN	64	/* cache line size to pad slots to */
+
+struct rwslot {
+	struct spinlock rs_lock;
+	volatile int rs_readers;
+	char rs_pad[RW_SLOTALIGN -
+		    (sizeof(struct spinlock) + sizeof(int)) % RW_SLOTALIGN];
+};
+
+struct rwlock {
+	char *rw_name;
+	struct spinlock rw_lock;	/* protects all below */
+	volatile bool rw_wactive;	/* a writer holds or is draining */
+	struct thread *rw_writer;	/* writer holding the lock */
+	bool rw_readturn;		/* waiting readers go first */
+	unsigned rw_rwaiting;		/* readers asleep on rw_rwchan */
+	struct wchan *rw_rwchan;	/* readers waiting for a writer */
+	struct wchan *rw_wwchan;	/* writers waiting for a writer */
+	struct wchan *rw_drainchan;	/* writer waiting for readers */
+	struct rwslot rw_slots[RW_NSLOTS];
+};
+
+struct rwlock *rwlock_create(const char *name);
+void rwlock_destroy(struct rwlock *);
+
+/*
+ * Operations:
+ *    rwlock_acquire_read  - Get the lock for reading.
+ *    rwlock_release_read  - Give up a read hold.
+ *    rwlock_acquire_write - Get the lock for writing.
+ *    rwlock_release_write - Give up a write hold.
+ *    rwlock_downgrade     - Turn a write hold into a read hold without
+ *                           letting any other writer in between.
+ *    rwlock_do_i_write    - Return true if the current thread holds
+ *                           the lock for writing.
+ *
+ * There is no upgrade; release the read hold and acquire for writing.
+ */
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+void rwlock_downgrade(struct rwlock *);
+bool rwlock_do_i_write(struct rwlock *);
+
+
 #endif /* _SYNCH_H_ */
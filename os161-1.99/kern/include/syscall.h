@@ -30,8 +30,10 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 
+#include "opt-A2.h"
 
 struct trapframe; /* from <machine/trapframe.h> */
+struct proc; /* from <proc.h> */
 
 /*
  * The system call dispatcher.
@@ -50,6 +52,9 @@ void enter_forked_process(struct trapframe *tf);
 void enter_new_process(int argc, userptr_t argv, vaddr_t stackptr,
 		       vaddr_t entrypoint);
 
+/* Set up the futex wait table (futex.c). */
+void futex_bootstrap(void);
+
 
 /*
  * Prototypes for IN-KERNEL entry points for system call implementations.
@@ -57,12 +62,53 @@ void enter_new_process(int argc, userptr_t argv, vaddr_t stackptr,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_setaffinity(unsigned mask);
+int sys_futex_wait(userptr_t addr, int val, int timeout);
+int sys_futex_wake(userptr_t addr, int n, int32_t *retval);
 
 #ifdef UW
 int sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval);
 void sys__exit(int exitcode);
 int sys_getpid(pid_t *retval);
 int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retval);
+int sys_wait4(pid_t pid, userptr_t status, int options, userptr_t usage,
+	      pid_t *retval);
+int sys_getrusage(int who, userptr_t usage);
+#if OPT_A2
+int sys_fork(struct trapframe *tf, pid_t *retval);
+int sys_vfork(struct trapframe *tf, pid_t *retval);
+int sys_execv(userptr_t progname, userptr_t args);
+
+/* The work of execv, shared with runprogram (runprogram.c). */
+int execprogram(userptr_t progname, userptr_t args);
+
+/* Print fork latency histograms (menu command). */
+void fork_printstats(bool reset);
+
+int sys_open(userptr_t path, int flags, mode_t mode, int *retval);
+int sys_read(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval);
+int sys_pread(int fdesc, userptr_t ubuf, unsigned int nbytes, off_t pos,
+	      int *retval);
+int sys_pwrite(int fdesc, userptr_t ubuf, unsigned int nbytes, off_t pos,
+	       int *retval);
+int sys_readv(int fdesc, userptr_t iov, int iovcnt, int *retval);
+int sys_writev(int fdesc, userptr_t iov, int iovcnt, int *retval);
+int sys_lseek(int fdesc, off_t pos, int whence, off_t *retval);
+int sys_close(int fdesc);
+int sys_dup2(int oldfd, int newfd, int *retval);
+int sys_pipe(userptr_t fds);
+int sys_ioctl(int fdesc, int code, userptr_t data);
+int sys_fsync(int fdesc);
+int sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	       userptr_t exceptfds, userptr_t timeout, int *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int *retval);
+int sys_aring_setup(userptr_t hdr, userptr_t sq, userptr_t cq,
+		    unsigned entries);
+int sys_aring_enter(unsigned tosubmit, int *retval);
+
+/* Forget a process's syscall ring, if it has one (aring.c). */
+void aring_unregister(struct proc *p);
+#endif // OPT_A2
 
 #endif // UW
 
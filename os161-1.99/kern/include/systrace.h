@@ -0,0 +1,54 @@
+#ifndef _SYSTRACE_H_
+#define _SYSTRACE_H_
+
+/*
+ * System call statistics and tracing (options systrace).
+ *
+ * syscall() brackets every call with systrace_enter and
+ * systrace_exit. Each cpu keeps, for every call number, a log2
+ * latency histogram (see histogram.h) and an error count; these are
+ * updated with interrupts off and no lock, and added up across cpus
+ * only when someone asks. A process with p_systrace set (which fork
+ * passes on) also gets a struct systrace_rec (see kern/systrace.h)
+ * for each of its calls, in a ring buffer shared by everyone; if
+ * nobody reads them in time the oldest are overwritten and counted
+ * as lost.
+ *
+ * Calls that don't come back to syscall() (_exit, and execv when it
+ * works) aren't counted. For calls with 64-bit results (lseek) the
+ * recorded return value is the high word.
+ *
+ * Everything can be read from userlevel through the systrace: device
+ * (see kern/systrace.h and kern/ioctl.h), or from the "st" menu
+ * command.
+ *
+ * Functions:
+ *     systrace_bootstrap - set up the statistics, trace buffer and
+ *                          device. Must come after thread_start_cpus;
+ *                          nothing is counted before it.
+ *     systrace_enter     - note the start of a call.
+ *     systrace_exit      - count the call and, if the process is
+ *                          traced, record it. TF must already hold
+ *                          the results.
+ *     systrace_print     - print per-call statistics, most total
+ *                          time first, with histograms if HIST, and
+ *                          maybe zero them.
+ */
+
+struct trapframe;
+
+/* What systrace_enter saves for systrace_exit. */
+struct systrace_call {
+	uint64_t sc_start;		/* from gettime_nsecs */
+	unsigned sc_callno;
+	uint32_t sc_args[4];		/* a0-a3 */
+};
+
+void systrace_bootstrap(void);
+void systrace_enter(struct systrace_call *sc, unsigned callno,
+		    const struct trapframe *tf);
+void systrace_exit(struct systrace_call *sc, const struct trapframe *tf);
+void systrace_print(bool hist, bool reset);
+
+
+#endif /* _SYSTRACE_H_ */
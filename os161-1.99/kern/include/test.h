@@ -30,6 +30,8 @@
 #ifndef _TEST_H_
 #define _TEST_H_
 
+#include "opt-A2.h"
+
 /*
  * Declarations for test code and other miscellaneous high-level
  * functions.
@@ -60,6 +62,11 @@ int threadtest3(int, char **);
 int semtest(int, char **);
 int locktest(int, char **);
 int cvtest(int, char **);
+int rwlocktest(int, char **);
+int spinlocktest(int, char **);
+int tailtest(int, char **);
+int pitest(int, char **);
+int cvwaketest(int, char **);
 
 #ifdef UW
 /* Another thread and synchronization test */
@@ -82,7 +89,11 @@ int mallocstress(int, char **);
 int nettest(int, char **);
 
 /* Routine for running a user-level program. */
+#if OPT_A2
+int runprogram(char *progname, int nargs, char **args);
+#else
 int runprogram(char *progname);
+#endif
 
 /* Kernel menu system. */
 void menu(char *argstr);
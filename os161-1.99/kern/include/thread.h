@@ -56,6 +56,33 @@ struct cpu;
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
 
+/*
+ * CPU affinity masks. Bit N is set if the thread may run on the cpu
+ * whose c_number is N. This limits us to 32 cpus, which is also the
+ * System/161 limit (see MAXCPUS).
+ */
+typedef uint32_t cpumask_t;
+
+#define CPUMASK_ALL		((cpumask_t)0xffffffff)
+#define CPUMASK_CPU(n)		((cpumask_t)1 << (n))
+#define CPUMASK_HAS(m, n)	(((m) & CPUMASK_CPU(n)) != 0)
+
+
+/*
+ * Accumulated cpu usage. Times are in nanoseconds. "Wait" time is
+ * time spent ready to run but sitting on a run queue. Sleeping to be
+ * woken is a voluntary context switch; being preempted (or yielding)
+ * is involuntary.
+ */
+struct cputimes {
+	uint64_t ct_utime;		/* time in user mode */
+	uint64_t ct_stime;		/* time in the kernel */
+	uint64_t ct_wtime;		/* time waiting to run */
+	unsigned ct_nvcsw;		/* voluntary context switches */
+	unsigned ct_nivcsw;		/* involuntary context switches */
+};
+
+
 /* States a thread can be in. */
 typedef enum {
 	S_RUN,		/* running */
@@ -82,6 +109,7 @@ struct thread {
 	void *t_stack;			/* Kernel-level stack */
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
+	cpumask_t t_affinity;		/* CPUs thread may run on */
 	struct proc *t_proc;		/* Process thread belongs to */
 
 	/*
@@ -100,6 +128,28 @@ struct thread {
 	bool t_in_interrupt;		/* Are we in an interrupt? */
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
+	int t_rcudepth;			/* RCU read section nesting (rcu.h) */
+
+	/*
+	 * Cpu time accounting fields. Only the thread itself updates
+	 * t_times and t_stamp; t_readystamp is set by whoever makes
+	 * the thread runnable, under the run queue lock.
+	 */
+	struct cputimes t_times;	/* Usage so far */
+	uint64_t t_stamp;		/* Start of current charging interval */
+	uint64_t t_readystamp;		/* When last put on a run queue */
+
+	/*
+	 * Scheduling priority. The scheduler goes by t_pri, which is
+	 * t_basepri unless priority inheritance has raised it; the
+	 * rest of these belong to the priority inheritance code in
+	 * synch.c and are protected by its lock.
+	 */
+	int t_basepri;			/* Priority set by thread_setpriority */
+	volatile int t_pri;		/* Effective priority */
+	struct lock *t_blockedon;	/* Lock we're asleep waiting for */
+	struct thread *t_piwaitnext;	/* Next waiter on t_blockedon */
+	struct lock *t_heldlocks;	/* Locks we hold (only we touch) */
 
 	/*
 	 * Public fields
@@ -144,6 +194,77 @@ int thread_fork(const char *name, struct proc *proc,
                 void (*func)(void *, unsigned long),
                 void *data1, unsigned long data2);
 
+/*
+ * Like thread_fork, in the caller's process, but the new thread is
+ * pinned to cpu C from the start. For per-cpu kernel threads.
+ */
+int thread_fork_oncpu(const char *name, struct cpu *c,
+		      void (*func)(void *, unsigned long),
+		      void *data1, unsigned long data2);
+
+/*
+ * Like thread_fork, but if a cpu the new thread may run on is idle,
+ * the new thread starts there instead of behind the caller. For
+ * fork(), where the child would otherwise wait for the parent.
+ */
+int thread_fork_idle(const char *name, struct proc *proc,
+		     void (*func)(void *, unsigned long),
+		     void *data1, unsigned long data2);
+
+/*
+ * Restrict thread T to the cpus in MASK. Returns EINVAL if MASK
+ * contains no cpu that exists. A thread that is not allowed on the
+ * cpu it is on moves the next time it yields or is woken up; if T is
+ * the current thread, that happens before thread_setaffinity returns.
+ * New threads inherit the affinity of the thread that forks them.
+ */
+int thread_setaffinity(struct thread *t, cpumask_t mask);
+
+/*
+ * Thread priorities. Higher numbers run first; threads of equal
+ * priority take turns. New threads get their parent's priority.
+ */
+#define PRI_MIN		0
+#define PRI_DEFAULT	16
+#define PRI_MAX		31
+
+/*
+ * Set the current thread's priority. It may still run higher than
+ * this for a while if it holds a lock a higher priority thread wants.
+ */
+void thread_setpriority(int pri);
+
+/*
+ * Thread T's t_pri has just been raised by someone else (priority
+ * inheritance). If T is waiting on a run queue, move it up to where
+ * it now belongs.
+ */
+void thread_reprioritize(struct thread *t);
+
+/*
+ * Number of cpus the system is running on.
+ */
+unsigned thread_numcpus(void);
+
+/*
+ * The cpu numbered N, for N < thread_numcpus().
+ */
+struct cpu *thread_getcpu(unsigned n);
+
+/*
+ * Cpu time accounting hooks for the trap code. thread_account_user()
+ * is called on entry to the kernel from user mode and charges the time
+ * since the last hook to user time; thread_account_system() is called
+ * on the way back out and charges the time in between to the kernel.
+ */
+void thread_account_user(void);
+void thread_account_system(void);
+
+/*
+ * Add the usage in FROM to TO.
+ */
+void cputimes_add(struct cputimes *to, const struct cputimes *from);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
@@ -168,5 +289,16 @@ void schedule(void);
  */
 void thread_consider_migration(void);
 
+/*
+ * Print the current thread and run queue of each cpu. For the menu.
+ */
+void thread_printrunqueues(void);
+
+/*
+ * Print the per-cpu histograms of scheduling latency (time from
+ * being made runnable to running), then clear them if RESET is set.
+ */
+void thread_printschedlat(bool reset);
+
 
 #endif /* _THREAD_H_ */
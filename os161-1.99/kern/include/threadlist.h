@@ -86,6 +86,9 @@ void threadlist_insertbefore(struct threadlist *tl,
 			     struct thread *addee, struct thread *onlist);
 void threadlist_remove(struct threadlist *tl, struct thread *t);
 
+/* Move all of FROM onto the end of TO, in constant time. */
+void threadlist_join(struct threadlist *to, struct threadlist *from);
+
 /* Iteration; itervar should previously be declared as (struct thread *) */
 #define THREADLIST_FORALL(itervar, tl) \
 	for ((itervar) = (tl).tl_head.tln_next->tln_self; \
@@ -18,6 +18,11 @@
  *
  * Generally you will use the functions whose names
  * do not begin with '_'.
+ *
+ * The counts are kept per cpu (see cpucounter.h), so vmstats_inc is
+ * cheap enough for the TLB miss path and takes no lock. Before
+ * vmstats_init they're kept in one plain array under stats_lock, so
+ * counting and printing work then too, just more slowly.
  */
 
 
@@ -40,7 +45,7 @@
 
 /* ----------------------------------------------------------------------- */
 
-/* Initialize the statistics: must be called before using */
+/* Initialize (or reset) the statistics */
 void vmstats_init(void);                     /* uses locking */
 void _vmstats_init(void);                    /* atomicity must be ensured elsewhere */
 
@@ -52,7 +57,7 @@ void _vmstats_init(void);                    /* atomicity must be ensured elsewh
 void vmstats_inc(unsigned int index);    /* uses locking */
 void _vmstats_inc(unsigned int index);   /* atomicity must be ensured elsewhere */
 
-/* Print the statistics: assumes that at least vmstats_init has been called */
+/* Print the statistics */
 void vmstats_print(void);                    /* Does NOT use locking */
 
 #endif /* VM_STATS_H */
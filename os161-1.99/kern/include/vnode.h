@@ -33,6 +33,7 @@
 
 struct uio;
 struct stat;
+struct poller;
 
 /*
  * A struct vnode is an abstract representation of a file.
@@ -147,6 +148,14 @@ struct vnode {
  *                      uio. Need not work on objects that are not
  *                      directories.
  *
+ *    vop_poll        - Report which of the POLL* conditions (see
+ *                      kern/poll.h) hold for the object right now,
+ *                      in REVENTS, and put the poller PL on the
+ *                      object's queue so a change wakes it up (see
+ *                      poll.h). EVENTS says what the caller cares
+ *                      about, if that makes a difference. Objects
+ *                      that never block can use vnode_poll_ready.
+ *
  *****************************************
  *
  *    vop_creat       - Create a regular file named NAME in the passed
@@ -212,6 +221,8 @@ struct vnode_ops {
 	int (*vop_mmap)(struct vnode *file /* add stuff */);
 	int (*vop_truncate)(struct vnode *file, off_t len);
 	int (*vop_namefile)(struct vnode *file, struct uio *uio);
+	int (*vop_poll)(struct vnode *object, int events,
+			struct poller *pl, int *revents);
 
 
 	int (*vop_creat)(struct vnode *dir, 
@@ -257,6 +268,7 @@ struct vnode_ops {
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
 #define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
 #define VOP_NAMEFILE(vn, uio)           (__VOP(vn, namefile)(vn, uio))
+#define VOP_POLL(vn, ev, pl, rev)       (__VOP(vn, poll)(vn, ev, pl, rev))
 
 #define VOP_CREAT(vn,nm,excl,mode,res)  (__VOP(vn, creat)(vn,nm,excl,mode,res))
 #define VOP_SYMLINK(vn, name, content)  (__VOP(vn, symlink)(vn, name, content))
@@ -312,5 +324,12 @@ void vnode_cleanup(struct vnode *);
 
 #define VOP_CLEANUP(vn)			vnode_cleanup(vn)
 
+/*
+ * vop_poll for objects that are always ready for I/O, like regular
+ * files and disks (intended for use by filesystem code).
+ */
+int vnode_poll_ready(struct vnode *vn, int events, struct poller *pl,
+		     int *revents);
+
 
 #endif /* _VNODE_H_ */
@@ -36,6 +36,7 @@
 
 
 struct wchan; /* Opaque */
+struct thread; /* from <thread.h> */
 
 /*
  * Create a wait channel. Use NAME as a symbolic name for the channel.
@@ -71,6 +72,13 @@ void wchan_unlock(struct wchan *wc);
  */
 void wchan_sleep(struct wchan *wc);
 
+/*
+ * Like wchan_sleep, but give up after TICKS timer ticks (see
+ * timeout_add in clock.h). Returns 0 if awakened, or ETIMEDOUT if
+ * the time ran out first.
+ */
+int wchan_timedsleep(struct wchan *wc, unsigned ticks);
+
 /*
  * Wake up one thread, or all threads, sleeping on a wait channel.
  * The queue should not already be locked.
@@ -81,5 +89,23 @@ void wchan_sleep(struct wchan *wc);
 void wchan_wakeone(struct wchan *wc);
 void wchan_wakeall(struct wchan *wc);
 
+/*
+ * Wake up the highest priority thread sleeping on a wait channel, the
+ * one that has been asleep longest if there's a tie. The queue should
+ * not already be locked.
+ */
+void wchan_wakepri(struct wchan *wc);
+
+/*
+ * Move all threads sleeping on FROM onto TO without waking them; they
+ * then wait to be awakened from TO instead. Neither channel should
+ * already be locked. FROM is locked first, so callers must agree on
+ * an order: nothing may ever requeue from TO back to FROM. If FUNC
+ * isn't NULL, it's called as FUNC(thread, DATA) for each thread moved,
+ * with both channels locked. Returns how many threads were moved.
+ */
+unsigned wchan_requeue(struct wchan *from, struct wchan *to,
+		       void (*func)(struct thread *, void *), void *data);
+
 
 #endif /* _WCHAN_H_ */
@@ -0,0 +1,43 @@
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Deferred work.
+ *
+ * Interrupt handlers should do as little as they can with interrupts
+ * off: talk to the hardware, and leave anything else (waking up
+ * threads, passing data up the stack) to a work item. work_queue()
+ * puts a work item on the current cpu's queue; each cpu has a worker
+ * thread, pinned to it, that runs the queued items' functions in
+ * order, in thread context with interrupts on.
+ *
+ * A work item must not be queued again before its function has been
+ * called. Callers that might try (e.g. a device that can interrupt
+ * again before the work is done) should keep track themselves,
+ * usually with a flag under their own lock that the work function
+ * clears. Work functions must not sleep for long, since they hold up
+ * everything else queued on that cpu.
+ *
+ * Functions:
+ *     work_init       - set up a work item to call FUNC(DATA).
+ *     work_queue      - queue a work item on the current cpu. May be
+ *                       called from an interrupt handler.
+ *     workqueue_start - start the worker thread for a cpu. Must be
+ *                       called before anything is queued there.
+ */
+
+struct cpu;
+
+struct work {
+	struct work *w_next;		/* link on the queue */
+	void (*w_func)(void *);		/* what to do */
+	void *w_data;			/* argument for w_func */
+	bool w_queued;			/* for sanity checking */
+};
+
+void work_init(struct work *w, void (*func)(void *), void *data);
+void work_queue(struct work *w);
+void workqueue_start(struct cpu *c);
+
+
+#endif /* _WORKQUEUE_H_ */
@@ -0,0 +1,116 @@
+/*
+ * Log2 histograms. See histogram.h for details.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <histogram.h>
+
+/* Width of the bar graph printed for the fullest bucket */
+#define HIST_BARWIDTH 40
+
+void
+hist_init(struct histogram *h)
+{
+	bzero(h, sizeof(*h));
+}
+
+void
+hist_add(struct histogram *h, uint64_t value)
+{
+	uint32_t v;
+	unsigned b;
+
+	if (value >> 32 != 0) {
+		b = HIST_BUCKETS - 1;
+	}
+	else {
+		b = 0;
+		for (v = value; v > 1; v >>= 1) {
+			b++;
+		}
+	}
+	h->h_count[b]++;
+	h->h_total++;
+	h->h_sum += value;
+	if (value > h->h_max) {
+		h->h_max = value;
+	}
+}
+
+void
+hist_merge(struct histogram *to, const struct histogram *from)
+{
+	unsigned i;
+
+	for (i=0; i<HIST_BUCKETS; i++) {
+		to->h_count[i] += from->h_count[i];
+	}
+	to->h_total += from->h_total;
+	to->h_sum += from->h_sum;
+	if (from->h_max > to->h_max) {
+		to->h_max = from->h_max;
+	}
+}
+
+/*
+ * Print a bucket bound (a power of two, in nanoseconds) in sensible
+ * units.
+ */
+static
+void
+hist_printbound(unsigned b)
+{
+	uint32_t ns = (uint32_t)1 << b;
+
+	if (ns < 1000) {
+		kprintf("%6uns", ns);
+	}
+	else if (ns < 1000000) {
+		kprintf("%6uus", ns / 1000);
+	}
+	else {
+		kprintf("%6ums", ns / 1000000);
+	}
+}
+
+void
+hist_print(const struct histogram *h)
+{
+	unsigned i, j, first, last, bar;
+	uint32_t most;
+
+	if (h->h_total == 0) {
+		kprintf("    (no samples)\n");
+		return;
+	}
+
+	first = HIST_BUCKETS;
+	last = 0;
+	most = 0;
+	for (i=0; i<HIST_BUCKETS; i++) {
+		if (h->h_count[i] == 0) {
+			continue;
+		}
+		if (first == HIST_BUCKETS) {
+			first = i;
+		}
+		last = i;
+		if (h->h_count[i] > most) {
+			most = h->h_count[i];
+		}
+	}
+
+	for (i=first; i<=last; i++) {
+		kprintf("    ");
+		hist_printbound(i);
+		kprintf(" %10u ", h->h_count[i]);
+		bar = (uint64_t)h->h_count[i] * HIST_BARWIDTH / most;
+		for (j=0; j<bar; j++) {
+			kprintf("*");
+		}
+		kprintf("\n");
+	}
+	kprintf("    %u samples, mean %lluns, max %lluns\n",
+		h->h_total, h->h_sum / h->h_total, h->h_max);
+}
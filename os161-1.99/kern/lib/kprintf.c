@@ -64,7 +64,7 @@ kprintf_bootstrap(void)
 {
 	KASSERT(kprintf_lock == NULL);
 
-	kprintf_lock = lock_create("kprintf_lock");
+	kprintf_lock = lock_create_flags("kprintf_lock", LOCK_ADAPTIVE);
 	if (kprintf_lock == NULL) {
 		panic("Could not create kprintf_lock\n");
 	}
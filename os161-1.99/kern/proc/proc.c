@@ -43,12 +43,19 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/wait.h>
+#include <limits.h>
+#include <lib.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
 #include <vnode.h>
 #include <vfs.h>
 #include <synch.h>
+#include <copyinout.h>
+#include <file.h>
+#include <syscall.h>
 #include <kern/fcntl.h>  
 
 /*
@@ -69,7 +76,143 @@ static struct semaphore *proc_count_mutex;
 struct semaphore *no_proc_sem;   
 #endif  // UW
 
+#if OPT_A2
+/*
+ * Process table.
+ *
+ * A pid is a slot number plus a multiple of PROCTABLE_SIZE, so
+ * finding a process by pid is an array index and a comparison. Free
+ * slots are kept on a FIFO list, so allocating is constant time and
+ * takes the slot that has been free longest; and each time a slot is
+ * reused its pid goes up by PROCTABLE_SIZE, so a pid doesn't come
+ * back until the slot has gone all the way around the pid space.
+ *
+ * A slot stays in use until its proc is destroyed, which for a
+ * process with a parent is when the parent reaps it.
+ *
+ * proctable_lock covers the table and the family fields of every
+ * proc (p_pid through p_waitcv). It's a sleep lock because waitpid
+ * waits on it, with a CV in the parent.
+ */
+#define PROCTABLE_SIZE	256
+#define PROCSLOT_NONE	((unsigned)-1)
+
+struct procslot {
+	struct proc *ps_proc;		/* NULL if free */
+	pid_t ps_pid;			/* pid last handed out here */
+	unsigned ps_nextfree;		/* free list link */
+};
+
+static struct procslot proctable[PROCTABLE_SIZE];
+static unsigned proctable_freehead, proctable_freetail;
+static struct lock *proctable_lock;
+
+static
+void
+proctable_bootstrap(void)
+{
+	unsigned i;
 
+	COMPILE_ASSERT(PROCTABLE_SIZE >= PID_MIN);
+	COMPILE_ASSERT(2 * PROCTABLE_SIZE <= PID_MAX + 1);
+
+	for (i=0; i<PROCTABLE_SIZE; i++) {
+		proctable[i].ps_proc = NULL;
+		/* the first pid out of each slot is i + PROCTABLE_SIZE */
+		proctable[i].ps_pid = i;
+		proctable[i].ps_nextfree = i + 1;
+	}
+	proctable[PROCTABLE_SIZE - 1].ps_nextfree = PROCSLOT_NONE;
+	proctable_freehead = 0;
+	proctable_freetail = PROCTABLE_SIZE - 1;
+
+	proctable_lock = lock_create("proctable");
+	if (proctable_lock == NULL) {
+		panic("could not create proctable lock\n");
+	}
+}
+
+/*
+ * Give PROC a pid. Fails with ENPROC if the table is full.
+ */
+static
+int
+pid_alloc(struct proc *proc)
+{
+	struct procslot *ps;
+	unsigned slot;
+	pid_t pid;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	slot = proctable_freehead;
+	if (slot == PROCSLOT_NONE) {
+		return ENPROC;
+	}
+	ps = &proctable[slot];
+	proctable_freehead = ps->ps_nextfree;
+	if (proctable_freehead == PROCSLOT_NONE) {
+		proctable_freetail = PROCSLOT_NONE;
+	}
+
+	pid = ps->ps_pid + PROCTABLE_SIZE;
+	if (pid > PID_MAX) {
+		pid = slot + PROCTABLE_SIZE;
+	}
+	ps->ps_pid = pid;
+	ps->ps_proc = proc;
+	proc->p_pid = pid;
+	return 0;
+}
+
+/*
+ * Give PROC's pid back.
+ */
+static
+void
+pid_free(struct proc *proc)
+{
+	unsigned slot;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	slot = proc->p_pid % PROCTABLE_SIZE;
+	KASSERT(proctable[slot].ps_proc == proc);
+	KASSERT(proctable[slot].ps_pid == proc->p_pid);
+
+	proctable[slot].ps_proc = NULL;
+	proctable[slot].ps_nextfree = PROCSLOT_NONE;
+	if (proctable_freetail == PROCSLOT_NONE) {
+		proctable_freehead = slot;
+	}
+	else {
+		proctable[proctable_freetail].ps_nextfree = slot;
+	}
+	proctable_freetail = slot;
+	proc->p_pid = 0;
+}
+
+/*
+ * Find the process with pid PID, if there is one.
+ */
+static
+struct proc *
+pid_lookup(pid_t pid)
+{
+	struct procslot *ps;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	if (pid < PID_MIN || pid > PID_MAX) {
+		return NULL;
+	}
+	ps = &proctable[pid % PROCTABLE_SIZE];
+	if (ps->ps_proc == NULL || ps->ps_pid != pid) {
+		return NULL;
+	}
+	return ps->ps_proc;
+}
+#endif /* OPT_A2 */
 
 /*
  * Create a proc structure.
@@ -99,6 +242,36 @@ proc_create(const char *name)
 	/* VFS fields */
 	proc->p_cwd = NULL;
 
+	/* Accounting fields */
+	bzero(&proc->p_times, sizeof(proc->p_times));
+	bzero(&proc->p_ctimes, sizeof(proc->p_ctimes));
+
+#if OPT_A2
+	/* Process table fields */
+	proc->p_pid = 0;
+	proc->p_parent = NULL;
+	proc->p_children = NULL;
+	proc->p_sibnext = NULL;
+	proc->p_sibprev = NULL;
+	proc->p_exited = false;
+	proc->p_vforked = false;
+	proc->p_files = NULL;
+	proc->p_aring = NULL;
+	proc->p_exitstatus = 0;
+	proc->p_waitcv = cv_create(proc->p_name);
+	if (proc->p_waitcv == NULL) {
+		spinlock_cleanup(&proc->p_lock);
+		threadarray_cleanup(&proc->p_threads);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+#endif
+
+#if OPT_SYSTRACE
+	proc->p_systrace = false;
+#endif
+
 #ifdef UW
 	proc->console = NULL;
 #endif // UW
@@ -130,6 +303,23 @@ proc_destroy(struct proc *proc)
 	 * incorrect to destroy it.)
 	 */
 
+#if OPT_A2
+	/* Process table fields; by now nobody can look us up by pid. */
+	KASSERT(proc->p_parent == NULL);
+	KASSERT(proc->p_children == NULL);
+	if (proc->p_pid != 0) {
+		lock_acquire(proctable_lock);
+		pid_free(proc);
+		lock_release(proctable_lock);
+	}
+	cv_destroy(proc->p_waitcv);
+	if (proc->p_files != NULL) {
+		/* normally done in sys__exit */
+		filetable_destroy(proc->p_files);
+	}
+	aring_unregister(proc);
+#endif
+
 	/* VFS fields */
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
@@ -197,6 +387,9 @@ proc_bootstrap(void)
   if (kproc == NULL) {
     panic("proc_create for kproc failed\n");
   }
+#if OPT_A2
+  proctable_bootstrap();
+#endif
 #ifdef UW
   proc_count = 0;
   proc_count_mutex = sem_create("proc_count_mutex",1);
@@ -220,14 +413,19 @@ struct proc *
 proc_create_runprogram(const char *name)
 {
 	struct proc *proc;
+#if OPT_A2
+	int result;
+#else
 	char *console_path;
+#endif
 
 	proc = proc_create(name);
 	if (proc == NULL) {
 		return NULL;
 	}
 
-#ifdef UW
+#if defined(UW) && !OPT_A2
+	/* (with OPT_A2, runprogram opens the console as stdin/out/err) */
 	/* open the console - this should always succeed */
 	console_path = kstrdup("con:");
 	if (console_path == NULL) {
@@ -271,6 +469,16 @@ proc_create_runprogram(const char *name)
 	V(proc_count_mutex);
 #endif // UW
 
+#if OPT_A2
+	lock_acquire(proctable_lock);
+	result = pid_alloc(proc);
+	lock_release(proctable_lock);
+	if (result) {
+		proc_destroy(proc);
+		return NULL;
+	}
+#endif
+
 	return proc;
 }
 
@@ -314,6 +522,8 @@ proc_remthread(struct thread *t)
 	for (i=0; i<num; i++) {
 		if (threadarray_get(&proc->p_threads, i) == t) {
 			threadarray_remove(&proc->p_threads, i);
+			/* Keep the departing thread's cpu time */
+			cputimes_add(&proc->p_times, &t->t_times);
 			spinlock_release(&proc->p_lock);
 			t->t_proc = NULL;
 			return;
@@ -324,6 +534,245 @@ proc_remthread(struct thread *t)
 	panic("Thread (%p) has escaped from its process (%p)\n", t, proc);
 }
 
+/*
+ * Total up the cpu usage of PROC. The counters of threads other than
+ * curthread may be in the middle of being updated, so the result is
+ * only approximate for them; it's good enough for getrusage.
+ */
+void
+proc_gettimes(struct proc *proc, struct cputimes *ct)
+{
+	unsigned i, num;
+
+	spinlock_acquire(&proc->p_lock);
+	*ct = proc->p_times;
+	num = threadarray_num(&proc->p_threads);
+	for (i=0; i<num; i++) {
+		cputimes_add(ct, &threadarray_get(&proc->p_threads, i)->t_times);
+	}
+	spinlock_release(&proc->p_lock);
+}
+
+#if OPT_A2
+/*
+ * Put CHILD at the front of PARENT's list of children.
+ */
+void
+proc_addchild(struct proc *parent, struct proc *child)
+{
+	lock_acquire(proctable_lock);
+	KASSERT(child->p_parent == NULL);
+	child->p_parent = parent;
+	child->p_sibprev = NULL;
+	child->p_sibnext = parent->p_children;
+	if (parent->p_children != NULL) {
+		parent->p_children->p_sibprev = child;
+	}
+	parent->p_children = child;
+	lock_release(proctable_lock);
+}
+
+/*
+ * Take CHILD off its parent's list of children.
+ */
+static
+void
+proc_unlinkchild(struct proc *child)
+{
+	struct proc *parent = child->p_parent;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+	KASSERT(parent != NULL);
+
+	if (child->p_sibprev != NULL) {
+		child->p_sibprev->p_sibnext = child->p_sibnext;
+	}
+	else {
+		KASSERT(parent->p_children == child);
+		parent->p_children = child->p_sibnext;
+	}
+	if (child->p_sibnext != NULL) {
+		child->p_sibnext->p_sibprev = child->p_sibprev;
+	}
+	child->p_parent = NULL;
+	child->p_sibnext = child->p_sibprev = NULL;
+}
+
+/*
+ * Undo proc_addchild, for a fork that failed before the child ran.
+ */
+void
+proc_remchild(struct proc *child)
+{
+	lock_acquire(proctable_lock);
+	proc_unlinkchild(child);
+	lock_release(proctable_lock);
+}
+
+/*
+ * Wait for a vfork child to give our address space back. It can't be
+ * reaped, and so can't go away, while we're here, since we're its
+ * parent. Its exit also wakes us, but it'll have called
+ * proc_vforkdone first.
+ */
+void
+proc_vforkwait(struct proc *child)
+{
+	lock_acquire(proctable_lock);
+	KASSERT(child->p_parent == curproc);
+	while (child->p_vforked) {
+		cv_wait(curproc->p_waitcv, proctable_lock);
+	}
+	lock_release(proctable_lock);
+}
+
+/*
+ * Called by a vfork child, once it has stopped using its parent's
+ * address space and set its own p_addrspace to something else.
+ */
+void
+proc_vforkdone(struct proc *child)
+{
+	lock_acquire(proctable_lock);
+	KASSERT(child->p_vforked);
+	KASSERT(child->p_parent != NULL);
+	child->p_vforked = false;
+	cv_broadcast(child->p_parent->p_waitcv, proctable_lock);
+	lock_release(proctable_lock);
+}
+
+void
+proc_exit(struct proc *proc, int status)
+{
+	struct proc *child, *next, *reap = NULL;
+	bool orphan;
+
+	KASSERT(threadarray_num(&proc->p_threads) == 0);
+
+	lock_acquire(proctable_lock);
+
+	/*
+	 * Nobody will wait for our children now. Cut them loose, and
+	 * collect the ones that have already exited, to be destroyed
+	 * once we've let go of the lock.
+	 */
+	for (child = proc->p_children; child != NULL; child = next) {
+		next = child->p_sibnext;
+		child->p_parent = NULL;
+		child->p_sibprev = NULL;
+		child->p_sibnext = NULL;
+		if (child->p_exited) {
+			child->p_sibnext = reap;
+			reap = child;
+		}
+	}
+	proc->p_children = NULL;
+
+	proc->p_exited = true;
+	proc->p_exitstatus = status;
+	orphan = (proc->p_parent == NULL);
+	if (!orphan) {
+		/* From here on the parent may reap us at any moment. */
+		cv_broadcast(proc->p_parent->p_waitcv, proctable_lock);
+	}
+
+	lock_release(proctable_lock);
+
+	while (reap != NULL) {
+		next = reap->p_sibnext;
+		reap->p_sibnext = NULL;
+		proc_destroy(reap);
+		reap = next;
+	}
+
+	if (orphan) {
+		proc_destroy(proc);
+	}
+}
+
+int
+proc_wait(pid_t pid, int options, pid_t *retpid, userptr_t status,
+	  struct cputimes *usage)
+{
+	struct proc *child;
+	struct cputimes ct;
+	int result;
+
+	if (options & ~WNOHANG) {
+		return EINVAL;
+	}
+
+	lock_acquire(proctable_lock);
+	while (1) {
+		if (pid == WAIT_ANY) {
+			if (curproc->p_children == NULL) {
+				lock_release(proctable_lock);
+				return ECHILD;
+			}
+			for (child = curproc->p_children;
+			     child != NULL && !child->p_exited;
+			     child = child->p_sibnext) {
+				/* nothing */
+			}
+		}
+		else {
+			child = pid_lookup(pid);
+			if (child == NULL) {
+				lock_release(proctable_lock);
+				return ESRCH;
+			}
+			if (child->p_parent != curproc) {
+				lock_release(proctable_lock);
+				return ECHILD;
+			}
+			if (!child->p_exited) {
+				child = NULL;
+			}
+		}
+
+		if (child != NULL) {
+			break;
+		}
+		if (options & WNOHANG) {
+			lock_release(proctable_lock);
+			*retpid = 0;
+			return 0;
+		}
+		cv_wait(curproc->p_waitcv, proctable_lock);
+	}
+
+	if (status != NULL) {
+		/*
+		 * While it's still linked in, so a bad pointer doesn't
+		 * lose the status and the child with it.
+		 */
+		result = copyout(&child->p_exitstatus, status, sizeof(int));
+		if (result) {
+			lock_release(proctable_lock);
+			return result;
+		}
+	}
+
+	proc_unlinkchild(child);
+	lock_release(proctable_lock);
+
+	*retpid = child->p_pid;
+
+	/* Its threads are gone, so its times are final. */
+	ct = child->p_times;
+	cputimes_add(&ct, &child->p_ctimes);
+	spinlock_acquire(&curproc->p_lock);
+	cputimes_add(&curproc->p_ctimes, &ct);
+	spinlock_release(&curproc->p_lock);
+	if (usage != NULL) {
+		*usage = ct;
+	}
+
+	proc_destroy(child);
+	return 0;
+}
+#endif /* OPT_A2 */
+
 /*
  * Fetch the address space of the current process. Caution: it isn't
  * refcounted. If you implement multithreaded processes, make sure to
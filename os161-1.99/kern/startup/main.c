@@ -50,6 +50,10 @@
 #include <test.h>
 #include <version.h>
 #include "autoconf.h"  // for pseudoconfig
+#include "opt-systrace.h"
+#if OPT_SYSTRACE
+#include <systrace.h>
+#endif
 
 
 /*
@@ -124,7 +128,11 @@ boot(void)
 	/* Late phase of initialization. */
 	vm_bootstrap();
 	kprintf_bootstrap();
+	futex_bootstrap();
 	thread_start_cpus();
+#if OPT_SYSTRACE
+	systrace_bootstrap();
+#endif
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
 	vfs_setbootfs("emu0");
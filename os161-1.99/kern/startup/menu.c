@@ -1,4 +1,5 @@
 #include "opt-A3.h"
+#include "opt-A2.h"
 /*
  * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
  *	The President and Fellows of Harvard College.
@@ -36,6 +37,7 @@
 #include <lib.h>
 #include <uio.h>
 #include <clock.h>
+#include <cpu.h>
 #include <thread.h>
 #include <proc.h>
 #include <synch.h>
@@ -46,6 +48,15 @@
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
 #include "opt-net.h"
+#include "opt-irqstats.h"
+#include "opt-lockstat.h"
+#if OPT_LOCKSTAT
+#include <lockstat.h>
+#endif
+#include "opt-systrace.h"
+#if OPT_SYSTRACE
+#include <systrace.h>
+#endif
 
 /*
  * In-kernel menu and command dispatcher.
@@ -75,11 +86,7 @@ getinterval(time_t s1, uint32_t ns1, time_t s2, uint32_t ns2,
 
 /*
  * Function for a thread that runs an arbitrary userlevel program by
- * name.
- *
- * Note: this cannot pass arguments to the program. You may wish to 
- * change it so it can, because that will make testing much easier
- * in the future.
+ * name, with the rest of the command line as its arguments.
  *
  * It copies the program name because runprogram destroys the copy
  * it gets by passing it to vfs_open(). 
@@ -94,16 +101,22 @@ cmd_progthread(void *ptr, unsigned long nargs)
 
 	KASSERT(nargs >= 1);
 
+#if !OPT_A2
 	if (nargs > 2) {
 		kprintf("Warning: argument passing from menu not supported\n");
 	}
+#endif
 
 	/* Hope we fit. */
 	KASSERT(strlen(args[0]) < sizeof(progname));
 
 	strcpy(progname, args[0]);
 
+#if OPT_A2
+	result = runprogram(progname, nargs, args);
+#else
 	result = runprogram(progname);
+#endif
 	if (result) {
 		kprintf("Running program %s failed: %s\n", args[0],
 			strerror(result));
@@ -397,6 +410,149 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_runqueues(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	thread_printrunqueues();
+
+	return 0;
+}
+
+static
+int
+cmd_schedlat(int nargs, char **args)
+{
+	bool reset;
+
+	if (nargs == 1) {
+		reset = false;
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		reset = true;
+	}
+	else {
+		kprintf("Usage: sl [reset]\n");
+		return EINVAL;
+	}
+
+	thread_printschedlat(reset);
+
+	return 0;
+}
+
+#if OPT_A2
+static
+int
+cmd_forkstats(int nargs, char **args)
+{
+	bool reset;
+
+	if (nargs == 1) {
+		reset = false;
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		reset = true;
+	}
+	else {
+		kprintf("Usage: fk [reset]\n");
+		return EINVAL;
+	}
+
+	fork_printstats(reset);
+
+	return 0;
+}
+#endif
+
+#if OPT_IRQSTATS
+static
+int
+cmd_irqstats(int nargs, char **args)
+{
+	bool reset;
+
+	if (nargs == 1) {
+		reset = false;
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		reset = true;
+	}
+	else {
+		kprintf("Usage: irq [reset]\n");
+		return EINVAL;
+	}
+
+	cpu_printirqstats(reset);
+
+	return 0;
+}
+#endif
+
+#if OPT_LOCKSTAT
+/*
+ * Command for listing the most contended locks.
+ */
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	unsigned n = 10;
+	bool reset = false;
+	int i;
+
+	for (i=1; i<nargs; i++) {
+		if (!strcmp(args[i], "reset")) {
+			reset = true;
+		}
+		else if (args[i][0] >= '1' && args[i][0] <= '9') {
+			n = atoi(args[i]);
+		}
+		else {
+			kprintf("Usage: lockstat [count] [reset]\n");
+			return EINVAL;
+		}
+	}
+
+	lockstat_print(n, reset);
+
+	return 0;
+}
+#endif
+
+#if OPT_SYSTRACE
+/*
+ * Command for printing per-syscall counts and latencies.
+ */
+static
+int
+cmd_systrace(int nargs, char **args)
+{
+	bool hist = false, reset = false;
+	int i;
+
+	for (i=1; i<nargs; i++) {
+		if (!strcmp(args[i], "hist")) {
+			hist = true;
+		}
+		else if (!strcmp(args[i], "reset")) {
+			reset = true;
+		}
+		else {
+			kprintf("Usage: st [hist] [reset]\n");
+			return EINVAL;
+		}
+	}
+
+	systrace_print(hist, reset);
+
+	return 0;
+}
+#endif
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -466,6 +622,11 @@ static const char *testmenu[] = {
 	"[sy1] Semaphore test                ",
 	"[sy2] Lock test             (1)     ",
 	"[sy3] CV test               (1)     ",
+	"[sy4] RW lock read scaling          ",
+	"[sy5] Spinlock fairness             ",
+	"[sy6] Lock/sem wait time tails      ",
+	"[sy7] Priority inversion            ",
+	"[sy8] CV timeout and broadcast      ",
 #ifdef UW
 	"[uw1] UW lock test          (1)     ",
 	"[uw2] UW vmstats test       (3)     ",
@@ -506,6 +667,20 @@ static const char *mainmenu[] = {
 #endif /* UW */
 #endif
 	"[kh] Kernel heap stats              ",
+	"[rq] Per-cpu run queues             ",
+	"[sl] Sched latency [reset]          ",
+#if OPT_A2
+	"[fk] Fork latency [reset]           ",
+#endif
+#if OPT_IRQSTATS
+	"[irq] Interrupts-off times [reset]  ",
+#endif
+#if OPT_LOCKSTAT
+	"[lockstat] Top locks [n] [reset]    ",
+#endif
+#if OPT_SYSTRACE
+	"[st] Syscalls [hist] [reset]        ",
+#endif
 	"[dth] Enable debug msg for threads  ",
 #ifdef OPT_A3
 	"[dexec] Enable debug msg for execution  ",
@@ -609,6 +784,20 @@ static struct {
 
 	/* stats */
 	{ "kh",         cmd_kheapstats },
+	{ "rq",         cmd_runqueues },
+	{ "sl",         cmd_schedlat },
+#if OPT_A2
+	{ "fk",         cmd_forkstats },
+#endif
+#if OPT_IRQSTATS
+	{ "irq",        cmd_irqstats },
+#endif
+#if OPT_LOCKSTAT
+	{ "lockstat",   cmd_lockstat },
+#endif
+#if OPT_SYSTRACE
+	{ "st",         cmd_systrace },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -626,6 +815,11 @@ static struct {
 	/* synchronization assignment tests */
 	{ "sy2",	locktest },
 	{ "sy3",	cvtest },
+	{ "sy4",	rwlocktest },
+	{ "sy5",	spinlocktest },
+	{ "sy6",	tailtest },
+	{ "sy7",	pitest },
+	{ "sy8",	cvwaketest },
 #ifdef UW
 	{ "uw1",	uwlocktest1 },
 	{ "uw2",	uwvmstatstest },
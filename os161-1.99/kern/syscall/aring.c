@@ -0,0 +1,248 @@
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/aring.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <current.h>
+#include <proc.h>
+#include <syscall.h>
+
+/*
+ * Batched system calls. See kern/aring.h for how the ring works.
+ *
+ * Everything lives in the process's memory; the kernel only keeps
+ * where it is. Entries are copied in and completions out ARING_BATCH
+ * at a time, so a batch costs a few copyins and copyouts on top of
+ * the calls themselves, instead of a trap each. Each entry is run by
+ * the same code as the system call it stands for.
+ *
+ * Only the process itself ever looks at p_aring, so it needs no lock.
+ */
+
+/* Entries copied in (and completions out) at once */
+#define ARING_BATCH 16
+
+/* A process's registered ring */
+struct aringreg {
+  userptr_t ar_hdr;		/* struct aring */
+  userptr_t ar_sq;		/* struct aring_sqe[ar_entries] */
+  userptr_t ar_cq;		/* struct aring_cqe[ar_entries] */
+  unsigned ar_entries;		/* a power of two */
+};
+
+void
+aring_unregister(struct proc *p)
+{
+  if (p->p_aring != NULL) {
+    kfree(p->p_aring);
+    p->p_aring = NULL;
+  }
+}
+
+/* handler for aring_setup() system call */
+int
+sys_aring_setup(userptr_t hdr, userptr_t sq, userptr_t cq, unsigned entries)
+{
+  struct aringreg *ar;
+
+  if (hdr == NULL) {
+    /* just get rid of the old one */
+    aring_unregister(curproc);
+    return 0;
+  }
+  if (entries == 0 || entries > ARING_MAXENTRIES ||
+      (entries & (entries - 1)) != 0) {
+    return EINVAL;
+  }
+  if (sq == NULL || cq == NULL) {
+    return EFAULT;
+  }
+
+  ar = kmalloc(sizeof(*ar));
+  if (ar == NULL) {
+    return ENOMEM;
+  }
+  ar->ar_hdr = hdr;
+  ar->ar_sq = sq;
+  ar->ar_cq = cq;
+  ar->ar_entries = entries;
+
+  aring_unregister(curproc);
+  curproc->p_aring = ar;
+  return 0;
+}
+
+/*
+ * Copy N entries of SIZE bytes between BUF and the ring at BASE,
+ * starting at counter value IDX and wrapping around the end.
+ */
+static
+int
+aring_copy(struct aringreg *ar, userptr_t base, unsigned idx, void *buf,
+           unsigned n, size_t size, bool out)
+{
+  unsigned slot, first;
+  int result;
+
+  slot = idx & (ar->ar_entries - 1);
+  first = ar->ar_entries - slot;
+  if (first > n) {
+    first = n;
+  }
+
+  if (out) {
+    result = copyout(buf, base + slot * size, first * size);
+  }
+  else {
+    result = copyin(base + slot * size, buf, first * size);
+  }
+  if (result || first == n) {
+    return result;
+  }
+  buf = (char *)buf + first * size;
+  if (out) {
+    return copyout(buf, base, (n - first) * size);
+  }
+  return copyin(base, buf, (n - first) * size);
+}
+
+/*
+ * Run one submission entry. Returns what the call returned, or minus
+ * the error.
+ */
+static
+int32_t
+aring_run(const struct aring_sqe *sqe)
+{
+  bool atpos;
+  int retval = 0;
+  int result;
+
+  if (sqe->sqe_flags & ~ARING_F_POS) {
+    return -EINVAL;
+  }
+  atpos = (sqe->sqe_flags & ARING_F_POS) != 0;
+
+  switch (sqe->sqe_op) {
+  case ARING_OP_NOP:
+    result = 0;
+    break;
+  case ARING_OP_READ:
+    if (atpos) {
+      result = sys_pread(sqe->sqe_fd, sqe->sqe_buf, sqe->sqe_len,
+                         (off_t)sqe->sqe_off, &retval);
+    }
+    else {
+      result = sys_read(sqe->sqe_fd, sqe->sqe_buf, sqe->sqe_len, &retval);
+    }
+    break;
+  case ARING_OP_WRITE:
+    if (atpos) {
+      result = sys_pwrite(sqe->sqe_fd, sqe->sqe_buf, sqe->sqe_len,
+                          (off_t)sqe->sqe_off, &retval);
+    }
+    else {
+      result = sys_write(sqe->sqe_fd, sqe->sqe_buf, sqe->sqe_len, &retval);
+    }
+    break;
+  case ARING_OP_OPEN:
+    result = sys_open(sqe->sqe_buf, sqe->sqe_len, sqe->sqe_mode, &retval);
+    break;
+  case ARING_OP_CLOSE:
+    result = sys_close(sqe->sqe_fd);
+    break;
+  case ARING_OP_FSYNC:
+    result = sys_fsync(sqe->sqe_fd);
+    break;
+  default:
+    result = EINVAL;
+    break;
+  }
+
+  if (result) {
+    return -result;
+  }
+  return retval;
+}
+
+/*
+ * handler for aring_enter() system call: run up to TOSUBMIT queued
+ * entries, as many as there is room to complete, and return how many
+ * were run.
+ */
+int
+sys_aring_enter(unsigned tosubmit, int *retval)
+{
+  struct aringreg *ar = curproc->p_aring;
+  struct aring_sqe sqes[ARING_BATCH];
+  struct aring_cqe cqes[ARING_BATCH];
+  struct aring hdr;
+  unsigned pending, used, done, n, i;
+  int result, hdrresult;
+
+  if (ar == NULL) {
+    return EINVAL;
+  }
+  result = copyin(ar->ar_hdr, &hdr, sizeof(hdr));
+  if (result) {
+    return result;
+  }
+  pending = hdr.ar_sqtail - hdr.ar_sqhead;
+  used = hdr.ar_cqtail - hdr.ar_cqhead;
+  if (pending > ar->ar_entries || used > ar->ar_entries) {
+    return EINVAL;
+  }
+  if (tosubmit > pending) {
+    tosubmit = pending;
+  }
+  if (tosubmit > ar->ar_entries - used) {
+    tosubmit = ar->ar_entries - used;
+  }
+
+  for (done = 0; done < tosubmit; done += n) {
+    n = tosubmit - done;
+    if (n > ARING_BATCH) {
+      n = ARING_BATCH;
+    }
+    result = aring_copy(ar, ar->ar_sq, hdr.ar_sqhead, sqes, n,
+                        sizeof(sqes[0]), false);
+    if (result) {
+      break;
+    }
+    for (i=0; i<n; i++) {
+      cqes[i].cqe_data = sqes[i].sqe_data;
+      cqes[i].cqe_res = aring_run(&sqes[i]);
+      cqes[i].cqe_unused = 0;
+    }
+
+    /*
+     * These have happened now, so move past them and tell the
+     * process so even if the completions can't be written; running
+     * them again would be worse. The completions only count if they
+     * were written. Only the kernel's half of the header is written
+     * back.
+     */
+    result = aring_copy(ar, ar->ar_cq, hdr.ar_cqtail, cqes, n,
+                        sizeof(cqes[0]), true);
+    hdr.ar_sqhead += n;
+    if (result == 0) {
+      hdr.ar_cqtail += n;
+    }
+    hdrresult = copyout(&hdr, ar->ar_hdr,
+                        sizeof(hdr.ar_sqhead) + sizeof(hdr.ar_cqtail));
+    if (result == 0) {
+      result = hdrresult;
+    }
+    if (result) {
+      done += n;
+      break;
+    }
+  }
+
+  /* report a fault only if nothing got done */
+  if (result && done == 0) {
+    return result;
+  }
+  *retval = done;
+  return 0;
+}
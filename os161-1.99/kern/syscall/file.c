@@ -0,0 +1,258 @@
+/*
+ * Open files and file tables. See file.h for details.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/unistd.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <file.h>
+
+int
+openfile_create(struct vnode *vn, int flags, struct openfile **ret)
+{
+	struct openfile *of;
+
+	of = kmalloc(sizeof(*of));
+	if (of == NULL) {
+		return ENOMEM;
+	}
+
+	of->of_vnode = vn;
+	of->of_flags = flags & (O_ACCMODE | O_APPEND);
+	of->of_seekable = (VOP_TRYSEEK(vn, 0) == 0);
+	of->of_offsetlock = NULL;
+	if (of->of_seekable) {
+		of->of_offsetlock = lock_create("openfile");
+		if (of->of_offsetlock == NULL) {
+			kfree(of);
+			return ENOMEM;
+		}
+	}
+	of->of_offset = 0;
+	spinlock_init(&of->of_reflock);
+	of->of_refcount = 1;
+
+	*ret = of;
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *of)
+{
+	spinlock_acquire(&of->of_reflock);
+	of->of_refcount++;
+	spinlock_release(&of->of_reflock);
+}
+
+void
+openfile_decref(struct openfile *of)
+{
+	unsigned refcount;
+
+	spinlock_acquire(&of->of_reflock);
+	KASSERT(of->of_refcount > 0);
+	refcount = --of->of_refcount;
+	spinlock_release(&of->of_reflock);
+
+	if (refcount > 0) {
+		return;
+	}
+
+	vfs_close(of->of_vnode);
+	if (of->of_offsetlock != NULL) {
+		lock_destroy(of->of_offsetlock);
+	}
+	spinlock_cleanup(&of->of_reflock);
+	kfree(of);
+}
+
+////////////////////////////////////////////////////////////
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	int fd;
+
+	ft = kmalloc(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+	spinlock_init(&ft->ft_lock);
+	for (fd=0; fd<OPEN_MAX; fd++) {
+		ft->ft_files[fd] = NULL;
+	}
+	return ft;
+}
+
+void
+filetable_destroy(struct filetable *ft)
+{
+	int fd;
+
+	/* Nobody else can be using it now, so no need to lock. */
+	for (fd=0; fd<OPEN_MAX; fd++) {
+		if (ft->ft_files[fd] != NULL) {
+			openfile_decref(ft->ft_files[fd]);
+			ft->ft_files[fd] = NULL;
+		}
+	}
+	spinlock_cleanup(&ft->ft_lock);
+	kfree(ft);
+}
+
+int
+filetable_copy(struct filetable *ft, struct filetable **ret)
+{
+	struct filetable *newft;
+	struct openfile *of;
+	int fd;
+
+	newft = filetable_create();
+	if (newft == NULL) {
+		return ENOMEM;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	for (fd=0; fd<OPEN_MAX; fd++) {
+		of = ft->ft_files[fd];
+		if (of != NULL) {
+			openfile_incref(of);
+			newft->ft_files[fd] = of;
+		}
+	}
+	spinlock_release(&ft->ft_lock);
+
+	*ret = newft;
+	return 0;
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	struct openfile *of;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	of = ft->ft_files[fd];
+	if (of != NULL) {
+		openfile_incref(of);
+	}
+	spinlock_release(&ft->ft_lock);
+
+	if (of == NULL) {
+		return EBADF;
+	}
+	*ret = of;
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct openfile *of, int *ret)
+{
+	int fd;
+
+	spinlock_acquire(&ft->ft_lock);
+	for (fd=0; fd<OPEN_MAX; fd++) {
+		if (ft->ft_files[fd] == NULL) {
+			ft->ft_files[fd] = of;
+			spinlock_release(&ft->ft_lock);
+			*ret = fd;
+			return 0;
+		}
+	}
+	spinlock_release(&ft->ft_lock);
+	return EMFILE;
+}
+
+int
+filetable_placeat(struct filetable *ft, struct openfile *of, int fd,
+		  struct openfile **oldof)
+{
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	*oldof = ft->ft_files[fd];
+	ft->ft_files[fd] = of;
+	spinlock_release(&ft->ft_lock);
+	return 0;
+}
+
+int
+filetable_remove(struct filetable *ft, int fd, struct openfile **ret)
+{
+	struct openfile *of;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	of = ft->ft_files[fd];
+	ft->ft_files[fd] = NULL;
+	spinlock_release(&ft->ft_lock);
+
+	if (of == NULL) {
+		return EBADF;
+	}
+	*ret = of;
+	return 0;
+}
+
+/*
+ * Open the console on descriptor FD with FLAGS.
+ */
+static
+int
+filetable_opencon(struct filetable *ft, int fd, int flags)
+{
+	struct vnode *vn;
+	struct openfile *of, *oldof;
+	char path[5];
+	int result;
+
+	/* vfs_open destroys the name */
+	strcpy(path, "con:");
+	result = vfs_open(path, flags, 0, &vn);
+	if (result) {
+		return result;
+	}
+	result = openfile_create(vn, flags, &of);
+	if (result) {
+		vfs_close(vn);
+		return result;
+	}
+	result = filetable_placeat(ft, of, fd, &oldof);
+	KASSERT(result == 0);
+	if (oldof != NULL) {
+		openfile_decref(oldof);
+	}
+	return 0;
+}
+
+int
+filetable_opencons(struct filetable *ft)
+{
+	int result;
+
+	result = filetable_opencon(ft, STDIN_FILENO, O_RDONLY);
+	if (result) {
+		return result;
+	}
+	result = filetable_opencon(ft, STDOUT_FILENO, O_WRONLY);
+	if (result) {
+		return result;
+	}
+	return filetable_opencon(ft, STDERR_FILENO, O_WRONLY);
+}
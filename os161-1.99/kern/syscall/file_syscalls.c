@@ -8,6 +8,448 @@
 #include <vfs.h>
 #include <current.h>
 #include <proc.h>
+#include "opt-A2.h"
+#if OPT_A2
+#include <kern/fcntl.h>
+#include <kern/seek.h>
+#include <kern/stat.h>
+#include <limits.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <file.h>
+#include <pipe.h>
+#endif
+
+#if OPT_A2
+
+/* handler for open() system call */
+int
+sys_open(userptr_t upath, int flags, mode_t mode, int *retval)
+{
+  struct vnode *vn;
+  struct openfile *of;
+  char *path;
+  int fd, result;
+
+  path = kmalloc(PATH_MAX);
+  if (path == NULL) {
+    return ENOMEM;
+  }
+  result = copyinstr(upath, path, PATH_MAX, NULL);
+  if (result) {
+    kfree(path);
+    return result;
+  }
+
+  DEBUG(DB_SYSCALL,"Syscall: open(%s,0x%x)\n",path,flags);
+
+  /* note that vfs_open destroys path */
+  result = vfs_open(path, flags, mode, &vn);
+  kfree(path);
+  if (result) {
+    return result;
+  }
+
+  result = openfile_create(vn, flags, &of);
+  if (result) {
+    vfs_close(vn);
+    return result;
+  }
+  result = filetable_place(curproc->p_files, of, &fd);
+  if (result) {
+    openfile_decref(of);
+    return result;
+  }
+
+  *retval = fd;
+  return 0;
+}
+
+/* do the I/O set up in U (everything but uio_offset) through
+   descriptor FD. Normally, if the file is seekable, this goes at its
+   seek position (or the end, for an O_APPEND write), and moves the
+   position along; if POSITIONAL, it goes at POS instead and leaves
+   the seek position alone, so it doesn't need the offset lock */
+static int
+file_io(int fd, struct uio *u, bool positional, off_t pos, int *retval)
+{
+  struct openfile *of;
+  struct stat st;
+  size_t nbytes = u->uio_resid;
+  bool locked = false;
+  int accmode, result;
+
+  result = filetable_get(curproc->p_files, fd, &of);
+  if (result) {
+    return result;
+  }
+  accmode = of->of_flags & O_ACCMODE;
+  if ((u->uio_rw == UIO_READ && accmode == O_WRONLY) ||
+      (u->uio_rw == UIO_WRITE && accmode == O_RDONLY)) {
+    openfile_decref(of);
+    return EBADF;
+  }
+
+  if (positional) {
+    if (!of->of_seekable) {
+      openfile_decref(of);
+      return ESPIPE;
+    }
+    if (pos < 0) {
+      openfile_decref(of);
+      return EINVAL;
+    }
+    u->uio_offset = pos;
+  }
+  else if (of->of_seekable) {
+    lock_acquire(of->of_offsetlock);
+    locked = true;
+    if (u->uio_rw == UIO_WRITE && (of->of_flags & O_APPEND)) {
+      result = VOP_STAT(of->of_vnode, &st);
+      if (result) {
+        goto out;
+      }
+      of->of_offset = st.st_size;
+    }
+    u->uio_offset = of->of_offset;
+  }
+  else {
+    u->uio_offset = 0;
+  }
+
+  if (u->uio_rw == UIO_READ) {
+    result = VOP_READ(of->of_vnode, u);
+  }
+  else {
+    result = VOP_WRITE(of->of_vnode, u);
+  }
+  if (result) {
+    goto out;
+  }
+
+  if (locked) {
+    of->of_offset = u->uio_offset;
+  }
+  /* pass back the number of bytes actually transferred */
+  *retval = nbytes - u->uio_resid;
+  KASSERT(*retval >= 0);
+
+ out:
+  if (locked) {
+    lock_release(of->of_offsetlock);
+  }
+  openfile_decref(of);
+  return result;
+}
+
+/* the most a single read or write can do, so the result fits */
+#define FILE_IO_MAX 0x7fffffff
+
+/* read or write one user buffer; set up a uio structure to refer to
+   it and hand it to file_io */
+static int
+file_rw(int fd, userptr_t ubuf, size_t nbytes, enum uio_rw rw,
+        bool positional, off_t pos, int *retval)
+{
+  struct iovec iov;
+  struct uio u;
+
+  /* more than that is done as a short read or write */
+  if (nbytes > FILE_IO_MAX) {
+    nbytes = FILE_IO_MAX;
+  }
+
+  iov.iov_ubase = ubuf;
+  iov.iov_len = nbytes;
+  u.uio_iov = &iov;
+  u.uio_iovcnt = 1;
+  u.uio_resid = nbytes;
+  u.uio_segflg = UIO_USERSPACE;
+  u.uio_rw = rw;
+  u.uio_space = curproc->p_addrspace;
+
+  return file_io(fd, &u, positional, pos, retval);
+}
+
+/* vectors up to this long are copied in on the stack */
+#define FILE_IOV_ONSTACK 8
+
+/* readv or writev: copy in the user's iovec array and make one uio
+   out of the whole thing, so the filesystem sees one request */
+static int
+file_rwv(int fd, userptr_t uiov, int iovcnt, enum uio_rw rw, int *retval)
+{
+  struct iovec iovbuf[FILE_IOV_ONSTACK];
+  struct iovec *iov;
+  struct uio u;
+  size_t total;
+  int i, result;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX) {
+    return EINVAL;
+  }
+  if (iovcnt <= FILE_IOV_ONSTACK) {
+    iov = iovbuf;
+  }
+  else {
+    iov = kmalloc(iovcnt * sizeof(*iov));
+    if (iov == NULL) {
+      return ENOMEM;
+    }
+  }
+
+  /* struct iovec is laid out the same in user and kernel */
+  result = copyin(uiov, iov, iovcnt * sizeof(*iov));
+  if (result) {
+    goto out;
+  }
+  total = 0;
+  for (i=0; i<iovcnt; i++) {
+    if (iov[i].iov_len > FILE_IO_MAX - total) {
+      result = EINVAL;
+      goto out;
+    }
+    total += iov[i].iov_len;
+  }
+
+  u.uio_iov = iov;
+  u.uio_iovcnt = iovcnt;
+  u.uio_resid = total;
+  u.uio_segflg = UIO_USERSPACE;
+  u.uio_rw = rw;
+  u.uio_space = curproc->p_addrspace;
+
+  result = file_io(fd, &u, false, 0, retval);
+
+ out:
+  if (iov != iovbuf) {
+    kfree(iov);
+  }
+  return result;
+}
+
+/* handler for read() system call */
+int
+sys_read(int fdesc, userptr_t ubuf, unsigned int nbytes, int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: read(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, UIO_READ, false, 0, retval);
+}
+
+/* handler for write() system call */
+int
+sys_write(int fdesc, userptr_t ubuf, unsigned int nbytes, int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: write(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, UIO_WRITE, false, 0, retval);
+}
+
+/* handler for pread() system call */
+int
+sys_pread(int fdesc, userptr_t ubuf, unsigned int nbytes, off_t pos,
+          int *retval)
+{
+  return file_rw(fdesc, ubuf, nbytes, UIO_READ, true, pos, retval);
+}
+
+/* handler for pwrite() system call */
+int
+sys_pwrite(int fdesc, userptr_t ubuf, unsigned int nbytes, off_t pos,
+           int *retval)
+{
+  return file_rw(fdesc, ubuf, nbytes, UIO_WRITE, true, pos, retval);
+}
+
+/* handler for readv() system call */
+int
+sys_readv(int fdesc, userptr_t iov, int iovcnt, int *retval)
+{
+  return file_rwv(fdesc, iov, iovcnt, UIO_READ, retval);
+}
+
+/* handler for writev() system call */
+int
+sys_writev(int fdesc, userptr_t iov, int iovcnt, int *retval)
+{
+  return file_rwv(fdesc, iov, iovcnt, UIO_WRITE, retval);
+}
+
+/* handler for lseek() system call */
+int
+sys_lseek(int fdesc, off_t pos, int whence, off_t *retval)
+{
+  struct openfile *of;
+  struct stat st;
+  off_t newpos;
+  int result;
+
+  result = filetable_get(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  if (!of->of_seekable) {
+    openfile_decref(of);
+    return ESPIPE;
+  }
+
+  lock_acquire(of->of_offsetlock);
+  switch (whence) {
+  case SEEK_SET:
+    newpos = pos;
+    break;
+  case SEEK_CUR:
+    newpos = of->of_offset + pos;
+    break;
+  case SEEK_END:
+    result = VOP_STAT(of->of_vnode, &st);
+    newpos = st.st_size + pos;
+    break;
+  default:
+    result = EINVAL;
+    break;
+  }
+  if (!result && newpos < 0) {
+    result = EINVAL;
+  }
+  if (!result) {
+    result = VOP_TRYSEEK(of->of_vnode, newpos);
+  }
+  if (!result) {
+    of->of_offset = newpos;
+    *retval = newpos;
+  }
+  lock_release(of->of_offsetlock);
+
+  openfile_decref(of);
+  return result;
+}
+
+/* handler for close() system call */
+int
+sys_close(int fdesc)
+{
+  struct openfile *of;
+  int result;
+
+  result = filetable_remove(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  openfile_decref(of);
+  return 0;
+}
+
+/* handler for dup2() system call */
+int
+sys_dup2(int oldfd, int newfd, int *retval)
+{
+  struct openfile *of, *oldof;
+  int result;
+
+  result = filetable_get(curproc->p_files, oldfd, &of);
+  if (result) {
+    return result;
+  }
+  if (oldfd == newfd) {
+    openfile_decref(of);
+    *retval = newfd;
+    return 0;
+  }
+
+  /* this hands our reference to the table */
+  result = filetable_placeat(curproc->p_files, of, newfd, &oldof);
+  if (result) {
+    openfile_decref(of);
+    return result;
+  }
+  if (oldof != NULL) {
+    openfile_decref(oldof);
+  }
+
+  *retval = newfd;
+  return 0;
+}
+
+/* handler for pipe() system call */
+int
+sys_pipe(userptr_t ufds)
+{
+  struct vnode *readvn, *writevn;
+  struct openfile *readof, *writeof;
+  int fds[2];
+  int result;
+
+  result = pipe_create(&readvn, &writevn);
+  if (result) {
+    return result;
+  }
+  result = openfile_create(readvn, O_RDONLY, &readof);
+  if (result) {
+    vfs_close(readvn);
+    vfs_close(writevn);
+    return result;
+  }
+  result = openfile_create(writevn, O_WRONLY, &writeof);
+  if (result) {
+    openfile_decref(readof);
+    vfs_close(writevn);
+    return result;
+  }
+
+  result = filetable_place(curproc->p_files, readof, &fds[0]);
+  if (result) {
+    openfile_decref(readof);
+    openfile_decref(writeof);
+    return result;
+  }
+  result = filetable_place(curproc->p_files, writeof, &fds[1]);
+  if (result) {
+    openfile_decref(writeof);
+    sys_close(fds[0]);
+    return result;
+  }
+  result = copyout(fds, ufds, sizeof(fds));
+  if (result) {
+    sys_close(fds[1]);
+    sys_close(fds[0]);
+    return result;
+  }
+  return 0;
+}
+
+/* handler for ioctl() system call */
+int
+sys_ioctl(int fdesc, int code, userptr_t data)
+{
+  struct openfile *of;
+  int result;
+
+  result = filetable_get(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  result = VOP_IOCTL(of->of_vnode, code, data);
+  openfile_decref(of);
+  return result;
+}
+
+/* handler for fsync() system call */
+int
+sys_fsync(int fdesc)
+{
+  struct openfile *of;
+  int result;
+
+  result = filetable_get(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  result = VOP_FSYNC(of->of_vnode);
+  openfile_decref(of);
+  return result;
+}
+
+#else /* OPT_A2 */
 
 /* handler for write() system call                  */
 /*
@@ -58,3 +500,5 @@ sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
   KASSERT(*retval >= 0);
   return 0;
 }
+
+#endif /* OPT_A2 */
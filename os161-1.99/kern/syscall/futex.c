@@ -0,0 +1,196 @@
+/*
+ * Futex-style wait and wake.
+ *
+ * A user-level lock or condition lives in an int in user memory and is
+ * manipulated with ordinary loads and stores (or ll/sc) while that's
+ * enough; only when a thread actually has to wait does it come in
+ * here. futex_wait sleeps if the word still holds the value the
+ * caller last saw, for at most a given time if the caller likes, and
+ * futex_wake wakes up to N threads sleeping on the same word.
+ *
+ * Sleepers are kept in a fixed hash table keyed on (address space,
+ * user address). Each bucket has a lock and a CV; the lock is a sleep
+ * lock so the word can be read with copyin while holding it, which is
+ * what keeps a wakeup from slipping in between the check and the
+ * sleep. Threads on other words that hash to the same bucket share
+ * the CV, so each sleeper also has a record on the bucket's list that
+ * the waker marks; anyone woken whose record isn't marked goes back to
+ * sleep.
+ *
+ * Keying on the address space means a futex can only be shared among
+ * threads of one process; there's no shared memory between processes
+ * to key on anyway.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+#define FUTEX_HASHSIZE 64	/* buckets; must be a power of 2 */
+
+struct futex_waiter {
+	struct addrspace *fw_as;	/* key: address space */
+	vaddr_t fw_addr;		/* key: user address */
+	bool fw_woken;			/* set by futex_wake */
+	struct futex_waiter *fw_next;	/* bucket list */
+};
+
+struct futex_bucket {
+	struct lock *fb_lock;
+	struct cv *fb_cv;
+	struct futex_waiter *fb_waiters;	/* oldest first */
+};
+
+static struct futex_bucket futex_table[FUTEX_HASHSIZE];
+
+/*
+ * Set up the table. Called once during boot.
+ */
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_HASHSIZE; i++) {
+		futex_table[i].fb_lock = lock_create("futex");
+		futex_table[i].fb_cv = cv_create("futex");
+		if (futex_table[i].fb_lock == NULL ||
+		    futex_table[i].fb_cv == NULL) {
+			panic("futex_bootstrap: Out of memory\n");
+		}
+		futex_table[i].fb_waiters = NULL;
+	}
+}
+
+static
+struct futex_bucket *
+futex_hash(struct addrspace *as, vaddr_t addr)
+{
+	uint32_t h;
+
+	/* words are 4-aligned, and neighbors should spread out */
+	h = (uint32_t)addr >> 2;
+	h ^= (uint32_t)(uintptr_t)as >> 4;
+	h ^= h >> 11;
+	return &futex_table[h & (FUTEX_HASHSIZE - 1)];
+}
+
+/*
+ * futex_wait: if the int at ADDR is VAL, sleep until a futex_wake on
+ * ADDR. Fails with EAGAIN (without sleeping) if it isn't. TIMEOUT is
+ * in milliseconds as for poll: if it isn't negative, give up with
+ * ETIMEDOUT once that long has gone by without a wake.
+ */
+int
+sys_futex_wait(userptr_t addr, int val, int timeout)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter self, **pp;
+	uint64_t deadline = 0, now;
+	int cur, result;
+
+	if (((vaddr_t)addr & (sizeof(int) - 1)) != 0) {
+		return EINVAL;
+	}
+
+	self.fw_as = curproc_getas();
+	self.fw_addr = (vaddr_t)addr;
+	self.fw_woken = false;
+	self.fw_next = NULL;
+	if (timeout > 0) {
+		deadline = gettime_nsecs() + timeout * 1000000ULL;
+	}
+
+	fb = futex_hash(self.fw_as, self.fw_addr);
+	lock_acquire(fb->fb_lock);
+
+	result = copyin((const_userptr_t)addr, &cur, sizeof(cur));
+	if (result) {
+		lock_release(fb->fb_lock);
+		return result;
+	}
+	if (cur != val) {
+		lock_release(fb->fb_lock);
+		return EAGAIN;
+	}
+
+	/* Go on the end of the list, so wakes are FIFO. */
+	for (pp = &fb->fb_waiters; *pp != NULL; pp = &(*pp)->fw_next) {
+		/* nothing */
+	}
+	*pp = &self;
+
+	result = 0;
+	while (!self.fw_woken) {
+		if (timeout < 0) {
+			cv_wait(fb->fb_cv, fb->fb_lock);
+			continue;
+		}
+		now = gettime_nsecs();
+		if (timeout == 0 || now >= deadline) {
+			/* Nobody took us off the list; do it ourselves. */
+			for (pp = &fb->fb_waiters; *pp != &self;
+			     pp = &(*pp)->fw_next) {
+				KASSERT(*pp != NULL);
+			}
+			*pp = self.fw_next;
+			result = ETIMEDOUT;
+			break;
+		}
+		cv_timedwait(fb->fb_cv, fb->fb_lock,
+			     timeout_nsecs2ticks(deadline - now));
+	}
+	/* If we were woken, futex_wake took us off the list */
+	lock_release(fb->fb_lock);
+	return result;
+}
+
+/*
+ * futex_wake: wake up to N threads sleeping in futex_wait on ADDR.
+ * Returns the number woken.
+ */
+int
+sys_futex_wake(userptr_t addr, int n, int32_t *retval)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter *fw, **pp;
+	struct addrspace *as;
+	int woken;
+
+	if (((vaddr_t)addr & (sizeof(int) - 1)) != 0) {
+		return EINVAL;
+	}
+
+	as = curproc_getas();
+	fb = futex_hash(as, (vaddr_t)addr);
+	woken = 0;
+
+	lock_acquire(fb->fb_lock);
+	pp = &fb->fb_waiters;
+	while (*pp != NULL && woken < n) {
+		fw = *pp;
+		if (fw->fw_as == as && fw->fw_addr == (vaddr_t)addr) {
+			*pp = fw->fw_next;
+			fw->fw_next = NULL;
+			fw->fw_woken = true;
+			woken++;
+		}
+		else {
+			pp = &fw->fw_next;
+		}
+	}
+	if (woken > 0) {
+		cv_broadcast(fb->fb_cv, fb->fb_lock);
+	}
+	lock_release(fb->fb_lock);
+
+	*retval = woken;
+	return 0;
+}
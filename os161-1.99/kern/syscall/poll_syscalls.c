@@ -0,0 +1,272 @@
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <kern/time.h>
+#include <lib.h>
+#include <clock.h>
+#include <copyinout.h>
+#include <current.h>
+#include <proc.h>
+#include <vnode.h>
+#include <file.h>
+#include <poll.h>
+#include <syscall.h>
+
+/* bits that are reported whether they were asked for or not */
+#define POLL_ALWAYS (POLLERR | POLLHUP | POLLNVAL)
+
+/*
+ * The work of poll and select. FDS is in kernel memory; TIMEOUT is in
+ * milliseconds, or negative to wait forever.
+ *
+ * Every descriptor is looked up once, and we hang on to the openfiles
+ * until the end, so nothing we're on the pollq of can go away under us.
+ * The first pass puts our poller on each object's queue; after that
+ * we only wake when one of them does, and then look at them all again.
+ * (Once something is ready, there's no point queueing on the rest.)
+ */
+static
+int
+dopoll(struct pollfd *fds, unsigned nfds, int timeout, int *retval)
+{
+  struct openfile **files = NULL;
+  struct poller pl, *queue;
+  uint64_t deadline = 0, now;
+  unsigned i, ticks;
+  int n, revents, result;
+
+  if (nfds > 0) {
+    files = kmalloc(nfds * sizeof(files[0]));
+    if (files == NULL) {
+      return ENOMEM;
+    }
+  }
+  result = poller_init(&pl, nfds);
+  if (result) {
+    if (files != NULL) {
+      kfree(files);
+    }
+    return result;
+  }
+  for (i=0; i<nfds; i++) {
+    files[i] = NULL;
+    if (fds[i].fd >= 0) {
+      /* leaves files[i] NULL if it fails */
+      filetable_get(curproc->p_files, fds[i].fd, &files[i]);
+    }
+  }
+  if (timeout > 0) {
+    deadline = gettime_nsecs() + timeout * 1000000ULL;
+  }
+
+  queue = &pl;
+  while (1) {
+    n = 0;
+    for (i=0; i<nfds; i++) {
+      revents = 0;
+      if (fds[i].fd < 0) {
+        /* skipped */
+      }
+      else if (files[i] == NULL) {
+        revents = POLLNVAL;
+      }
+      else {
+        VOP_POLL(files[i]->of_vnode, fds[i].events,
+                 n == 0 ? queue : NULL, &revents);
+        revents &= fds[i].events | POLL_ALWAYS;
+      }
+      fds[i].revents = revents;
+      if (revents != 0) {
+        n++;
+      }
+    }
+    queue = NULL;
+
+    if (n > 0 || timeout == 0) {
+      break;
+    }
+    ticks = 0;
+    if (timeout > 0) {
+      now = gettime_nsecs();
+      if (now >= deadline) {
+        break;
+      }
+      ticks = timeout_nsecs2ticks(deadline - now);
+    }
+    poller_wait(&pl, ticks);
+  }
+
+  poller_cleanup(&pl);
+  for (i=0; i<nfds; i++) {
+    if (files[i] != NULL) {
+      openfile_decref(files[i]);
+    }
+  }
+  if (files != NULL) {
+    kfree(files);
+  }
+  *retval = n;
+  return 0;
+}
+
+/* handler for poll() system call */
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout, int *retval)
+{
+  struct pollfd *fds = NULL;
+  int result;
+
+  if (nfds > OPEN_MAX) {
+    return EINVAL;
+  }
+  if (nfds > 0) {
+    fds = kmalloc(nfds * sizeof(fds[0]));
+    if (fds == NULL) {
+      return ENOMEM;
+    }
+    result = copyin(ufds, fds, nfds * sizeof(fds[0]));
+    if (result) {
+      kfree(fds);
+      return result;
+    }
+  }
+
+  result = dopoll(fds, nfds, timeout, retval);
+  if (result == 0 && nfds > 0) {
+    result = copyout(fds, ufds, nfds * sizeof(fds[0]));
+  }
+  if (fds != NULL) {
+    kfree(fds);
+  }
+  return result;
+}
+
+/*
+ * Copy in a descriptor set for select, or clear it if the user
+ * pointer is NULL.
+ */
+static
+int
+select_copyin(userptr_t uset, fd_set *set)
+{
+  if (uset == NULL) {
+    FD_ZERO(set);
+    return 0;
+  }
+  return copyin(uset, set, sizeof(*set));
+}
+
+/* handler for select() system call */
+int
+sys_select(int nfds, userptr_t ureadfds, userptr_t uwritefds,
+           userptr_t uexceptfds, userptr_t utimeout, int *retval)
+{
+  fd_set sets[3];
+  struct pollfd *fds;
+  struct timeval tv;
+  unsigned npoll, i;
+  int fd, timeout, n, result;
+
+  if (nfds < 0 || nfds > FD_SETSIZE) {
+    return EINVAL;
+  }
+  result = select_copyin(ureadfds, &sets[0]);
+  if (result == 0) {
+    result = select_copyin(uwritefds, &sets[1]);
+  }
+  if (result == 0) {
+    result = select_copyin(uexceptfds, &sets[2]);
+  }
+  if (result) {
+    return result;
+  }
+
+  timeout = -1;
+  if (utimeout != NULL) {
+    result = copyin(utimeout, &tv, sizeof(tv));
+    if (result) {
+      return result;
+    }
+    if (tv.tv_sec < 0 || tv.tv_usec < 0 || tv.tv_usec >= 1000000) {
+      return EINVAL;
+    }
+    /* round up to whole milliseconds; anything huge is forever */
+    if (tv.tv_sec < 0x7fffffff / 1000 - 1) {
+      timeout = tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+    }
+  }
+
+  /* turn the sets into one pollfd per descriptor mentioned */
+  fds = kmalloc(FD_SETSIZE * sizeof(fds[0]));
+  if (fds == NULL) {
+    return ENOMEM;
+  }
+  npoll = 0;
+  for (fd=0; fd<nfds; fd++) {
+    fds[npoll].fd = fd;
+    fds[npoll].events = 0;
+    if (FD_ISSET(fd, &sets[0])) {
+      fds[npoll].events |= POLLIN;
+    }
+    if (FD_ISSET(fd, &sets[1])) {
+      fds[npoll].events |= POLLOUT;
+    }
+    if (FD_ISSET(fd, &sets[2])) {
+      fds[npoll].events |= POLLPRI;
+    }
+    if (fds[npoll].events != 0) {
+      npoll++;
+    }
+  }
+
+  result = dopoll(fds, npoll, timeout, &n);
+  if (result) {
+    kfree(fds);
+    return result;
+  }
+
+  /* and back again */
+  FD_ZERO(&sets[0]);
+  FD_ZERO(&sets[1]);
+  FD_ZERO(&sets[2]);
+  n = 0;
+  for (i=0; i<npoll; i++) {
+    fd = fds[i].fd;
+    if (fds[i].revents & POLLNVAL) {
+      kfree(fds);
+      return EBADF;
+    }
+    /* end of file and errors count as ready, since I/O won't block */
+    if ((fds[i].events & POLLIN) &&
+        (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+      FD_SET(fd, &sets[0]);
+      n++;
+    }
+    if ((fds[i].events & POLLOUT) &&
+        (fds[i].revents & (POLLOUT | POLLERR))) {
+      FD_SET(fd, &sets[1]);
+      n++;
+    }
+    if (fds[i].revents & POLLPRI) {
+      FD_SET(fd, &sets[2]);
+      n++;
+    }
+  }
+  kfree(fds);
+
+  if (ureadfds != NULL) {
+    result = copyout(&sets[0], ureadfds, sizeof(sets[0]));
+  }
+  if (result == 0 && uwritefds != NULL) {
+    result = copyout(&sets[1], uwritefds, sizeof(sets[1]));
+  }
+  if (result == 0 && uexceptfds != NULL) {
+    result = copyout(&sets[2], uexceptfds, sizeof(sets[2]));
+  }
+  if (result) {
+    return result;
+  }
+  *retval = n;
+  return 0;
+}
@@ -2,6 +2,8 @@
 #include <kern/errno.h>
 #include <kern/unistd.h>
 #include <kern/wait.h>
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <lib.h>
 #include <syscall.h>
 #include <current.h>
@@ -9,6 +11,14 @@
 #include <thread.h>
 #include <addrspace.h>
 #include <copyinout.h>
+#include "opt-A2.h"
+#if OPT_A2
+#include <mips/trapframe.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <histogram.h>
+#include <file.h>
+#endif
 
   /* this implementation of sys__exit does not do anything with the exit code */
   /* this needs to be fixed to get exit() and waitpid() working properly */
@@ -17,9 +27,11 @@ void sys__exit(int exitcode) {
 
   struct addrspace *as;
   struct proc *p = curproc;
+#if !OPT_A2
   /* for now, just include this to keep the compiler from complaining about
      an unused variable */
   (void)exitcode;
+#endif
 
   DEBUG(DB_SYSCALL,"Syscall: _exit(%d)\n",exitcode);
 
@@ -33,15 +45,38 @@ void sys__exit(int exitcode) {
    * messily fatal.
    */
   as = curproc_setas(NULL);
+#if OPT_A2
+  if (p->p_vforked) {
+    /* it's our parent's; give it back */
+    proc_vforkdone(p);
+  }
+  else {
+    as_destroy(as);
+  }
+#else
   as_destroy(as);
+#endif
+
+#if OPT_A2
+  /* close our files; nobody waiting for us needs them */
+  filetable_destroy(p->p_files);
+  p->p_files = NULL;
+#endif
 
   /* detach this thread from its process */
   /* note: curproc cannot be used after this call */
   proc_remthread(curthread);
 
+#if OPT_A2
+  /* leave the exit status for our parent; if we have none, this
+     destroys the process, and if it's the last user process in the
+     system, that wakes up the kernel menu thread */
+  proc_exit(p, _MKWAIT_EXIT(exitcode));
+#else
   /* if this is the last user process in the system, proc_destroy()
      will wake up the kernel menu thread */
   proc_destroy(p);
+#endif
   
   thread_exit();
   /* thread_exit() does not return, so we should never get here */
@@ -49,6 +84,209 @@ void sys__exit(int exitcode) {
 }
 
 
+#if OPT_A2
+
+/* fork timings, in ns: how long the parent spends copying (process,
+   address space, trapframe) and how long until the child is about to
+   enter user mode, both counted from the start of the fork */
+static struct spinlock fork_statslock = SPINLOCK_INITIALIZER;
+static struct histogram fork_copyhist;
+static struct histogram fork_starthist;
+
+/* what the parent hands the child: its trapframe, and when it started */
+struct forkchild {
+  struct trapframe fc_tf;
+  uint64_t fc_start;
+};
+
+/* first thing the child runs: move the trapframe onto our own stack,
+   which is where mips_usermode needs it, and go to user mode */
+static void
+fork_child(void *data1, unsigned long data2)
+{
+  struct forkchild *fc = data1;
+  struct trapframe tf;
+  uint64_t start;
+
+  (void)data2;
+
+  tf = fc->fc_tf;
+  start = fc->fc_start;
+  kfree(fc);
+
+  spinlock_acquire(&fork_statslock);
+  hist_add(&fork_starthist, gettime_nsecs() - start);
+  spinlock_release(&fork_statslock);
+
+  enter_forked_process(&tf);
+  panic("return from enter_forked_process\n");
+}
+
+/* fork and vfork: make a child that returns from the same system
+   call, with either a copy of our address space or (for vfork) our
+   address space itself, in which case we wait for the child to
+   exec or exit before returning */
+static int
+dofork(struct trapframe *tf, bool isvfork, pid_t *retval)
+{
+  struct proc *child;
+  struct forkchild *fc;
+  uint64_t start;
+  pid_t pid;
+  int result;
+
+  start = gettime_nsecs();
+
+  fc = kmalloc(sizeof(*fc));
+  if (fc == NULL) {
+    return(ENOMEM);
+  }
+  fc->fc_tf = *tf;
+  fc->fc_start = start;
+
+  /* this gives it a pid and our cwd */
+  child = proc_create_runprogram(curproc->p_name);
+  if (child == NULL) {
+    kfree(fc);
+    return(ENPROC);
+  }
+
+  /* it shares our open files */
+  result = filetable_copy(curproc->p_files, &child->p_files);
+  if (result) {
+    proc_destroy(child);
+    kfree(fc);
+    return(result);
+  }
+
+  if (isvfork) {
+    /* lend it ours; nothing else needs doing to share it */
+    child->p_addrspace = curproc_getas();
+    child->p_vforked = true;
+  }
+  else {
+    /* the child isn't running, so nobody else can see its p_addrspace */
+    result = as_copy(curproc_getas(), &child->p_addrspace);
+    if (result) {
+      proc_destroy(child);
+      kfree(fc);
+      return(result);
+    }
+  }
+
+#if OPT_SYSTRACE
+  /* tracing follows the process tree */
+  child->p_systrace = curproc->p_systrace;
+#endif
+
+  /* it has to be our child before it can possibly exit */
+  proc_addchild(curproc, child);
+  pid = child->p_pid;
+
+  /* a vfork child gets our cpu, since we're about to go to sleep */
+  if (isvfork) {
+    result = thread_fork(curthread->t_name, child, fork_child, fc, 0);
+  }
+  else {
+    result = thread_fork_idle(curthread->t_name, child, fork_child, fc, 0);
+  }
+  if (result) {
+    proc_remchild(child);
+    if (!isvfork) {
+      as_destroy(child->p_addrspace);
+    }
+    child->p_addrspace = NULL;
+    proc_destroy(child);
+    kfree(fc);
+    return(result);
+  }
+
+  if (isvfork) {
+    /* the child is using our address space (and user stack) */
+    proc_vforkwait(child);
+  }
+  else {
+    spinlock_acquire(&fork_statslock);
+    hist_add(&fork_copyhist, gettime_nsecs() - start);
+    spinlock_release(&fork_statslock);
+  }
+
+  *retval = pid;
+  return(0);
+}
+
+/* handler for fork() system call */
+int
+sys_fork(struct trapframe *tf, pid_t *retval)
+{
+  return dofork(tf, false, retval);
+}
+
+/* handler for vfork() system call */
+int
+sys_vfork(struct trapframe *tf, pid_t *retval)
+{
+  return dofork(tf, true, retval);
+}
+
+/* handler for execv() system call; execprogram (runprogram.c) does
+   the work, and only returns if it fails */
+int
+sys_execv(userptr_t progname, userptr_t args)
+{
+  return execprogram(progname, args);
+}
+
+/* print the fork timings (for the menu) */
+void
+fork_printstats(bool reset)
+{
+  struct histogram copy, startup;
+
+  spinlock_acquire(&fork_statslock);
+  copy = fork_copyhist;
+  startup = fork_starthist;
+  if (reset) {
+    hist_init(&fork_copyhist);
+    hist_init(&fork_starthist);
+  }
+  spinlock_release(&fork_statslock);
+
+  kprintf("fork, parent's copying (proc, address space, trapframe):\n");
+  hist_print(&copy);
+  kprintf("fork and vfork, until child enters user mode:\n");
+  hist_print(&startup);
+  if (reset) {
+    kprintf("Fork histograms reset.\n");
+  }
+}
+
+/* handler for getpid() system call */
+int
+sys_getpid(pid_t *retval)
+{
+  *retval = curproc->p_pid;
+  return(0);
+}
+
+/* handler for waitpid() system call; proc_wait does the work,
+   including copying out the status */
+
+int
+sys_waitpid(pid_t pid,
+	    userptr_t status,
+	    int options,
+	    pid_t *retval)
+{
+  /* unlike wait4, waitpid has nowhere else to report to */
+  if (status == NULL) {
+    return(EFAULT);
+  }
+  return(proc_wait(pid, options, retval, status, NULL));
+}
+
+#else
+
 /* stub handler for getpid() system call                */
 int
 sys_getpid(pid_t *retval)
@@ -92,3 +330,85 @@ sys_waitpid(pid_t pid,
   return(0);
 }
 
+#endif /* OPT_A2 */
+
+
+/* convert accumulated cpu times (nanoseconds) to a struct rusage */
+
+static void
+cputimes_to_rusage(const struct cputimes *ct, struct rusage *ru)
+{
+  bzero(ru, sizeof(*ru));
+  ru->ru_utime.tv_sec = ct->ct_utime / 1000000000;
+  ru->ru_utime.tv_usec = (ct->ct_utime % 1000000000) / 1000;
+  ru->ru_stime.tv_sec = ct->ct_stime / 1000000000;
+  ru->ru_stime.tv_usec = (ct->ct_stime % 1000000000) / 1000;
+  ru->ru_nvcsw = ct->ct_nvcsw;
+  ru->ru_nivcsw = ct->ct_nivcsw;
+}
+
+/* handler for wait4(): waitpid() that also reports the child's usage */
+
+int
+sys_wait4(pid_t pid,
+	  userptr_t status,
+	  int options,
+	  userptr_t usage,
+	  pid_t *retval)
+{
+  struct cputimes ct;
+  struct rusage ru;
+  int result;
+#if OPT_A2
+  result = proc_wait(pid, options, retval, status, &ct);
+  if (result) {
+    return(result);
+  }
+  if (*retval == 0) {
+    /* WNOHANG, and nothing to reap yet */
+    return(0);
+  }
+  if (usage == NULL) {
+    return(0);
+  }
+#else
+  result = sys_waitpid(pid, status, options, retval);
+  if (result) {
+    return(result);
+  }
+  if (usage == NULL) {
+    return(0);
+  }
+
+  /* waitpid is still a stub and doesn't know about the child, so there
+     is nothing to report for it yet; report zero rather than make
+     something up */
+  bzero(&ct, sizeof(ct));
+#endif
+  cputimes_to_rusage(&ct, &ru);
+  return(copyout(&ru, usage, sizeof(ru)));
+}
+
+/* handler for getrusage() */
+
+int
+sys_getrusage(int who, userptr_t usage)
+{
+  struct cputimes ct;
+  struct rusage ru;
+
+  switch (who) {
+  case RUSAGE_SELF:
+    proc_gettimes(curproc, &ct);
+    break;
+  case RUSAGE_CHILDREN:
+    spinlock_acquire(&curproc->p_lock);
+    ct = curproc->p_ctimes;
+    spinlock_release(&curproc->p_lock);
+    break;
+  default:
+    return(EINVAL);
+  }
+  cputimes_to_rusage(&ct, &ru);
+  return(copyout(&ru, usage, sizeof(ru)));
+}
@@ -36,14 +36,412 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <limits.h>
 #include <lib.h>
+#include <spinlock.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
 #include <vm.h>
 #include <vfs.h>
+#include <copyinout.h>
+#include <file.h>
 #include <syscall.h>
 #include <test.h>
+#include "opt-A2.h"
+
+#if OPT_A2
+
+/*
+ * Program arguments.
+ *
+ * Both runprogram and execv gather the arguments into one ARG_MAX
+ * buffer laid out just as they'll sit at the top of the new user
+ * stack: the argv array (argc+1 pointers, the last one NULL) followed
+ * by the strings. While the buffer is being filled in, each argv slot
+ * holds the offset of its string; progargs_copyout turns those into
+ * user addresses and copies the whole block out at once. So execv
+ * costs one copyin per page of the caller's argv array, one
+ * copyinstr per argument, and a single copyout.
+ */
+struct progargs {
+	char *pa_buf;		/* ARG_MAX bytes */
+	size_t pa_len;		/* bytes in use */
+	unsigned pa_argc;
+};
+
+/*
+ * The buffers are big enough that it's worth keeping one around for
+ * the next exec instead of going back to kmalloc every time.
+ */
+static struct spinlock argbuf_lock = SPINLOCK_INITIALIZER;
+static char *argbuf_spare;
+
+static
+int
+progargs_init(struct progargs *pa)
+{
+	spinlock_acquire(&argbuf_lock);
+	pa->pa_buf = argbuf_spare;
+	argbuf_spare = NULL;
+	spinlock_release(&argbuf_lock);
+
+	if (pa->pa_buf == NULL) {
+		pa->pa_buf = kmalloc(ARG_MAX);
+		if (pa->pa_buf == NULL) {
+			return ENOMEM;
+		}
+	}
+	pa->pa_len = 0;
+	pa->pa_argc = 0;
+	return 0;
+}
+
+static
+void
+progargs_cleanup(struct progargs *pa)
+{
+	spinlock_acquire(&argbuf_lock);
+	if (argbuf_spare == NULL) {
+		argbuf_spare = pa->pa_buf;
+		pa->pa_buf = NULL;
+	}
+	spinlock_release(&argbuf_lock);
+
+	if (pa->pa_buf != NULL) {
+		kfree(pa->pa_buf);
+		pa->pa_buf = NULL;
+	}
+}
+
+/*
+ * Load the arguments from a kernel array of NARGS strings.
+ */
+static
+int
+progargs_set(struct progargs *pa, unsigned nargs, char **args)
+{
+	vaddr_t *argv = (vaddr_t *)pa->pa_buf;
+	size_t len, slen;
+	unsigned i;
+
+	if (nargs >= ARG_MAX / sizeof(vaddr_t)) {
+		return E2BIG;
+	}
+	len = (nargs + 1) * sizeof(vaddr_t);
+	for (i=0; i<nargs; i++) {
+		slen = strlen(args[i]) + 1;
+		if (slen > ARG_MAX - len) {
+			return E2BIG;
+		}
+		memcpy(pa->pa_buf + len, args[i], slen);
+		argv[i] = len;
+		len += slen;
+	}
+	argv[nargs] = 0;
+
+	pa->pa_len = len;
+	pa->pa_argc = nargs;
+	return 0;
+}
+
+/*
+ * Load the arguments from the NULL-terminated user array UARGV.
+ */
+static
+int
+progargs_copyin(struct progargs *pa, userptr_t uargv)
+{
+	vaddr_t *argv = (vaddr_t *)pa->pa_buf;
+	vaddr_t uaddr = (vaddr_t)uargv;
+	size_t off, chunk, len, got;
+	unsigned i, argc;
+	int result;
+
+	if (uaddr % sizeof(vaddr_t) != 0) {
+		return EFAULT;
+	}
+
+	/*
+	 * The argv array, up to the end of a page at a time (so we
+	 * don't fault on a page past the NULL), until we find the NULL.
+	 */
+	off = 0;
+	argc = 0;
+	while (1) {
+		chunk = PAGE_SIZE - (uaddr + off) % PAGE_SIZE;
+		if (chunk > ARG_MAX - off) {
+			chunk = ARG_MAX - off;
+		}
+		if (chunk == 0) {
+			return E2BIG;
+		}
+		result = copyin((const_userptr_t)(uaddr + off),
+				pa->pa_buf + off, chunk);
+		if (result) {
+			return result;
+		}
+		off += chunk;
+		while (argc < off / sizeof(vaddr_t) && argv[argc] != 0) {
+			argc++;
+		}
+		if (argc < off / sizeof(vaddr_t)) {
+			break;
+		}
+	}
+
+	/* The strings go straight in after the array. */
+	len = (argc + 1) * sizeof(vaddr_t);
+	for (i=0; i<argc; i++) {
+		result = copyinstr((const_userptr_t)argv[i], pa->pa_buf + len,
+				   ARG_MAX - len, &got);
+		if (result == ENAMETOOLONG) {
+			return E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		argv[i] = len;
+		len += got;
+	}
+
+	pa->pa_len = len;
+	pa->pa_argc = argc;
+	return 0;
+}
+
+/*
+ * Copy the arguments out to the top of the stack at *STACKPTR. Hands
+ * back the new stack pointer and the user address of argv, which is
+ * where the stack pointer ends up.
+ */
+static
+int
+progargs_copyout(struct progargs *pa, vaddr_t *stackptr, userptr_t *uargv)
+{
+	vaddr_t *argv = (vaddr_t *)pa->pa_buf;
+	size_t total;
+	vaddr_t sp;
+	unsigned i;
+	int result;
+
+	/* Keep the stack pointer 8-aligned, as the MIPS ABI wants. */
+	total = ROUNDUP(pa->pa_len, 8);
+	bzero(pa->pa_buf + pa->pa_len, total - pa->pa_len);
+	sp = *stackptr - total;
+
+	for (i=0; i<pa->pa_argc; i++) {
+		argv[i] += sp;
+	}
+	result = copyout(pa->pa_buf, (userptr_t)sp, total);
+	if (result) {
+		return result;
+	}
+
+	*stackptr = sp;
+	*uargv = (userptr_t)sp;
+	return 0;
+}
+
+/*
+ * Load PROGNAME into a new address space, make that curproc's, and
+ * put the arguments on its stack. If REUSESTACK is set, the new
+ * address space takes over the old one's stack pages rather than
+ * allocating its own. On failure, curproc is left with its old
+ * address space as it was. (Nothing writes to the stack before
+ * progargs_copyout, and a copyout too big for the stack faults on its
+ * first byte, so a borrowed stack goes back untouched.)
+ *
+ * Calls vfs_open on progname and thus may destroy it.
+ */
+static
+int
+loadprogram(char *progname, struct progargs *pa, bool reusestack,
+	    vaddr_t *entrypoint, vaddr_t *stackptr, userptr_t *uargv)
+{
+	struct addrspace *as, *oldas;
+	struct vnode *v;
+	int result;
+
+	/* Open the file. */
+	result = vfs_open(progname, O_RDONLY, 0, &v);
+	if (result) {
+		return result;
+	}
+
+	/* Create a new address space. */
+	as = as_create();
+	if (as == NULL) {
+		vfs_close(v);
+		return ENOMEM;
+	}
+
+	oldas = curproc_getas();
+	if (oldas == NULL) {
+		reusestack = false;
+	}
+	if (reusestack) {
+		as_movestack(as, oldas);
+	}
+
+	/* Switch to it and activate it. */
+	curproc_setas(as);
+	as_activate();
+
+	/* Load the executable. */
+	result = load_elf(v, entrypoint);
+
+	/* Done with the file now. */
+	vfs_close(v);
+
+	/* Define the user stack in the address space, and fill it in. */
+	if (!result) {
+		result = as_define_stack(as, stackptr);
+	}
+	if (!result) {
+		result = progargs_copyout(pa, stackptr, uargv);
+	}
+
+	if (result) {
+		curproc_setas(oldas);
+		as_activate();
+		if (reusestack) {
+			as_movestack(oldas, as);
+		}
+		as_destroy(as);
+		return result;
+	}
+	return 0;
+}
+
+/*
+ * Load program "progname" and start running it in usermode, with
+ * arguments ARGS[0] to ARGS[NARGS-1] (ARGS[0] is normally the program
+ * name). Does not return except on error.
+ *
+ * Calls vfs_open on progname and thus may destroy it.
+ */
+int
+runprogram(char *progname, int nargs, char **args)
+{
+	struct progargs pa;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	unsigned argc;
+	int result;
+
+	/* We should be a new process. */
+	KASSERT(curproc_getas() == NULL);
+	KASSERT(curproc->p_files == NULL);
+	KASSERT(nargs >= 0);
+
+	/* Give it stdin, stdout, and stderr. */
+	curproc->p_files = filetable_create();
+	if (curproc->p_files == NULL) {
+		return ENOMEM;
+	}
+	result = filetable_opencons(curproc->p_files);
+	if (result) {
+		return result;
+	}
+
+	result = progargs_init(&pa);
+	if (result) {
+		return result;
+	}
+	result = progargs_set(&pa, nargs, args);
+	if (!result) {
+		result = loadprogram(progname, &pa, false,
+				     &entrypoint, &stackptr, &argv);
+	}
+	argc = pa.pa_argc;
+	progargs_cleanup(&pa);
+	if (result) {
+		return result;
+	}
+
+	/* Warp to user mode. */
+	enter_new_process(argc, argv, stackptr, entrypoint);
+	
+	/* enter_new_process does not return. */
+	panic("enter_new_process returned\n");
+	return EINVAL;
+}
+
+/*
+ * The work of execv: replace the current process's program with the
+ * one named by the user string UPROGNAME, with the arguments in UARGV.
+ * Does not return except on error, in which case the process carries
+ * on with its old program.
+ *
+ * A vfork child is running in its parent's address space, which it
+ * hands back here; otherwise the old address space is destroyed,
+ * after its stack has been recycled for the new program.
+ */
+int
+execprogram(userptr_t uprogname, userptr_t uargv)
+{
+	struct progargs pa;
+	struct addrspace *oldas;
+	char *progname;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	unsigned argc;
+	bool vforked;
+	int result;
+
+	progname = kmalloc(PATH_MAX);
+	if (progname == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(uprogname, progname, PATH_MAX, NULL);
+	if (result) {
+		kfree(progname);
+		return result;
+	}
+	if (progname[0] == '\0') {
+		kfree(progname);
+		return EINVAL;
+	}
+
+	result = progargs_init(&pa);
+	if (result) {
+		kfree(progname);
+		return result;
+	}
+	result = progargs_copyin(&pa, uargv);
+
+	oldas = curproc_getas();
+	vforked = curproc->p_vforked;
+	if (!result) {
+		result = loadprogram(progname, &pa, !vforked,
+				     &entrypoint, &stackptr, &argv);
+	}
+	argc = pa.pa_argc;
+	progargs_cleanup(&pa);
+	kfree(progname);
+	if (result) {
+		return result;
+	}
+
+	if (vforked) {
+		proc_vforkdone(curproc);
+	}
+	else {
+		as_destroy(oldas);
+	}
+	/* any syscall ring was in the old image */
+	aring_unregister(curproc);
+
+	/* Warp to user mode. */
+	enter_new_process(argc, argv, stackptr, entrypoint);
+
+	/* enter_new_process does not return. */
+	panic("enter_new_process returned\n");
+	return EINVAL;
+}
+
+#else /* OPT_A2 */
 
 /*
  * Load program "progname" and start running it in usermode.
@@ -106,3 +504,5 @@ runprogram(char *progname)
 	return EINVAL;
 }
 
+
+#endif /* OPT_A2 */
@@ -0,0 +1,20 @@
+/*
+ * Scheduling system calls. See thread.h for affinity and priorities.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <syscall.h>
+#include <current.h>
+#include <thread.h>
+
+/*
+ * setaffinity: restrict the calling thread to the cpus whose bits are
+ * set in MASK (bit N is cpu N). If the current cpu isn't in the mask
+ * the thread has moved by the time this returns.
+ */
+int
+sys_setaffinity(unsigned mask)
+{
+	return thread_setaffinity(curthread, (cpumask_t)mask);
+}
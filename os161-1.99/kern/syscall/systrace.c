@@ -0,0 +1,480 @@
+/*
+ * System call statistics and tracing. See systrace.h for details.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/ioctl.h>
+#include <kern/syscall.h>
+#include <kern/systrace.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <uio.h>
+#include <copyinout.h>
+#include <histogram.h>
+#include <device.h>
+#include <vfs.h>
+#include <mips/trapframe.h>
+#include <systrace.h>
+#include "opt-A2.h"
+
+/* Trace records kept for readers of systrace: */
+#define SYSTRACE_RINGSIZE 1024
+
+/*
+ * One cpu's statistics, indexed by call number. Only touched by that
+ * cpu, with interrupts off; h_total in each histogram is the call
+ * count.
+ */
+struct systrace_cpu {
+	struct histogram stc_hist[SYSTRACE_NSYS];
+	uint32_t stc_errors[SYSTRACE_NSYS];
+};
+
+/* Indexed by c_number; NULL until systrace_bootstrap. */
+static struct systrace_cpu **systrace_cpus;
+static unsigned systrace_ncpus;
+
+/*
+ * The trace buffer: SYSTRACE_RINGSIZE records starting at
+ * systrace_head, of which systrace_count are in use.
+ */
+static struct spinlock systrace_ringlock = SPINLOCK_INITIALIZER;
+static struct systrace_rec *systrace_ring;
+static unsigned systrace_head;
+static unsigned systrace_count;
+static unsigned systrace_lost;		/* overwritten before being read */
+
+static struct device systrace_dev;
+
+/* Names of the calls the kernel knows about, for systrace_print. */
+static const struct {
+	unsigned callno;
+	const char *name;
+} systrace_names[] = {
+	{ SYS_fork,		"fork" },
+	{ SYS_vfork,		"vfork" },
+	{ SYS_execv,		"execv" },
+	{ SYS_waitpid,		"waitpid" },
+	{ SYS_getpid,		"getpid" },
+	{ SYS_wait4,		"wait4" },
+	{ SYS_getrusage,	"getrusage" },
+	{ SYS_open,		"open" },
+	{ SYS_pipe,		"pipe" },
+	{ SYS_dup2,		"dup2" },
+	{ SYS_close,		"close" },
+	{ SYS_read,		"read" },
+	{ SYS_pread,		"pread" },
+	{ SYS_readv,		"readv" },
+	{ SYS_write,		"write" },
+	{ SYS_pwrite,		"pwrite" },
+	{ SYS_writev,		"writev" },
+	{ SYS_lseek,		"lseek" },
+	{ SYS_fsync,		"fsync" },
+	{ SYS_ioctl,		"ioctl" },
+	{ SYS_select,		"select" },
+	{ SYS_poll,		"poll" },
+	{ SYS___time,		"__time" },
+	{ SYS_reboot,		"reboot" },
+	{ SYS_setaffinity,	"setaffinity" },
+	{ SYS_futex_wait,	"futex_wait" },
+	{ SYS_futex_wake,	"futex_wake" },
+	{ SYS_aring_setup,	"aring_setup" },
+	{ SYS_aring_enter,	"aring_enter" },
+};
+
+static
+const char *
+systrace_name(unsigned callno)
+{
+	unsigned i;
+
+	for (i=0; i<sizeof(systrace_names)/sizeof(systrace_names[0]); i++) {
+		if (systrace_names[i].callno == callno) {
+			return systrace_names[i].name;
+		}
+	}
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Hooks for syscall()
+
+void
+systrace_enter(struct systrace_call *sc, unsigned callno,
+	       const struct trapframe *tf)
+{
+	sc->sc_callno = callno;
+	sc->sc_args[0] = tf->tf_a0;
+	sc->sc_args[1] = tf->tf_a1;
+	sc->sc_args[2] = tf->tf_a2;
+	sc->sc_args[3] = tf->tf_a3;
+	sc->sc_start = gettime_nsecs();
+}
+
+/*
+ * Put a record in the trace buffer, overwriting the oldest one if
+ * it's full.
+ */
+static
+void
+systrace_record(const struct systrace_call *sc, const struct trapframe *tf,
+		uint64_t nsecs)
+{
+	struct systrace_rec rec;
+
+	rec.sr_start = sc->sc_start;
+#if OPT_A2
+	rec.sr_pid = curproc->p_pid;
+#else
+	rec.sr_pid = 0;
+#endif
+	rec.sr_callno = sc->sc_callno;
+	rec.sr_args[0] = sc->sc_args[0];
+	rec.sr_args[1] = sc->sc_args[1];
+	rec.sr_args[2] = sc->sc_args[2];
+	rec.sr_args[3] = sc->sc_args[3];
+	if (tf->tf_a3 != 0) {
+		rec.sr_retval = -1;
+		rec.sr_error = tf->tf_v0;
+	}
+	else {
+		rec.sr_retval = tf->tf_v0;
+		rec.sr_error = 0;
+	}
+	rec.sr_nsecs = nsecs > 0xffffffff ? 0xffffffff : nsecs;
+	rec.sr_unused = 0;
+
+	spinlock_acquire(&systrace_ringlock);
+	if (systrace_count == SYSTRACE_RINGSIZE) {
+		systrace_head = (systrace_head + 1) % SYSTRACE_RINGSIZE;
+		systrace_count--;
+		systrace_lost++;
+	}
+	systrace_ring[(systrace_head + systrace_count) % SYSTRACE_RINGSIZE] =
+		rec;
+	systrace_count++;
+	spinlock_release(&systrace_ringlock);
+}
+
+void
+systrace_exit(struct systrace_call *sc, const struct trapframe *tf)
+{
+	struct systrace_cpu *stc;
+	uint64_t nsecs;
+	int spl;
+
+	if (systrace_cpus == NULL || sc->sc_callno >= SYSTRACE_NSYS) {
+		return;
+	}
+	nsecs = gettime_nsecs() - sc->sc_start;
+
+	/* interrupts off keeps us on this cpu and its counters ours */
+	spl = splhigh();
+	stc = systrace_cpus[curcpu->c_number];
+	hist_add(&stc->stc_hist[sc->sc_callno], nsecs);
+	if (tf->tf_a3 != 0) {
+		stc->stc_errors[sc->sc_callno]++;
+	}
+	splx(spl);
+
+	if (curproc->p_systrace) {
+		systrace_record(sc, tf, nsecs);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Reading the statistics
+
+/*
+ * Add up every cpu's statistics into HISTS and ERRORS, which have
+ * SYSTRACE_NSYS entries each. The other cpus keep counting while we
+ * look, so the result can be a little off; that's fine here.
+ */
+static
+void
+systrace_sum(struct histogram *hists, uint32_t *errors)
+{
+	struct systrace_cpu *stc;
+	unsigned i, n;
+
+	for (n=0; n<SYSTRACE_NSYS; n++) {
+		hist_init(&hists[n]);
+		errors[n] = 0;
+	}
+	for (i=0; i<systrace_ncpus; i++) {
+		stc = systrace_cpus[i];
+		for (n=0; n<SYSTRACE_NSYS; n++) {
+			hist_merge(&hists[n], &stc->stc_hist[n]);
+			errors[n] += stc->stc_errors[n];
+		}
+	}
+}
+
+/*
+ * Zero the statistics. As with systrace_sum, a call being counted on
+ * another cpu at the same moment may or may not survive.
+ */
+static
+void
+systrace_reset(void)
+{
+	unsigned i;
+
+	for (i=0; i<systrace_ncpus; i++) {
+		bzero(systrace_cpus[i], sizeof(*systrace_cpus[i]));
+	}
+}
+
+void
+systrace_print(bool hist, bool reset)
+{
+	struct histogram *hists;
+	uint32_t errors[SYSTRACE_NSYS];
+	unsigned order[SYSTRACE_NSYS];
+	unsigned i, j, n, count;
+	const char *name;
+	char num[16];
+
+	if (systrace_cpus == NULL) {
+		kprintf("systrace: Not started yet\n");
+		return;
+	}
+	hists = kmalloc(SYSTRACE_NSYS * sizeof(hists[0]));
+	if (hists == NULL) {
+		kprintf("systrace: Out of memory\n");
+		return;
+	}
+	systrace_sum(hists, errors);
+	if (reset) {
+		systrace_reset();
+	}
+
+	/* Sort the calls that happened by total time, biggest first. */
+	count = 0;
+	for (n=0; n<SYSTRACE_NSYS; n++) {
+		if (hists[n].h_total == 0) {
+			continue;
+		}
+		for (i = count;
+		     i > 0 && hists[order[i-1]].h_sum < hists[n].h_sum; i--) {
+			order[i] = order[i-1];
+		}
+		order[i] = n;
+		count++;
+	}
+
+	kprintf("%u different system calls made%s\n", count,
+		reset ? " (counters reset)" : "");
+	if (count > 0) {
+		kprintf("%-12s %10s %8s %12s %10s %10s\n",
+			"call", "count", "errors", "total(us)",
+			"mean(ns)", "max(us)");
+	}
+	for (j=0; j<count; j++) {
+		n = order[j];
+		name = systrace_name(n);
+		if (name == NULL) {
+			snprintf(num, sizeof(num), "#%u", n);
+			name = num;
+		}
+		kprintf("%-12s %10u %8u %12llu %10llu %10llu\n",
+			name, hists[n].h_total, errors[n],
+			hists[n].h_sum / 1000,
+			hists[n].h_sum / hists[n].h_total,
+			hists[n].h_max / 1000);
+		if (hist) {
+			hist_print(&hists[n]);
+		}
+	}
+	kfree(hists);
+}
+
+////////////////////////////////////////////////////////////
+// The systrace: device
+
+/*
+ * Open: allow reading only.
+ */
+static
+int
+systrace_open(struct device *dev, int openflags)
+{
+	(void)dev;
+
+	if (openflags != O_RDONLY) {
+		return EIO;
+	}
+	return 0;
+}
+
+static
+int
+systrace_close(struct device *dev)
+{
+	(void)dev;
+	return 0;
+}
+
+/*
+ * Read: hand out as many whole trace records as fit, oldest first.
+ * Doesn't wait for more; a read with nothing buffered returns 0.
+ */
+static
+int
+systrace_io(struct device *dev, struct uio *uio)
+{
+	struct systrace_rec rec;
+	int result;
+
+	(void)dev;
+
+	if (uio->uio_rw != UIO_READ) {
+		return EIO;
+	}
+
+	while (uio->uio_resid >= sizeof(rec)) {
+		spinlock_acquire(&systrace_ringlock);
+		if (systrace_count == 0) {
+			spinlock_release(&systrace_ringlock);
+			break;
+		}
+		rec = systrace_ring[systrace_head];
+		systrace_head = (systrace_head + 1) % SYSTRACE_RINGSIZE;
+		systrace_count--;
+		spinlock_release(&systrace_ringlock);
+
+		/* uiomove can fault, so not under the spinlock */
+		result = uiomove(&rec, sizeof(rec), uio);
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Copy the summed statistics out to DATA, as struct systrace_stat
+ * [SYSTRACE_NSYS].
+ */
+static
+int
+systrace_getstats(userptr_t data)
+{
+	struct histogram *hists;
+	struct systrace_stat *stats;
+	uint32_t errors[SYSTRACE_NSYS];
+	unsigned n, b;
+	int result;
+
+	COMPILE_ASSERT(SYSTRACE_BUCKETS == HIST_BUCKETS);
+
+	hists = kmalloc(SYSTRACE_NSYS * sizeof(hists[0]));
+	if (hists == NULL) {
+		return ENOMEM;
+	}
+	stats = kmalloc(SYSTRACE_NSYS * sizeof(stats[0]));
+	if (stats == NULL) {
+		kfree(hists);
+		return ENOMEM;
+	}
+
+	systrace_sum(hists, errors);
+	for (n=0; n<SYSTRACE_NSYS; n++) {
+		stats[n].ss_count = hists[n].h_total;
+		stats[n].ss_errors = errors[n];
+		stats[n].ss_totalns = hists[n].h_sum;
+		stats[n].ss_maxns = hists[n].h_max;
+		for (b=0; b<SYSTRACE_BUCKETS; b++) {
+			stats[n].ss_hist[b] = hists[n].h_count[b];
+		}
+	}
+	result = copyout(stats, data, SYSTRACE_NSYS * sizeof(stats[0]));
+
+	kfree(stats);
+	kfree(hists);
+	return result;
+}
+
+static
+int
+systrace_ioctl(struct device *dev, int op, userptr_t data)
+{
+	unsigned lost;
+
+	(void)dev;
+
+	switch (op) {
+	    case SYSTRACE_IOC_TRACE:
+		/* only ever looked at by the process itself */
+		curproc->p_systrace = true;
+		return 0;
+	    case SYSTRACE_IOC_UNTRACE:
+		curproc->p_systrace = false;
+		return 0;
+	    case SYSTRACE_IOC_STATS:
+		return systrace_getstats(data);
+	    case SYSTRACE_IOC_RESET:
+		systrace_reset();
+		return 0;
+	    case SYSTRACE_IOC_LOST:
+		spinlock_acquire(&systrace_ringlock);
+		lost = systrace_lost;
+		systrace_lost = 0;
+		spinlock_release(&systrace_ringlock);
+		return copyout(&lost, data, sizeof(lost));
+	}
+	return EIOCTL;
+}
+
+////////////////////////////////////////////////////////////
+
+void
+systrace_bootstrap(void)
+{
+	struct systrace_cpu **cpus;
+	unsigned i, n;
+	int result;
+
+	n = thread_numcpus();
+	cpus = kmalloc(n * sizeof(cpus[0]));
+	if (cpus == NULL) {
+		panic("systrace_bootstrap: Out of memory\n");
+	}
+	for (i=0; i<n; i++) {
+		cpus[i] = kmalloc(sizeof(*cpus[i]));
+		if (cpus[i] == NULL) {
+			panic("systrace_bootstrap: Out of memory\n");
+		}
+		bzero(cpus[i], sizeof(*cpus[i]));
+		KASSERT(thread_getcpu(i)->c_number == i);
+	}
+	systrace_ring = kmalloc(SYSTRACE_RINGSIZE * sizeof(systrace_ring[0]));
+	if (systrace_ring == NULL) {
+		panic("systrace_bootstrap: Out of memory\n");
+	}
+
+	systrace_dev.d_open = systrace_open;
+	systrace_dev.d_close = systrace_close;
+	systrace_dev.d_io = systrace_io;
+	systrace_dev.d_ioctl = systrace_ioctl;
+	systrace_dev.d_poll = NULL;
+	systrace_dev.d_blocks = 0;
+	systrace_dev.d_blocksize = 1;
+	systrace_dev.d_data = NULL;
+	result = vfs_adddev("systrace", &systrace_dev, 0);
+	if (result) {
+		panic("systrace_bootstrap: vfs_adddev: %s\n", strerror(result));
+	}
+
+	/* this turns on counting; no user process has run yet */
+	systrace_ncpus = n;
+	systrace_cpus = cpus;
+}
@@ -32,11 +32,14 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <clock.h>
 #include <thread.h>
+#include <current.h>
 #include <synch.h>
 #include <test.h>
+#include <lamebus/ltimer.h>
 
 #define NSEMLOOPS     63
 #define NLOCKLOOPS    120
@@ -82,7 +85,7 @@ inititems(void)
 		}
 	}
 	if (testlock==NULL) {
-		testlock = lock_create("testlock");
+		testlock = lock_create_flags("testlock", LOCK_ADAPTIVE);
 		if (testlock == NULL) {
 			panic("synchtest: lock_create failed\n");
 		}
@@ -248,6 +251,8 @@ locktest(int nargs, char **args)
 		P(donesem);
 	}
 
+	kprintf("Lock test: %u acquires spun, %u slept\n",
+		testlock->lk_spins, testlock->lk_sleeps);
 #ifdef UW
   cleanitems();
 #endif
@@ -347,3 +352,795 @@ cvtest(int nargs, char **args)
 
 	return 0;
 }
+
+/*
+ * Reader-writer lock test. For 1, 2, ... up to all the cpus, run one
+ * thread pinned to each, all hammering the same rwlock for reading,
+ * and report the aggregate read rate. Every RWWRITEEVERY-th pass a
+ * thread writes instead (downgrading halfway), which checks that
+ * writers exclude readers and aren't starved.
+ */
+
+#define NRWLOOPS	20000
+#define RWWRITEEVERY	1000
+
+static struct rwlock *testrw;
+static volatile unsigned long rwval1;
+static volatile unsigned long rwval2;
+
+static
+void
+rwtestthread(void *junk, unsigned long num)
+{
+	unsigned long v1, v2;
+	int i, result;
+
+	(void)junk;
+
+	result = thread_setaffinity(curthread, CPUMASK_CPU(num));
+	if (result) {
+		panic("rwlocktest: thread_setaffinity: %s\n",
+		      strerror(result));
+	}
+
+	for (i=0; i<NRWLOOPS; i++) {
+		if (i % RWWRITEEVERY == RWWRITEEVERY - 1) {
+			rwlock_acquire_write(testrw);
+			rwval1++;
+			rwval2++;
+			rwlock_downgrade(testrw);
+		}
+		else {
+			rwlock_acquire_read(testrw);
+		}
+		v1 = rwval1;
+		v2 = rwval2;
+		if (v1 != v2) {
+			panic("rwlocktest: reader saw a torn write "
+			      "(%lu != %lu)\n", v1, v2);
+		}
+		rwlock_release_read(testrw);
+	}
+	V(donesem);
+}
+
+int
+rwlocktest(int nargs, char **args)
+{
+	unsigned ncpus, n, i;
+	uint64_t start, nsecs;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	testrw = rwlock_create("testrw");
+	if (testrw == NULL) {
+		panic("rwlocktest: rwlock_create failed\n");
+	}
+	rwval1 = rwval2 = 0;
+
+	ncpus = thread_numcpus();
+	kprintf("Starting rwlock test on up to %u cpus...\n", ncpus);
+
+	for (n=1; n<=ncpus && n<=32; n++) {
+		start = gettime_nsecs();
+		for (i=0; i<n; i++) {
+			result = thread_fork("rwtest", NULL, rwtestthread,
+					     NULL, i);
+			if (result) {
+				panic("rwlocktest: thread_fork failed: %s\n",
+				      strerror(result));
+			}
+		}
+		for (i=0; i<n; i++) {
+			P(donesem);
+		}
+		nsecs = gettime_nsecs() - start;
+		if (nsecs == 0) {
+			nsecs = 1;
+		}
+		kprintf("%2u cpus: %llu reads/sec\n", n,
+			(unsigned long long)n * NRWLOOPS * 1000000000ULL
+			/ nsecs);
+	}
+
+	if (rwval1 != rwval2) {
+		panic("rwlocktest: final values differ\n");
+	}
+	rwlock_destroy(testrw);
+	testrw = NULL;
+	kprintf("RW lock test done.\n");
+
+	return 0;
+}
+
+/*
+ * Spinlock test. For 2, 4 and 8 cpus (as many as there are), run one
+ * thread pinned to each, all taking and releasing the same spinlock
+ * as fast as they can for SLTIME. Report the total rate and how
+ * evenly the acquisitions were spread: with a fair lock every cpu
+ * should get about the same share.
+ */
+
+#define SLTIME		200000000ULL	/* 0.2 seconds, in ns */
+#define SLCHECKEVERY	64		/* look at the clock this often */
+
+static struct spinlock testspin = SPINLOCK_INITIALIZER;
+static uint64_t sldeadline;		/* protected by testspin */
+static volatile unsigned long slcounter;
+static unsigned long slcounts[32];
+
+/*
+ * A 64-bit value takes two stores on a 32-bit cpu, so reading
+ * sldeadline while it's being set could see half of it. Go through
+ * the lock.
+ */
+static
+void
+slsetdeadline(uint64_t deadline)
+{
+	spinlock_acquire(&testspin);
+	sldeadline = deadline;
+	spinlock_release(&testspin);
+}
+
+static
+uint64_t
+slgetdeadline(void)
+{
+	uint64_t deadline;
+
+	spinlock_acquire(&testspin);
+	deadline = sldeadline;
+	spinlock_release(&testspin);
+	return deadline;
+}
+
+static
+void
+spinlocktestthread(void *junk, unsigned long num)
+{
+	unsigned long count = 0;
+	uint64_t deadline;
+	int result;
+
+	(void)junk;
+
+	result = thread_setaffinity(curthread, CPUMASK_CPU(num));
+	if (result) {
+		panic("spinlocktest: thread_setaffinity: %s\n",
+		      strerror(result));
+	}
+
+	while ((deadline = slgetdeadline()) == 0) {
+		/* wait for the starting gun */
+	}
+	while (count % SLCHECKEVERY != 0 || gettime_nsecs() < deadline) {
+		spinlock_acquire(&testspin);
+		slcounter++;
+		spinlock_release(&testspin);
+		count++;
+	}
+	slcounts[num] = count;
+	V(donesem);
+}
+
+int
+spinlocktest(int nargs, char **args)
+{
+	static const unsigned sizes[] = { 2, 4, 8 };
+	unsigned ncpus, n, i, j;
+	unsigned long total, min, max;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	ncpus = thread_numcpus();
+	kprintf("Starting spinlock test on up to %u cpus...\n", ncpus);
+
+	for (j=0; j<sizeof(sizes)/sizeof(sizes[0]); j++) {
+		n = sizes[j];
+		if (n > ncpus) {
+			kprintf("%2u cpus: skipped\n", n);
+			continue;
+		}
+		slsetdeadline(0);
+		slcounter = 0;
+		for (i=0; i<n; i++) {
+			result = thread_fork("sltest", NULL,
+					     spinlocktestthread, NULL, i);
+			if (result) {
+				panic("spinlocktest: thread_fork failed: "
+				      "%s\n", strerror(result));
+			}
+		}
+		slsetdeadline(gettime_nsecs() + SLTIME);
+		for (i=0; i<n; i++) {
+			P(donesem);
+		}
+
+		total = 0;
+		min = max = slcounts[0];
+		for (i=0; i<n; i++) {
+			total += slcounts[i];
+			if (slcounts[i] < min) {
+				min = slcounts[i];
+			}
+			if (slcounts[i] > max) {
+				max = slcounts[i];
+			}
+		}
+		if (total != slcounter) {
+			panic("spinlocktest: counted %lu, expected %lu\n",
+			      slcounter, total);
+		}
+		kprintf("%2u cpus: %lu acquires/sec, per cpu min %lu "
+			"max %lu (%lu%%)\n", n,
+			(unsigned long)(total * 1000000000ULL / SLTIME),
+			min, max, max ? min * 100 / max : 100);
+	}
+
+	kprintf("Spinlock test done.\n");
+	return 0;
+}
+
+/*
+ * Wait time test. NTHREADS threads take turns at a lock (or binary
+ * semaphore) with a short critical section, timing how long each
+ * acquire takes. Done once with the ordinary primitive and once in
+ * handoff mode; handoff should cut the tail (p99, max) because no
+ * thread can be passed over again and again by newcomers.
+ */
+
+#define NTAILLOOPS	100
+#define TAILWORK	500	/* busy loop iterations inside */
+#define TAILPAUSE	250	/* and outside */
+
+static struct lock *taillock;
+static struct semaphore *tailsem;
+static uint32_t *tailsamples;
+
+static
+void
+tailtestthread(void *junk, unsigned long num)
+{
+	volatile unsigned j;
+	uint64_t start, waited;
+	unsigned i;
+
+	(void)junk;
+
+	for (i=0; i<NTAILLOOPS; i++) {
+		start = gettime_nsecs();
+		if (taillock != NULL) {
+			lock_acquire(taillock);
+		}
+		else {
+			P(tailsem);
+		}
+		waited = gettime_nsecs() - start;
+		tailsamples[num * NTAILLOOPS + i] =
+			waited > 0xffffffff ? 0xffffffff : waited;
+
+		for (j=0; j<TAILWORK; j++);
+
+		if (taillock != NULL) {
+			lock_release(taillock);
+		}
+		else {
+			V(tailsem);
+		}
+		for (j=0; j<TAILPAUSE; j++);
+	}
+	V(donesem);
+}
+
+/*
+ * Shell sort; there's no qsort in the kernel.
+ */
+static
+void
+sortsamples(uint32_t *a, unsigned n)
+{
+	unsigned gap, i, j;
+	uint32_t v;
+
+	for (gap = n/2; gap > 0; gap /= 2) {
+		for (i=gap; i<n; i++) {
+			v = a[i];
+			for (j=i; j >= gap && a[j-gap] > v; j -= gap) {
+				a[j] = a[j-gap];
+			}
+			a[j] = v;
+		}
+	}
+}
+
+static
+void
+tailrun(const char *what, struct lock *lk, struct semaphore *sem)
+{
+	unsigned i, n;
+	int result;
+
+	taillock = lk;
+	tailsem = sem;
+	for (i=0; i<NTHREADS; i++) {
+		result = thread_fork("tailtest", NULL, tailtestthread,
+				     NULL, i);
+		if (result) {
+			panic("tailtest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NTHREADS; i++) {
+		P(donesem);
+	}
+
+	n = NTHREADS * NTAILLOOPS;
+	sortsamples(tailsamples, n);
+	kprintf("%-14s p50 %7u us  p99 %7u us  max %7u us\n", what,
+		tailsamples[n / 2] / 1000,
+		tailsamples[n * 99 / 100] / 1000,
+		tailsamples[n - 1] / 1000);
+}
+
+int
+tailtest(int nargs, char **args)
+{
+	struct lock *lk;
+	struct semaphore *sem;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	tailsamples = kmalloc(NTHREADS * NTAILLOOPS * sizeof(uint32_t));
+	if (tailsamples == NULL) {
+		panic("tailtest: Out of memory\n");
+	}
+	kprintf("Starting wait time test...\n");
+
+	lk = lock_create("taillock");
+	if (lk == NULL) {
+		panic("tailtest: lock_create failed\n");
+	}
+	tailrun("lock", lk, NULL);
+	lock_destroy(lk);
+
+	lk = lock_create_flags("taillock", LOCK_HANDOFF);
+	if (lk == NULL) {
+		panic("tailtest: lock_create failed\n");
+	}
+	tailrun("lock handoff", lk, NULL);
+	lock_destroy(lk);
+
+	sem = sem_create("tailsem", 1);
+	if (sem == NULL) {
+		panic("tailtest: sem_create failed\n");
+	}
+	tailrun("sem", NULL, sem);
+	sem_destroy(sem);
+
+	sem = sem_create_flags("tailsem", 1, SEM_HANDOFF);
+	if (sem == NULL) {
+		panic("tailtest: sem_create failed\n");
+	}
+	tailrun("sem handoff", NULL, sem);
+	sem_destroy(sem);
+
+	kfree(tailsamples);
+	tailsamples = NULL;
+	kprintf("Wait time test done.\n");
+	return 0;
+}
+
+/*
+ * Priority inversion test. On one cpu, a low priority thread takes a
+ * lock and works for a bit while a high priority thread waits for it
+ * and a few medium priority threads hog the cpu. Without priority
+ * inheritance the low thread doesn't get to run until the hogs are
+ * done, and neither does the high one; with it, the high thread
+ * waits about as long as the low one's critical section. The same
+ * thing with a semaphore, which has no holder to boost, shows the
+ * unbounded case for comparison.
+ */
+
+#define NPIHOGS		3
+#define PIHOGTIME	1000000000ULL	/* 1 second, in ns */
+#define PIWORK		200000		/* low thread's critical section */
+
+static struct lock *pilock;
+static struct semaphore *pisem;
+static struct semaphore *piready;
+static volatile uint64_t pihogend;
+static volatile uint64_t piwait;
+
+static
+void
+pi_take(void)
+{
+	if (pilock != NULL) {
+		lock_acquire(pilock);
+	}
+	else {
+		P(pisem);
+	}
+}
+
+static
+void
+pi_drop(void)
+{
+	if (pilock != NULL) {
+		lock_release(pilock);
+	}
+	else {
+		V(pisem);
+	}
+}
+
+static
+void
+pithread(void *junk, unsigned long pri)
+{
+	volatile unsigned j;
+	uint64_t start;
+
+	(void)junk;
+
+	/* Everyone on cpu 0, so they really compete. */
+	thread_setaffinity(curthread, CPUMASK_CPU(0));
+	thread_setpriority(pri);
+
+	if (pri == PRI_MIN) {
+		pi_take();
+		V(piready);
+		for (j=0; j<PIWORK; j++);
+		pi_drop();
+	}
+	else if (pri == PRI_MAX) {
+		start = gettime_nsecs();
+		pi_take();
+		piwait = gettime_nsecs() - start;
+		pi_drop();
+	}
+	else {
+		while (gettime_nsecs() < pihogend) {
+			/* hog the cpu */
+		}
+	}
+	V(donesem);
+}
+
+static
+void
+pirun(const char *what)
+{
+	unsigned i;
+	int result;
+
+	pihogend = 0;
+	piwait = 0;
+
+	/* Low thread first; wait until it has the lock. */
+	result = thread_fork("pitest-low", NULL, pithread, NULL, PRI_MIN);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+	P(piready);
+
+	pihogend = gettime_nsecs() + PIHOGTIME;
+	for (i=0; i<NPIHOGS; i++) {
+		result = thread_fork("pitest-hog", NULL, pithread, NULL,
+				     PRI_DEFAULT);
+		if (result) {
+			panic("pitest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	result = thread_fork("pitest-high", NULL, pithread, NULL, PRI_MAX);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+
+	for (i=0; i<NPIHOGS+2; i++) {
+		P(donesem);
+	}
+	kprintf("%-10s high priority thread waited %llu us\n", what,
+		(unsigned long long)piwait / 1000);
+}
+
+/*
+ * Then, whom lock_release picks. NPIWAITERS threads of rising
+ * priority queue up for a lock one at a time, so first come first
+ * served would let the lowest one through first; they should get it
+ * highest first. And a thread handed a LOCK_HANDOFF lock while a
+ * higher priority thread has queued up behind it should hold the
+ * lock at that thread's priority, not its own.
+ */
+
+#define NPIWAITERS	3
+
+static const int piwaitpri[NPIWAITERS] = {
+	PRI_MIN + 4, PRI_DEFAULT, PRI_MAX - 4,
+};
+static volatile int piorder[NPIWAITERS];
+static volatile unsigned piturn;
+static volatile int piheldpri;
+
+static
+void
+piwaiter(void *junk, unsigned long pri)
+{
+	(void)junk;
+
+	thread_setaffinity(curthread, CPUMASK_CPU(0));
+	thread_setpriority(pri);
+
+	lock_acquire(pilock);
+	piorder[piturn++] = pri;
+	if (pri == PRI_MIN) {
+		piheldpri = curthread->t_pri;
+	}
+	lock_release(pilock);
+	V(donesem);
+}
+
+static
+void
+piforkwaiter(int pri, unsigned nwaiting)
+{
+	int result;
+
+	result = thread_fork("pitest-waiter", NULL, piwaiter, NULL, pri);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+	/* Let it get as far as sleeping on the lock. */
+	while (pilock->lk_nwaiting < nwaiting) {
+		clocknap(1);
+	}
+}
+
+static
+void
+piorderrun(void)
+{
+	unsigned i;
+
+	pilock = lock_create("pilock");
+	if (pilock == NULL) {
+		panic("pitest: Out of memory\n");
+	}
+	piturn = 0;
+
+	lock_acquire(pilock);
+	for (i=0; i<NPIWAITERS; i++) {
+		piforkwaiter(piwaitpri[i], i + 1);
+	}
+	lock_release(pilock);
+	for (i=0; i<NPIWAITERS; i++) {
+		P(donesem);
+	}
+
+	kprintf("order:     ");
+	for (i=0; i<NPIWAITERS; i++) {
+		kprintf(" %d", piorder[i]);
+	}
+	kprintf("\n");
+	for (i=0; i<NPIWAITERS; i++) {
+		if (piorder[i] != piwaitpri[NPIWAITERS - 1 - i]) {
+			kprintf("FAILED: waiters didn't get the lock "
+				"highest priority first\n");
+			break;
+		}
+	}
+
+	lock_destroy(pilock);
+	pilock = NULL;
+}
+
+static
+void
+pihandoffrun(void)
+{
+	int result;
+
+	pilock = lock_create_flags("pilock", LOCK_HANDOFF);
+	if (pilock == NULL) {
+		panic("pitest: Out of memory\n");
+	}
+	piturn = 0;
+	piheldpri = -1;
+
+	/*
+	 * Give the lock to a low thread, which can't run yet since
+	 * we're higher and on the same cpu, then queue a medium one
+	 * behind it. That one runs first once we sleep, finds the
+	 * lock taken by nobody in particular, and waits, so the low
+	 * thread only finds out about it when it takes the lock.
+	 */
+	lock_acquire(pilock);
+	piforkwaiter(PRI_MIN, 1);
+	lock_release(pilock);
+	result = thread_fork("pitest-waiter", NULL, piwaiter, NULL,
+			     PRI_DEFAULT);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+	P(donesem);
+	P(donesem);
+
+	kprintf("handoff:   low thread held the lock at priority %d\n",
+		piheldpri);
+	if (piheldpri != PRI_DEFAULT) {
+		kprintf("FAILED: new holder didn't inherit from the "
+			"waiter behind it\n");
+	}
+
+	lock_destroy(pilock);
+	pilock = NULL;
+}
+
+int
+pitest(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	piready = sem_create("piready", 0);
+	pisem = sem_create("pisem", 1);
+	pilock = lock_create("pilock");
+	if (piready == NULL || pisem == NULL || pilock == NULL) {
+		panic("pitest: Out of memory\n");
+	}
+
+	/*
+	 * Run at top priority while setting things up, so the hogs
+	 * can't keep us from forking the high thread.
+	 */
+	thread_setpriority(PRI_MAX);
+	kprintf("Starting priority inversion test...\n");
+
+	pirun("lock:");
+	if (piwait >= PIHOGTIME / 2) {
+		kprintf("FAILED: lock holder wasn't boosted\n");
+	}
+
+	lock_destroy(pilock);
+	pilock = NULL;
+	pirun("semaphore:");
+
+	/* These need us on the same cpu as the threads we fork. */
+	thread_setaffinity(curthread, CPUMASK_CPU(0));
+	piorderrun();
+	pihandoffrun();
+	thread_setaffinity(curthread, CPUMASK_ALL);
+
+	thread_setpriority(PRI_DEFAULT);
+	sem_destroy(pisem);
+	sem_destroy(piready);
+	kprintf("Priority inversion test done.\n");
+	return 0;
+}
+
+/*
+ * CV wakeup test. First, cv_timedwait with nobody to signal should
+ * time out, and no sooner than asked. Then NTHREADS threads wait on
+ * a CV and get broadcast to, and we count how many of them had to
+ * go back to sleep on the lock after waking up. With a plain lock
+ * the broadcast moves them onto the lock's queue and they come out
+ * one at a time, so that should be about none; with a handoff lock
+ * it wakes everyone at once, for comparison.
+ */
+
+#define CVWTICKS	10
+#define CVWWORK		2000	/* busy loop iterations holding the lock */
+
+static struct lock *cvwlock;
+static struct cv *cvwcv;
+static volatile unsigned cvwwaiting;
+static volatile bool cvwgo;
+
+static
+void
+cvwthread(void *junk, unsigned long num)
+{
+	volatile unsigned j;
+
+	(void)junk;
+	(void)num;
+
+	lock_acquire(cvwlock);
+	cvwwaiting++;
+	while (!cvwgo) {
+		cv_wait(cvwcv, cvwlock);
+	}
+	for (j=0; j<CVWWORK; j++);
+	lock_release(cvwlock);
+	V(donesem);
+}
+
+static
+void
+cvwrun(const char *what, unsigned flags)
+{
+	unsigned i, sleeps;
+	int result;
+
+	cvwlock = lock_create_flags("cvwlock", flags);
+	if (cvwlock == NULL) {
+		panic("cvwaketest: lock_create failed\n");
+	}
+	cvwwaiting = 0;
+	cvwgo = false;
+
+	for (i=0; i<NTHREADS; i++) {
+		result = thread_fork("cvwaketest", NULL, cvwthread, NULL, i);
+		if (result) {
+			panic("cvwaketest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	/* Wait until they're all asleep on the CV. */
+	lock_acquire(cvwlock);
+	while (cvwwaiting < NTHREADS) {
+		lock_release(cvwlock);
+		thread_yield();
+		lock_acquire(cvwlock);
+	}
+	sleeps = cvwlock->lk_sleeps;
+	cvwgo = true;
+	cv_broadcast(cvwcv, cvwlock);
+	lock_release(cvwlock);
+
+	for (i=0; i<NTHREADS; i++) {
+		P(donesem);
+	}
+	kprintf("%-14s %u of %u woken threads slept again on the lock\n",
+		what, cvwlock->lk_sleeps - sleeps, NTHREADS);
+	lock_destroy(cvwlock);
+}
+
+int
+cvwaketest(int nargs, char **args)
+{
+	uint64_t start, took;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	cvwcv = cv_create("cvwcv");
+	if (cvwcv == NULL) {
+		panic("cvwaketest: cv_create failed\n");
+	}
+	kprintf("Starting CV wakeup test...\n");
+
+	lock_acquire(testlock);
+	start = gettime_nsecs();
+	result = cv_timedwait(cvwcv, testlock, CVWTICKS);
+	took = gettime_nsecs() - start;
+	lock_release(testlock);
+	kprintf("cv_timedwait(%u ticks): %s after %llu us\n", CVWTICKS,
+		strerror(result), (unsigned long long)took / 1000);
+	if (result != ETIMEDOUT ||
+	    took < (uint64_t)(CVWTICKS - 1) * LT_GRANULARITY * 1000) {
+		kprintf("FAILED: timed wait didn't time out properly\n");
+	}
+
+	cvwrun("requeue:", 0);
+	cvwrun("wake all:", LOCK_HANDOFF);
+
+	cv_destroy(cvwcv);
+	kprintf("CV wakeup test done.\n");
+	return 0;
+}
@@ -35,13 +35,15 @@
 #include <thread.h>
 #include <lamebus/ltimer.h>
 #include <current.h>
+#include <spinlock.h>
+#include <rcu.h>
 
 /*
  * Time handling.
  *
- * This is pretty primitive. A real kernel will typically have some
- * kind of support for scheduling callbacks to happen at specific
- * points in the future, usually with more resolution that one second.
+ * This is pretty primitive. Callbacks can be scheduled for points in
+ * the future (see timeouts, below), but only to the resolution of the
+ * timer tick.
  *
  * A real kernel also has to maintain the time of day; in OS/161 we
  * skimp on that because we have a known-good hardware clock.
@@ -73,6 +75,19 @@ static struct wchan *minibolt;
  */
 static int minicount;
 
+/*
+ * Pending timeouts, soonest first, and the one whose function is
+ * being called right now (so timeout_cancel can wait for it, asleep
+ * on timeout_donechan). The clock for these is timeout_ticks, which
+ * counts timerclock calls.
+ */
+static struct spinlock timeout_lock = SPINLOCK_INITIALIZER;
+static struct timeout *timeout_head;
+static struct timeout *timeout_running;
+static uint64_t timeout_ticks;
+static struct wchan *timeout_donechan;
+static bool timeout_waiting;
+
 /*
  * Setup.
  */
@@ -87,6 +102,10 @@ hardclock_bootstrap(void)
 	if (minibolt == NULL) {
 		panic("Couldn't create minibolt\n");
 	}
+	timeout_donechan = wchan_create("timeout");
+	if (timeout_donechan == NULL) {
+		panic("Couldn't create timeout wchan\n");
+	}
 	minicount = MINI_PER_SECOND;
 	/* we assume MINI_PER_SECOND > 0 */
 	KASSERT(minicount > 0);
@@ -99,6 +118,8 @@ hardclock_bootstrap(void)
 void
 timerclock(void)
 {
+	struct timeout *to;
+
 	/* Broadcast on minibolt */
 	wchan_wakeall(minibolt);
 	/* Broadcast on lbolt if a second has elapsed */
@@ -106,6 +127,31 @@ timerclock(void)
 	  minicount = MINI_PER_SECOND;
 	  wchan_wakeall(lbolt);
 	}
+
+	/*
+	 * Call the timeouts that are due. Drop the lock while doing
+	 * it, since they'll be taking other locks (e.g. to wake
+	 * someone up) that are also held while calling timeout_add.
+	 */
+	spinlock_acquire(&timeout_lock);
+	timeout_ticks++;
+	while (timeout_head != NULL && timeout_head->to_when <= timeout_ticks) {
+		to = timeout_head;
+		timeout_head = to->to_next;
+		to->to_pending = false;
+		timeout_running = to;
+		spinlock_release(&timeout_lock);
+
+		to->to_func(to->to_data);
+
+		spinlock_acquire(&timeout_lock);
+		timeout_running = NULL;
+		if (timeout_waiting) {
+			timeout_waiting = false;
+			wchan_wakeall(timeout_donechan);
+		}
+	}
+	spinlock_release(&timeout_lock);
 }
 
 /*
@@ -120,6 +166,13 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+
+	/*
+	 * RCU read sections run with interrupts off, so we can't have
+	 * interrupted one: this is a quiescent state.
+	 */
+	rcu_quiescent();
+
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
@@ -155,3 +208,87 @@ clocknap(int num_ticks)
     num_ticks--;
   }
 }
+
+/*
+ * Timeouts.
+ */
+void
+timeout_init(struct timeout *to, void (*func)(void *), void *data)
+{
+	to->to_next = NULL;
+	to->to_when = 0;
+	to->to_func = func;
+	to->to_data = data;
+	to->to_pending = false;
+}
+
+void
+timeout_add(struct timeout *to, unsigned ticks)
+{
+	struct timeout **tp;
+
+	if (ticks == 0) {
+		/* The current tick is partly over; don't fire early. */
+		ticks = 1;
+	}
+
+	spinlock_acquire(&timeout_lock);
+	KASSERT(!to->to_pending);
+	to->to_when = timeout_ticks + ticks;
+
+	/* After everything due at the same time, to keep them in order. */
+	for (tp = &timeout_head; *tp != NULL; tp = &(*tp)->to_next) {
+		if ((*tp)->to_when > to->to_when) {
+			break;
+		}
+	}
+	to->to_next = *tp;
+	*tp = to;
+	to->to_pending = true;
+	spinlock_release(&timeout_lock);
+}
+
+bool
+timeout_cancel(struct timeout *to)
+{
+	struct timeout **tp;
+	bool ret;
+
+	spinlock_acquire(&timeout_lock);
+	ret = to->to_pending;
+	if (ret) {
+		for (tp = &timeout_head; *tp != to; tp = &(*tp)->to_next) {
+			KASSERT(*tp != NULL);
+		}
+		*tp = to->to_next;
+		to->to_next = NULL;
+		to->to_pending = false;
+	}
+	else {
+		/*
+		 * It may be going off right now; wait until it's done.
+		 * Sleep rather than yield, or a higher priority caller
+		 * would keep the timer thread from ever finishing.
+		 */
+		while (timeout_running == to) {
+			timeout_waiting = true;
+			wchan_lock(timeout_donechan);
+			spinlock_release(&timeout_lock);
+			wchan_sleep(timeout_donechan);
+			spinlock_acquire(&timeout_lock);
+		}
+	}
+	spinlock_release(&timeout_lock);
+
+	return ret;
+}
+
+unsigned
+timeout_nsecs2ticks(uint64_t nsecs)
+{
+	const uint64_t nsecs_per_tick = LT_GRANULARITY * 1000ULL;
+	uint64_t ticks;
+
+	ticks = (nsecs + nsecs_per_tick - 1) / nsecs_per_tick;
+	return ticks > 0xffffffff ? 0xffffffff : ticks;
+}
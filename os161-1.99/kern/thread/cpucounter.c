@@ -0,0 +1,73 @@
+/*
+ * Per-cpu event counters. See cpucounter.h for details.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+#include <thread.h>
+#include <cpucounter.h>
+
+static struct spinlock cpucounter_lock = SPINLOCK_INITIALIZER;
+static unsigned cpucounter_next;	/* first unreserved counter */
+
+unsigned
+cpucounter_alloc(unsigned n)
+{
+	unsigned base;
+
+	spinlock_acquire(&cpucounter_lock);
+	base = cpucounter_next;
+	if (n > CPUCOUNTER_MAX - base) {
+		panic("cpucounter_alloc: out of counters (want %u of %u)\n",
+		      n, CPUCOUNTER_MAX - base);
+	}
+	cpucounter_next += n;
+	spinlock_release(&cpucounter_lock);
+
+	return base;
+}
+
+void
+cpucounter_add(unsigned idx, unsigned long val)
+{
+	int spl;
+
+	KASSERT(idx < CPUCOUNTER_MAX);
+
+	/* Interrupts off so we can't change cpus or be interrupted. */
+	spl = splhigh();
+	curcpu->c_counters[idx] += val;
+	splx(spl);
+}
+
+unsigned long
+cpucounter_sum(unsigned idx)
+{
+	unsigned long total = 0;
+	unsigned i, n;
+
+	KASSERT(idx < CPUCOUNTER_MAX);
+
+	n = thread_numcpus();
+	for (i=0; i<n; i++) {
+		total += thread_getcpu(i)->c_counters[idx];
+	}
+	return total;
+}
+
+void
+cpucounter_zero(unsigned idx)
+{
+	unsigned i, n;
+
+	KASSERT(idx < CPUCOUNTER_MAX);
+
+	n = thread_numcpus();
+	for (i=0; i<n; i++) {
+		thread_getcpu(i)->c_counters[idx] = 0;
+	}
+}
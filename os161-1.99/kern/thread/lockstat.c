@@ -0,0 +1,267 @@
+/*
+ * Lock contention statistics. See lockstat.h for details.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <lockstat.h>
+
+/* Most locks lockstat_print will list */
+#define LOCKSTAT_TOPMAX 64
+
+/*
+ * The list of all lockstats. This can't be protected by an ordinary
+ * spinlock, since spinlock_acquire adds spinlocks to it; use a bare
+ * lock word instead.
+ */
+static volatile spinlock_data_t lockstat_listlock = SPINLOCK_DATA_INITIALIZER;
+static struct lockstat *lockstat_list;
+
+static
+int
+lockstat_lock(void)
+{
+	int spl;
+
+	spl = splhigh();
+	while (spinlock_data_get(&lockstat_listlock) != 0 ||
+	       spinlock_data_testandset(&lockstat_listlock) != 0) {
+		/* spin */
+	}
+	return spl;
+}
+
+static
+void
+lockstat_unlock(int spl)
+{
+	spinlock_data_set(&lockstat_listlock, 0);
+	splx(spl);
+}
+
+static
+void
+lockstat_zero(struct lockstat *ls)
+{
+	ls->ls_acquires = 0;
+	ls->ls_contended = 0;
+	ls->ls_spins = 0;
+	ls->ls_waitns = 0;
+	ls->ls_maxhold = 0;
+}
+
+/*
+ * Put LS on the list, if it isn't already.
+ */
+static
+void
+lockstat_register(struct lockstat *ls)
+{
+	int spl;
+
+	spl = lockstat_lock();
+	if (ls->ls_self != ls) {
+		ls->ls_self = ls;
+		ls->ls_prev = NULL;
+		ls->ls_next = lockstat_list;
+		if (lockstat_list != NULL) {
+			lockstat_list->ls_prev = ls;
+		}
+		lockstat_list = ls;
+	}
+	lockstat_unlock(spl);
+}
+
+void
+lockstat_init(struct lockstat *ls, unsigned kind, const char *name)
+{
+	ls->ls_name = name;
+	ls->ls_kind = kind;
+	lockstat_zero(ls);
+	ls->ls_holdstart = 0;
+
+	/*
+	 * Memory that hasn't been through lockstat_init or that went
+	 * through lockstat_cleanup doesn't point to itself, so this
+	 * only keeps the links of one that's already listed, as
+	 * happens when a spinlock is re-initialized to reset it.
+	 */
+	if (ls->ls_self != ls) {
+		ls->ls_self = NULL;
+	}
+	lockstat_register(ls);
+}
+
+void
+lockstat_cleanup(struct lockstat *ls)
+{
+	int spl;
+
+	spl = lockstat_lock();
+	if (ls->ls_self == ls) {
+		if (ls->ls_prev != NULL) {
+			ls->ls_prev->ls_next = ls->ls_next;
+		}
+		else {
+			lockstat_list = ls->ls_next;
+		}
+		if (ls->ls_next != NULL) {
+			ls->ls_next->ls_prev = ls->ls_prev;
+		}
+		ls->ls_self = NULL;
+	}
+	lockstat_unlock(spl);
+}
+
+void
+lockstat_acquired(struct lockstat *ls, bool contended,
+		  uint64_t spins, uint64_t waitstart)
+{
+	uint64_t now;
+
+	if (ls->ls_self != ls) {
+		/* statically initialized spinlock; list it now */
+		lockstat_register(ls);
+	}
+
+	now = gettime_nsecs();
+	ls->ls_acquires++;
+	if (contended) {
+		ls->ls_contended++;
+		ls->ls_spins += spins;
+		if (waitstart != 0 && now > waitstart) {
+			ls->ls_waitns += now - waitstart;
+		}
+	}
+	ls->ls_holdstart = now;
+}
+
+void
+lockstat_released(struct lockstat *ls)
+{
+	uint64_t now, held;
+
+	now = gettime_nsecs();
+	if (ls->ls_holdstart != 0 && now > ls->ls_holdstart) {
+		held = now - ls->ls_holdstart;
+		if (held > ls->ls_maxhold) {
+			ls->ls_maxhold = held;
+		}
+	}
+}
+
+/*
+ * What lockstat_print copies out of the list.
+ */
+struct lockstat_snap {
+	char name[24];
+	unsigned kind;
+	unsigned acquires;
+	unsigned contended;
+	uint64_t spins;
+	uint64_t waitns;
+	uint64_t maxhold;
+};
+
+static
+void
+lockstat_snap(struct lockstat_snap *s, const struct lockstat *ls)
+{
+	const struct spinlock *lk;
+
+	if (ls->ls_name != NULL) {
+		snprintf(s->name, sizeof(s->name), "%s", ls->ls_name);
+	}
+	else {
+		/* Unnamed spinlock; give its address, for nm. */
+		lk = (const struct spinlock *)((const char *)ls -
+			(const char *)&((struct spinlock *)0)->lk_stat);
+		snprintf(s->name, sizeof(s->name), "spinlock %p", lk);
+	}
+	s->kind = ls->ls_kind;
+	s->acquires = ls->ls_acquires;
+	s->contended = ls->ls_contended;
+	s->spins = ls->ls_spins;
+	s->waitns = ls->ls_waitns;
+	s->maxhold = ls->ls_maxhold;
+}
+
+/*
+ * Print the N locks with the most total wait time. The counters are
+ * read (and, with RESET, zeroed) without holding the locks they
+ * belong to, so an update that happens at the same time can be off
+ * a little; that's fine for statistics. Copy everything out under
+ * the list lock and print afterwards, since kprintf can sleep.
+ */
+void
+lockstat_print(unsigned n, bool reset)
+{
+	static const char *const kinds[] = { "spin", "lock", "sem" };
+	struct lockstat_snap *top;
+	struct lockstat *ls;
+	unsigned i, j, count, nlocks;
+	int spl;
+
+	if (n > LOCKSTAT_TOPMAX) {
+		n = LOCKSTAT_TOPMAX;
+	}
+	if (n == 0) {
+		return;
+	}
+	top = kmalloc(n * sizeof(*top));
+	if (top == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		return;
+	}
+
+	count = 0;
+	nlocks = 0;
+	spl = lockstat_lock();
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		nlocks++;
+		if (ls->ls_contended > 0) {
+			/* Insert by wait time, dropping the smallest. */
+			for (i = count;
+			     i > 0 && top[i-1].waitns < ls->ls_waitns; i--) {
+				if (i < n) {
+					top[i] = top[i-1];
+				}
+			}
+			if (i < n) {
+				lockstat_snap(&top[i], ls);
+				if (count < n) {
+					count++;
+				}
+			}
+		}
+		if (reset) {
+			lockstat_zero(ls);
+		}
+	}
+	lockstat_unlock(spl);
+
+	kprintf("%u locks, %u contended shown%s\n", nlocks, count,
+		reset ? " (counters reset)" : "");
+	if (count > 0) {
+		kprintf("%-24s %-4s %10s %10s %10s %12s %10s\n",
+			"name", "kind", "acquires", "contended", "spins",
+			"wait(us)", "maxhold(us)");
+	}
+	for (j = 0; j < count; j++) {
+		kprintf("%-24s %-4s %10u %10u %10llu %12llu ",
+			top[j].name, kinds[top[j].kind], top[j].acquires,
+			top[j].contended, (unsigned long long)top[j].spins,
+			(unsigned long long)top[j].waitns / 1000);
+		if (top[j].kind == LOCKSTAT_SEM) {
+			kprintf("%10s\n", "-");
+		}
+		else {
+			kprintf("%10llu\n",
+				(unsigned long long)top[j].maxhold / 1000);
+		}
+	}
+	kfree(top);
+}
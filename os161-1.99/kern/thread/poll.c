@@ -0,0 +1,147 @@
+/*
+ * Poll queues. See poll.h for details.
+ *
+ * The lock order is a queue's pq_lock, then a poller's wchan lock.
+ * A poller is only ever woken with the lock of the queue it's on
+ * held, so once poller_cleanup has taken it off every queue nobody
+ * can be touching it and it can go away.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <wchan.h>
+#include <poll.h>
+
+/* A poller's place on one pollq. */
+struct pollent {
+	struct poller *pe_poller;
+	struct pollq *pe_q;
+	struct pollent *pe_prev;	/* on pe_q, protected by its pq_lock */
+	struct pollent *pe_next;
+};
+
+void
+pollq_init(struct pollq *pq)
+{
+	spinlock_init(&pq->pq_lock);
+	pq->pq_head = NULL;
+}
+
+void
+pollq_cleanup(struct pollq *pq)
+{
+	KASSERT(pq->pq_head == NULL);
+	spinlock_cleanup(&pq->pq_lock);
+}
+
+void
+pollq_wakeup(struct pollq *pq)
+{
+	struct pollent *pe;
+	struct poller *pl;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pe = pq->pq_head; pe != NULL; pe = pe->pe_next) {
+		pl = pe->pe_poller;
+		wchan_lock(pl->pl_wchan);
+		pl->pl_woken = true;
+		wchan_unlock(pl->pl_wchan);
+		wchan_wakeall(pl->pl_wchan);
+	}
+	spinlock_release(&pq->pq_lock);
+}
+
+////////////////////////////////////////////////////////////
+
+int
+poller_init(struct poller *pl, unsigned maxqs)
+{
+	pl->pl_wchan = wchan_create("poll");
+	if (pl->pl_wchan == NULL) {
+		return ENOMEM;
+	}
+	pl->pl_ents = NULL;
+	if (maxqs > 0) {
+		pl->pl_ents = kmalloc(maxqs * sizeof(pl->pl_ents[0]));
+		if (pl->pl_ents == NULL) {
+			wchan_destroy(pl->pl_wchan);
+			return ENOMEM;
+		}
+	}
+	pl->pl_woken = false;
+	pl->pl_nents = 0;
+	pl->pl_maxents = maxqs;
+	return 0;
+}
+
+void
+poller_cleanup(struct poller *pl)
+{
+	struct pollent *pe;
+	struct pollq *pq;
+	unsigned i;
+
+	for (i=0; i<pl->pl_nents; i++) {
+		pe = &pl->pl_ents[i];
+		pq = pe->pe_q;
+		spinlock_acquire(&pq->pq_lock);
+		if (pe->pe_prev != NULL) {
+			pe->pe_prev->pe_next = pe->pe_next;
+		}
+		else {
+			pq->pq_head = pe->pe_next;
+		}
+		if (pe->pe_next != NULL) {
+			pe->pe_next->pe_prev = pe->pe_prev;
+		}
+		spinlock_release(&pq->pq_lock);
+	}
+	if (pl->pl_ents != NULL) {
+		kfree(pl->pl_ents);
+	}
+	wchan_destroy(pl->pl_wchan);
+}
+
+void
+poller_add(struct poller *pl, struct pollq *pq)
+{
+	struct pollent *pe;
+
+	if (pl == NULL) {
+		return;
+	}
+	KASSERT(pl->pl_nents < pl->pl_maxents);
+	pe = &pl->pl_ents[pl->pl_nents++];
+	pe->pe_poller = pl;
+	pe->pe_q = pq;
+	pe->pe_prev = NULL;
+
+	spinlock_acquire(&pq->pq_lock);
+	pe->pe_next = pq->pq_head;
+	if (pe->pe_next != NULL) {
+		pe->pe_next->pe_prev = pe;
+	}
+	pq->pq_head = pe;
+	spinlock_release(&pq->pq_lock);
+}
+
+int
+poller_wait(struct poller *pl, unsigned ticks)
+{
+	int result = 0;
+
+	wchan_lock(pl->pl_wchan);
+	if (!pl->pl_woken) {
+		if (ticks == 0) {
+			wchan_sleep(pl->pl_wchan);
+		}
+		else {
+			result = wchan_timedsleep(pl->pl_wchan, ticks);
+		}
+		wchan_lock(pl->pl_wchan);
+	}
+	pl->pl_woken = false;
+	wchan_unlock(pl->pl_wchan);
+	return result;
+}
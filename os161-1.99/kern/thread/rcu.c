@@ -0,0 +1,74 @@
+/*
+ * Read-copy-update. See rcu.h for details.
+ *
+ * Since a read section runs with interrupts off, a cpu can't be in
+ * one while it's switching threads or taking a timer interrupt, so
+ * thread_switch and hardclock call rcu_quiescent to bump the cpu's
+ * c_rcu_qs. A grace period is over once every other cpu's count has
+ * moved (or it's been seen idle). Cpus that haven't hatched yet
+ * can't be reading anything, and neither can ours while we're
+ * running here, so those are skipped.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <current.h>
+#include <thread.h>
+#include <clock.h>
+#include <rcu.h>
+
+void
+rcu_read_lock(void)
+{
+	splraise(IPL_NONE, IPL_HIGH);
+	curthread->t_rcudepth++;
+}
+
+void
+rcu_read_unlock(void)
+{
+	KASSERT(curthread->t_rcudepth > 0);
+	curthread->t_rcudepth--;
+	spllower(IPL_HIGH, IPL_NONE);
+}
+
+bool
+rcu_read_held(void)
+{
+	return curthread->t_rcudepth > 0;
+}
+
+void
+rcu_quiescent(void)
+{
+	curcpu->c_rcu_qs++;
+}
+
+void
+rcu_synchronize(void)
+{
+	struct cpu *c;
+	unsigned i, n, start;
+
+	KASSERT(!rcu_read_held());
+	KASSERT(!curthread->t_in_interrupt);
+
+	/*
+	 * One cpu at a time is enough: a reader on a cpu we get to
+	 * later started before we looked at that cpu, so it's one we
+	 * have to wait for anyway.
+	 */
+	n = thread_numcpus();
+	for (i=0; i<n; i++) {
+		c = thread_getcpu(i);
+		if (!c->c_rcu_online || c == curcpu->c_self) {
+			continue;
+		}
+		start = c->c_rcu_qs;
+		while (c->c_rcu_qs == start && !c->c_isidle) {
+			clocknap(1);
+		}
+	}
+}
@@ -36,6 +36,7 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <current.h>	/* for curcpu */
+#include <clock.h>	/* for lockstat */
 
 /*
  * Spinlocks.
@@ -48,8 +49,12 @@
 void
 spinlock_init(struct spinlock *lk)
 {
-	spinlock_data_set(&lk->lk_lock, 0);
+	spinlock_data_set(&lk->lk_next, 0);
+	spinlock_data_set(&lk->lk_serving, 0);
 	lk->lk_holder = NULL;
+#if OPT_LOCKSTAT
+	lockstat_init(&lk->lk_stat, LOCKSTAT_SPIN, NULL);
+#endif
 }
 
 /*
@@ -59,7 +64,11 @@ void
 spinlock_cleanup(struct spinlock *lk)
 {
 	KASSERT(lk->lk_holder == NULL);
-	KASSERT(spinlock_data_get(&lk->lk_lock) == 0);
+	KASSERT(spinlock_data_get(&lk->lk_next) ==
+		spinlock_data_get(&lk->lk_serving));
+#if OPT_LOCKSTAT
+	lockstat_cleanup(&lk->lk_stat);
+#endif
 }
 
 /*
@@ -67,12 +76,16 @@ spinlock_cleanup(struct spinlock *lk)
  *
  * First disable interrupts (otherwise, if we get a timer interrupt we
  * might come back to this lock and deadlock), then use a machine-level
- * atomic operation to wait for the lock to be free.
+ * atomic operation to take a ticket, and wait for our turn.
  */
 void
 spinlock_acquire(struct spinlock *lk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t ticket;
+#if OPT_LOCKSTAT
+	uint64_t spins = 0, waitstart = 0;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -87,27 +100,31 @@ spinlock_acquire(struct spinlock *lk)
 		mycpu = NULL;
 	}
 
+	/*
+	 * Fetch-and-add is a machine-level atomic operation, so every
+	 * cpu gets a different ticket. Then just read lk_serving until
+	 * it's ours; only the holder writes it, when it lets go, so the
+	 * waiters don't fight over the bus the way test-and-set does.
+	 * The counters wrap around, which is fine since we only ever
+	 * compare them for equality.
+	 */
+	ticket = spinlock_data_fetchadd(&lk->lk_next, 1);
 	while (1) {
-		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
-		 */
-		if (spinlock_data_get(&lk->lk_lock) != 0) {
-			continue;
+#if OPT_LOCKSTAT
+		/* Count the tries after the first, and time them. */
+		if (spins++ == 1) {
+			waitstart = gettime_nsecs();
 		}
-		if (spinlock_data_testandset(&lk->lk_lock) != 0) {
-			continue;
+#endif
+		if (spinlock_data_get(&lk->lk_serving) == ticket) {
+			break;
 		}
-		break;
 	}
 
 	lk->lk_holder = mycpu;
+#if OPT_LOCKSTAT
+	lockstat_acquired(&lk->lk_stat, spins > 1, spins - 1, waitstart);
+#endif
 }
 
 /*
@@ -121,8 +138,12 @@ spinlock_release(struct spinlock *lk)
 		KASSERT(lk->lk_holder == curcpu->c_self);
 	}
 
+#if OPT_LOCKSTAT
+	lockstat_released(&lk->lk_stat);
+#endif
 	lk->lk_holder = NULL;
-	spinlock_data_set(&lk->lk_lock, 0);
+	spinlock_data_set(&lk->lk_serving,
+			  spinlock_data_get(&lk->lk_serving) + 1);
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -36,6 +36,8 @@
 #include <spl.h>
 #include <thread.h>
 #include <current.h>
+#include <clock.h>
+#include "opt-irqstats.h"
 
 /*
  * Machine-independent interrupt handling functions.
@@ -101,6 +103,12 @@ splraise(int oldspl, int newspl)
 		cpu_irqoff();
 	}
 	cur->t_iplhigh_count++;
+#if OPT_IRQSTATS
+	/* After the increment, so reading the clock doesn't recurse */
+	if (cur->t_iplhigh_count == 1) {
+		spl_irqoff_begin();
+	}
+#endif
 }
 
 void
@@ -117,12 +125,55 @@ spllower(int oldspl, int newspl)
 		return;
 	}
 
+#if OPT_IRQSTATS
+	/* Before the decrement, for the same reason */
+	if (cur->t_iplhigh_count == 1) {
+		spl_irqoff_end();
+	}
+#endif
 	cur->t_iplhigh_count--;
 	if (cur->t_iplhigh_count == 0) {
 		cpu_irqon();
 	}
 }
 
+#if OPT_IRQSTATS
+/*
+ * Interrupts-off time statistics.
+ *
+ * splraise and spllower call these on the outermost transitions.
+ * Other code that turns interrupts off or on without going through
+ * them (the trap code, idling) calls them directly.
+ *
+ * They must be called with interrupts off, so the per-cpu fields
+ * need no other protection. The clock is read with splhigh(), which
+ * only nests here since t_iplhigh_count is already nonzero.
+ */
+void
+spl_irqoff_begin(void)
+{
+	curcpu->c_irqoff_stamp = gettime_nsecs();
+}
+
+void
+spl_irqoff_end(void)
+{
+	uint64_t now, then;
+
+	then = curcpu->c_irqoff_stamp;
+	if (then == 0) {
+		/* No clock yet, or begin wasn't seen */
+		return;
+	}
+	now = gettime_nsecs();
+	if (now > then && now - then > curcpu->c_irqoff_max) {
+		curcpu->c_irqoff_max = now - then;
+	}
+	curcpu->c_irqoff_count++;
+	curcpu->c_irqoff_stamp = 0;
+}
+#endif /* OPT_IRQSTATS */
+
 
 /*
  * Disable or enable interrupts and adjust curspl setting. Return old
@@ -37,7 +37,9 @@
 #include <spinlock.h>
 #include <wchan.h>
 #include <thread.h>
+#include <cpu.h>
 #include <current.h>
+#include <clock.h>
 #include <synch.h>
 
 ////////////////////////////////////////////////////////////
@@ -46,6 +48,12 @@
 
 struct semaphore *
 sem_create(const char *name, int initial_count)
+{
+	return sem_create_flags(name, initial_count, 0);
+}
+
+struct semaphore *
+sem_create_flags(const char *name, int initial_count, unsigned flags)
 {
         struct semaphore *sem;
 
@@ -71,6 +79,12 @@ sem_create(const char *name, int initial_count)
 
 	spinlock_init(&sem->sem_lock);
         sem->sem_count = initial_count;
+	sem->sem_flags = flags;
+	sem->sem_nwaiting = 0;
+	sem->sem_handoffs = 0;
+#if OPT_LOCKSTAT
+	lockstat_init(&sem->sem_stat, LOCKSTAT_SEM, sem->sem_name);
+#endif
 
         return sem;
 }
@@ -81,6 +95,9 @@ sem_destroy(struct semaphore *sem)
         KASSERT(sem != NULL);
 
 	/* wchan_cleanup will assert if anyone's waiting on it */
+#if OPT_LOCKSTAT
+	lockstat_cleanup(&sem->sem_stat);
+#endif
 	spinlock_cleanup(&sem->sem_lock);
 	wchan_destroy(sem->sem_wchan);
         kfree(sem->sem_name);
@@ -90,6 +107,12 @@ sem_destroy(struct semaphore *sem)
 void 
 P(struct semaphore *sem)
 {
+	bool handedoff = false;
+#if OPT_LOCKSTAT
+	bool waited = false;
+	uint64_t waitstart = 0;
+#endif
+
         KASSERT(sem != NULL);
 
         /*
@@ -117,15 +140,42 @@ P(struct semaphore *sem)
 		 *
 		 * Exercise: how would you implement strict FIFO
 		 * ordering?
+		 *
+		 * (Answer: SEM_HANDOFF. Then V doesn't touch the count
+		 * while anyone's asleep, so newcomers go to sleep
+		 * behind them; it bumps sem_handoffs instead and wakes
+		 * the oldest sleeper, which is us by the time we get
+		 * back here, since the wchan is FIFO.)
 		 */
+#if OPT_LOCKSTAT
+		if (!waited) {
+			waited = true;
+			waitstart = gettime_nsecs();
+		}
+#endif
+		sem->sem_nwaiting++;
 		wchan_lock(sem->sem_wchan);
 		spinlock_release(&sem->sem_lock);
                 wchan_sleep(sem->sem_wchan);
 
 		spinlock_acquire(&sem->sem_lock);
+		if (sem->sem_flags & SEM_HANDOFF) {
+			/* V already took us off the waiting count */
+			KASSERT(sem->sem_handoffs > 0);
+			sem->sem_handoffs--;
+			handedoff = true;
+			break;
+		}
+		KASSERT(sem->sem_nwaiting > 0);
+		sem->sem_nwaiting--;
         }
-        KASSERT(sem->sem_count > 0);
-        sem->sem_count--;
+	if (!handedoff) {
+		KASSERT(sem->sem_count > 0);
+		sem->sem_count--;
+	}
+#if OPT_LOCKSTAT
+	lockstat_acquired(&sem->sem_stat, waited, 0, waitstart);
+#endif
 	spinlock_release(&sem->sem_lock);
 }
 
@@ -136,6 +186,14 @@ V(struct semaphore *sem)
 
 	spinlock_acquire(&sem->sem_lock);
 
+	if ((sem->sem_flags & SEM_HANDOFF) && sem->sem_nwaiting > 0) {
+		sem->sem_nwaiting--;
+		sem->sem_handoffs++;
+		wchan_wakeone(sem->sem_wchan);
+		spinlock_release(&sem->sem_lock);
+		return;
+	}
+
         sem->sem_count++;
         KASSERT(sem->sem_count > 0);
 	wchan_wakeone(sem->sem_wchan);
@@ -149,6 +207,12 @@ V(struct semaphore *sem)
 
 struct lock *
 lock_create(const char *name)
+{
+        return lock_create_flags(name, 0);
+}
+
+struct lock *
+lock_create_flags(const char *name, unsigned flags)
 {
         struct lock *lock;
 
@@ -175,6 +239,16 @@ lock_create(const char *name)
         spinlock_init(&lock->spin);
         lock->held = false;
         lock->holder = NULL;
+        lock->lk_flags = flags;
+        lock->lk_spins = 0;
+        lock->lk_sleeps = 0;
+        lock->lk_nwaiting = 0;
+        lock->lk_handoff = false;
+        lock->lk_piwaiters = NULL;
+        lock->lk_heldnext = NULL;
+#if OPT_LOCKSTAT
+        lockstat_init(&lock->lk_stat, LOCKSTAT_LOCK, lock->lk_name);
+#endif
         
         return lock;
 }
@@ -187,6 +261,10 @@ lock_destroy(struct lock *lock)
         // add stuff here as needed
         KASSERT(lock->held == false);
         KASSERT(lock->holder == NULL);
+        KASSERT(lock->lk_piwaiters == NULL);
+#if OPT_LOCKSTAT
+        lockstat_cleanup(&lock->lk_stat);
+#endif
         spinlock_cleanup(&lock->spin);
         wchan_destroy(lock->wc);
         
@@ -194,35 +272,308 @@ lock_destroy(struct lock *lock)
         kfree(lock);
 }
 
+/*
+ * Priority inheritance.
+ *
+ * Each lock keeps a list of the threads asleep waiting for it
+ * (lk_piwaiters, linked through t_piwaitnext), each such thread points
+ * at the lock (t_blockedon), and each thread keeps a list of the locks
+ * it holds (t_heldlocks). When a thread goes to sleep on a lock it
+ * raises the holder's t_pri to its own if that's higher, and if the
+ * holder is itself asleep on a lock, that lock's holder, and so on;
+ * a holder that's waiting to run is moved up its run queue to match.
+ * When a thread releases a lock it recomputes its t_pri from its base
+ * priority and the waiters on the locks it still holds, and so does a
+ * thread that gets a lock others are still waiting for.
+ *
+ * All of this is protected by lock_pi_lock, taken inside the lock's
+ * own spinlock (or, from cv_broadcast, its wait channel's) and
+ * outside the run queue locks. Following the chain means looking at the holder of
+ * locks whose spinlock we don't hold; that's safe because every lock
+ * on the chain has a waiter (the previous holder), and lock_release
+ * only clears lk->holder of a lock with waiters while holding
+ * lock_pi_lock, so the holder can't release and go away under us.
+ */
+
+#define LOCK_PI_MAXDEPTH 8
+
+static struct spinlock lock_pi_lock = SPINLOCK_INITIALIZER;
+
+/*
+ * The current thread is about to sleep on LOCK. Call with lock->spin
+ * held.
+ */
+static
 void
-lock_acquire(struct lock *lock)
+lock_pi_block(struct lock *lock)
+{
+        struct thread *t;
+        struct lock *lk;
+        int pri, depth;
+
+        spinlock_acquire(&lock_pi_lock);
+        KASSERT(curthread->t_blockedon == NULL);
+        curthread->t_blockedon = lock;
+        curthread->t_piwaitnext = lock->lk_piwaiters;
+        lock->lk_piwaiters = curthread;
+
+        pri = curthread->t_pri;
+        lk = lock;
+        for (depth = 0; lk != NULL && depth < LOCK_PI_MAXDEPTH; depth++) {
+                t = (struct thread *)lk->holder;
+                if (t == NULL || t->t_pri >= pri) {
+                        break;
+                }
+                t->t_pri = pri;
+                /* If it's waiting to run, it should be nearer the front */
+                thread_reprioritize(t);
+                lk = t->t_blockedon;
+        }
+        spinlock_release(&lock_pi_lock);
+}
+
+/*
+ * The current thread has woken up from sleeping on LOCK. Call with
+ * lock->spin held.
+ */
+static
+void
+lock_pi_unblock(struct lock *lock)
+{
+        struct thread **tp;
+
+        spinlock_acquire(&lock_pi_lock);
+        KASSERT(curthread->t_blockedon == lock);
+        for (tp = &lock->lk_piwaiters; *tp != curthread;
+             tp = &(*tp)->t_piwaitnext) {
+                KASSERT(*tp != NULL);
+        }
+        *tp = curthread->t_piwaitnext;
+        curthread->t_piwaitnext = NULL;
+        curthread->t_blockedon = NULL;
+        spinlock_release(&lock_pi_lock);
+}
+
+/*
+ * Work out the current thread's effective priority. Call with
+ * lock_pi_lock held.
+ */
+static
+void
+lock_pi_recompute(void)
 {
+        struct lock *lk;
+        struct thread *w;
+        int pri;
+
+        KASSERT(spinlock_do_i_hold(&lock_pi_lock));
+
+        pri = curthread->t_basepri;
+        for (lk = curthread->t_heldlocks; lk != NULL; lk = lk->lk_heldnext) {
+                for (w = lk->lk_piwaiters; w != NULL; w = w->t_piwaitnext) {
+                        if (w->t_pri > pri) {
+                                pri = w->t_pri;
+                        }
+                }
+        }
+        curthread->t_pri = pri;
+}
+
+/*
+ * cv_broadcast is moving T, asleep on a CV, onto LOCK's channel. Sign
+ * it up as a waiter the way lock_pi_block would have. Called by
+ * wchan_requeue with both channels locked.
+ */
+static
+void
+lock_pi_requeue(struct thread *t, void *data)
+{
+        struct lock *lock = data;
+
+        spinlock_acquire(&lock_pi_lock);
+        KASSERT(t->t_blockedon == NULL);
+        t->t_blockedon = lock;
+        t->t_piwaitnext = lock->lk_piwaiters;
+        lock->lk_piwaiters = t;
+        spinlock_release(&lock_pi_lock);
+}
+
+void
+lock_pi_update(void)
+{
+        spinlock_acquire(&lock_pi_lock);
+        lock_pi_recompute();
+        spinlock_release(&lock_pi_lock);
+}
+
+/*
+ * Most iterations an adaptive lock_acquire will spin for, in total,
+ * before giving up and sleeping even if the holder is still running.
+ */
+#define LOCK_SPIN_MAX   1000
+
+/*
+ * Is thread T running right now on some other cpu?
+ *
+ * T is the holder of a lock we don't hold, so it can release the lock,
+ * exit, and be destroyed at any moment. That only makes us read
+ * stale memory (kernel memory is always mapped) and decide wrongly
+ * whether to spin; the caller rechecks the lock itself afterwards.
+ */
+static
+bool
+lock_holder_running(volatile struct thread *t)
+{
+        return t != NULL && t->t_state == S_RUN &&
+                t->t_cpu != curcpu->c_self;
+}
+
+/*
+ * Get LOCK. REQUEUED means cv_broadcast moved us onto the lock's
+ * channel while we were waiting on a CV, so we're signed up as a
+ * waiter already and a lock_release has just woken us.
+ */
+static
+void
+lock_doacquire(struct lock *lock, bool requeued)
+{
+        volatile struct thread *holder;
+        unsigned spinsleft = LOCK_SPIN_MAX;
+        bool spun = false, slept = false;
+#if OPT_LOCKSTAT
+        uint64_t waitstart = 0;
+#endif
+
         KASSERT(lock != NULL);
         KASSERT(!lock_do_i_hold(lock));
 
         spinlock_acquire(&lock->spin);
+        if (requeued) {
+                /*
+                 * Undo the registration as the loop below does on
+                 * waking. Only sleeping again counts in lk_sleeps,
+                 * though: requeueing is meant to make that rare.
+                 */
+                lock_pi_unblock(lock);
+                KASSERT(lock->lk_nwaiting > 0);
+                lock->lk_nwaiting--;
+        }
         while (lock->held) {
+#if OPT_LOCKSTAT
+                if (!spun && !slept) {
+                        waitstart = gettime_nsecs();
+                }
+#endif
+                holder = lock->holder;
+                if ((lock->lk_flags & LOCK_ADAPTIVE) && spinsleft > 0 &&
+                    lock_holder_running(holder)) {
+                        /*
+                         * Wait for the holder to let go without
+                         * the spinlock, so it can, then try again.
+                         */
+                        spinlock_release(&lock->spin);
+                        while (spinsleft > 0 && lock->held &&
+                               lock->holder == holder &&
+                               lock_holder_running(holder)) {
+                                spinsleft--;
+                        }
+                        spun = true;
+                        spinlock_acquire(&lock->spin);
+                        continue;
+                }
+                slept = true;
+                lock->lk_nwaiting++;
+                lock_pi_block(lock);
                 wchan_lock(lock->wc);
                 spinlock_release(&lock->spin);
                 wchan_sleep(lock->wc);
                 spinlock_acquire(&lock->spin);
+                lock_pi_unblock(lock);
+                if (lock->lk_handoff) {
+                        /*
+                         * lock_release left the lock held and woke
+                         * one sleeper, which is us. It's ours.
+                         */
+                        KASSERT(lock->held && lock->holder == NULL);
+                        lock->lk_handoff = false;
+                        break;
+                }
+                KASSERT(lock->lk_nwaiting > 0);
+                lock->lk_nwaiting--;
         }
         lock->held = true;
         lock->holder = curthread;
+        lock->lk_heldnext = curthread->t_heldlocks;
+        curthread->t_heldlocks = lock;
+        if (lock->lk_piwaiters != NULL) {
+                /* Inherit from whoever is still waiting behind us. */
+                lock_pi_update();
+        }
+        if (slept) {
+                lock->lk_sleeps++;
+        }
+        else if (spun) {
+                lock->lk_spins++;
+        }
+#if OPT_LOCKSTAT
+        lockstat_acquired(&lock->lk_stat, spun || slept,
+                          LOCK_SPIN_MAX - spinsleft, waitstart);
+#endif
         spinlock_release(&lock->spin);
 }
 
+void
+lock_acquire(struct lock *lock)
+{
+        lock_doacquire(lock, false);
+}
+
 void
 lock_release(struct lock *lock)
 {
+        struct lock **lkp;
+        bool pi;
+
         KASSERT(lock != NULL);
         KASSERT(lock->held == true);
         KASSERT(lock_do_i_hold(lock));
+
+        /* Off our list of held locks; usually it's the newest. */
+        for (lkp = &curthread->t_heldlocks; *lkp != lock;
+             lkp = &(*lkp)->lk_heldnext) {
+                KASSERT(*lkp != NULL);
+        }
+        *lkp = lock->lk_heldnext;
+        lock->lk_heldnext = NULL;
         
         spinlock_acquire(&lock->spin);
-        lock->held = false;
+#if OPT_LOCKSTAT
+        lockstat_released(&lock->lk_stat);
+#endif
+        /*
+         * If anyone's waiting, or we've been boosted, the priority
+         * inheritance code needs to know (see above).
+         */
+        pi = lock->lk_piwaiters != NULL ||
+                curthread->t_pri != curthread->t_basepri;
+        if (pi) {
+                spinlock_acquire(&lock_pi_lock);
+        }
         lock->holder = NULL;
-        wchan_wakeone(lock->wc);
+        if (pi) {
+                lock_pi_recompute();
+                spinlock_release(&lock_pi_lock);
+        }
+        if ((lock->lk_flags & LOCK_HANDOFF) && lock->lk_nwaiting > 0) {
+                /* Leave it held; the thread we wake takes over. */
+                KASSERT(!lock->lk_handoff);
+                lock->lk_nwaiting--;
+                lock->lk_handoff = true;
+        }
+        else {
+                lock->held = false;
+        }
+        wchan_wakepri(lock->wc);
         spinlock_release(&lock->spin);
 }
 
@@ -289,7 +640,24 @@ cv_wait(struct cv *cv, struct lock *lock)
         wchan_lock(cv->wc);
         lock_release(lock);
         wchan_sleep(cv->wc);
-        lock_acquire(lock);
+        /* Only we and cv_broadcast touch our t_blockedon here. */
+        lock_doacquire(lock, curthread->t_blockedon == lock);
+}
+
+int
+cv_timedwait(struct cv *cv, struct lock *lock, unsigned ticks)
+{
+        int result;
+
+        KASSERT( cv != NULL );
+        KASSERT( lock != NULL );
+        KASSERT( lock_do_i_hold(lock) );
+
+        wchan_lock(cv->wc);
+        lock_release(lock);
+        result = wchan_timedsleep(cv->wc, ticks);
+        lock_doacquire(lock, curthread->t_blockedon == lock);
+        return result;
 }
 
 void
@@ -305,9 +673,297 @@ cv_signal(struct cv *cv, struct lock *lock)
 void
 cv_broadcast(struct cv *cv, struct lock *lock)
 {
+        unsigned n;
+
         KASSERT( cv != NULL );
         KASSERT( lock != NULL );
         KASSERT( lock_do_i_hold(lock) );
 
-        wchan_wakeall(cv->wc);
+        /*
+         * Everyone we'd wake would go straight for LOCK, which we
+         * hold, and all but one would just go back to sleep on it.
+         * So move them onto the lock's channel instead; each
+         * lock_release then wakes one, which can actually get the
+         * lock. (cv_wait locks the cv's channel before the lock's,
+         * so that's the order here too.) They're counted and
+         * registered for priority inheritance like any other thread
+         * waiting for the lock, and we inherit from them.
+         *
+         * Handoff locks expect whoever lock_release wakes to be in
+         * lock_acquire already, so for those just wake everyone.
+         */
+        if (lock->lk_flags & LOCK_HANDOFF) {
+                wchan_wakeall(cv->wc);
+        }
+        else {
+                n = wchan_requeue(cv->wc, lock->wc, lock_pi_requeue, lock);
+                if (n > 0) {
+                        /*
+                         * We hold the lock, so nobody can wake them
+                         * before the count is right.
+                         */
+                        spinlock_acquire(&lock->spin);
+                        lock->lk_nwaiting += n;
+                        spinlock_release(&lock->spin);
+                        lock_pi_update();
+                }
+        }
+}
+
+////////////////////////////////////////////////////////////
+//
+// Reader-writer lock.
+
+struct rwlock *
+rwlock_create(const char *name)
+{
+	struct rwlock *rw;
+	unsigned i;
+
+	rw = kmalloc(sizeof(struct rwlock));
+	if (rw == NULL) {
+		return NULL;
+	}
+
+	rw->rw_name = kstrdup(name);
+	if (rw->rw_name == NULL) {
+		goto fail_rw;
+	}
+	rw->rw_rwchan = wchan_create(rw->rw_name);
+	if (rw->rw_rwchan == NULL) {
+		goto fail_name;
+	}
+	rw->rw_wwchan = wchan_create(rw->rw_name);
+	if (rw->rw_wwchan == NULL) {
+		goto fail_rwchan;
+	}
+	rw->rw_drainchan = wchan_create(rw->rw_name);
+	if (rw->rw_drainchan == NULL) {
+		goto fail_wwchan;
+	}
+
+	spinlock_init(&rw->rw_lock);
+	rw->rw_wactive = false;
+	rw->rw_writer = NULL;
+	rw->rw_readturn = false;
+	rw->rw_rwaiting = 0;
+	for (i=0; i<RW_NSLOTS; i++) {
+		spinlock_init(&rw->rw_slots[i].rs_lock);
+		rw->rw_slots[i].rs_readers = 0;
+	}
+	return rw;
+
+ fail_wwchan:
+	wchan_destroy(rw->rw_wwchan);
+ fail_rwchan:
+	wchan_destroy(rw->rw_rwchan);
+ fail_name:
+	kfree(rw->rw_name);
+ fail_rw:
+	kfree(rw);
+	return NULL;
+}
+
+/*
+ * Count the readers. Takes each slot lock in turn; call with rw_lock
+ * held and rw_wactive set, so no reader can come in meanwhile.
+ */
+static
+int
+rwlock_readers(struct rwlock *rw)
+{
+	int total = 0;
+	unsigned i;
+
+	for (i=0; i<RW_NSLOTS; i++) {
+		spinlock_acquire(&rw->rw_slots[i].rs_lock);
+		total += rw->rw_slots[i].rs_readers;
+		spinlock_release(&rw->rw_slots[i].rs_lock);
+	}
+	KASSERT(total >= 0);
+	return total;
+}
+
+void
+rwlock_destroy(struct rwlock *rw)
+{
+	unsigned i;
+
+	KASSERT(rw != NULL);
+	KASSERT(rw->rw_wactive == false);
+
+	/*
+	 * A reader can release on a different slot than it acquired
+	 * on, so only the sum has to be zero. Nobody else may be using
+	 * the lock now, so counting the way the writer does is safe.
+	 */
+	KASSERT(rwlock_readers(rw) == 0);
+	for (i=0; i<RW_NSLOTS; i++) {
+		spinlock_cleanup(&rw->rw_slots[i].rs_lock);
+	}
+	spinlock_cleanup(&rw->rw_lock);
+	wchan_destroy(rw->rw_drainchan);
+	wchan_destroy(rw->rw_wwchan);
+	wchan_destroy(rw->rw_rwchan);
+	kfree(rw->rw_name);
+	kfree(rw);
+}
+
+void
+rwlock_acquire_read(struct rwlock *rw)
+{
+	struct rwslot *slot;
+
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(rw->rw_writer != curthread);
+
+	/*
+	 * Fast path: count ourselves in this cpu's slot. A writer
+	 * sets rw_wactive before it counts the slots, taking each
+	 * slot lock, so either it sees us or we see it.
+	 */
+	slot = &rw->rw_slots[curcpu->c_number % RW_NSLOTS];
+	spinlock_acquire(&slot->rs_lock);
+	if (!rw->rw_wactive) {
+		slot->rs_readers++;
+		spinlock_release(&slot->rs_lock);
+		return;
+	}
+	spinlock_release(&slot->rs_lock);
+
+	/* Slow path: wait for the writer(s) to be done. */
+	spinlock_acquire(&rw->rw_lock);
+	while (rw->rw_wactive) {
+		rw->rw_rwaiting++;
+		wchan_lock(rw->rw_rwchan);
+		spinlock_release(&rw->rw_lock);
+		wchan_sleep(rw->rw_rwchan);
+		spinlock_acquire(&rw->rw_lock);
+		KASSERT(rw->rw_rwaiting > 0);
+		rw->rw_rwaiting--;
+	}
+
+	/* Holding rw_lock, so we can't change cpus under this. */
+	slot = &rw->rw_slots[curcpu->c_number % RW_NSLOTS];
+	spinlock_acquire(&slot->rs_lock);
+	slot->rs_readers++;
+	spinlock_release(&slot->rs_lock);
+
+	if (rw->rw_readturn && rw->rw_rwaiting == 0) {
+		/* Last of the queued readers is in; writers next. */
+		rw->rw_readturn = false;
+		wchan_wakeone(rw->rw_wwchan);
+	}
+	spinlock_release(&rw->rw_lock);
+}
+
+void
+rwlock_release_read(struct rwlock *rw)
+{
+	struct rwslot *slot;
+	bool writer;
+
+	KASSERT(rw != NULL);
+
+	slot = &rw->rw_slots[curcpu->c_number % RW_NSLOTS];
+	spinlock_acquire(&slot->rs_lock);
+	slot->rs_readers--;
+	writer = rw->rw_wactive;
+	spinlock_release(&slot->rs_lock);
+
+	if (writer) {
+		/*
+		 * A writer is (or is about to be) waiting for the
+		 * readers to drain. It counts them and goes to sleep
+		 * without letting go of rw_lock, so taking rw_lock
+		 * here means it's either seen our decrement or is
+		 * asleep.
+		 */
+		spinlock_acquire(&rw->rw_lock);
+		wchan_wakeone(rw->rw_drainchan);
+		spinlock_release(&rw->rw_lock);
+	}
+}
+
+void
+rwlock_acquire_write(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(rw->rw_writer != curthread);
+
+	spinlock_acquire(&rw->rw_lock);
+	while (rw->rw_wactive || rw->rw_readturn) {
+		wchan_lock(rw->rw_wwchan);
+		spinlock_release(&rw->rw_lock);
+		wchan_sleep(rw->rw_wwchan);
+		spinlock_acquire(&rw->rw_lock);
+	}
+
+	/* Shut out new readers, then wait for the old ones to leave. */
+	rw->rw_wactive = true;
+	rw->rw_writer = curthread;
+	while (rwlock_readers(rw) > 0) {
+		wchan_lock(rw->rw_drainchan);
+		spinlock_release(&rw->rw_lock);
+		wchan_sleep(rw->rw_drainchan);
+		spinlock_acquire(&rw->rw_lock);
+	}
+	spinlock_release(&rw->rw_lock);
+}
+
+/*
+ * Let the next party in after a writer. Call with rw_lock held.
+ */
+static
+void
+rwlock_writer_done(struct rwlock *rw)
+{
+	KASSERT(spinlock_do_i_hold(&rw->rw_lock));
+	KASSERT(rw->rw_writer == curthread);
+
+	rw->rw_wactive = false;
+	rw->rw_writer = NULL;
+	if (rw->rw_rwaiting > 0) {
+		rw->rw_readturn = true;
+		wchan_wakeall(rw->rw_rwchan);
+	}
+	else {
+		wchan_wakeone(rw->rw_wwchan);
+	}
+}
+
+void
+rwlock_release_write(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+	KASSERT(rwlock_do_i_write(rw));
+
+	spinlock_acquire(&rw->rw_lock);
+	rwlock_writer_done(rw);
+	spinlock_release(&rw->rw_lock);
+}
+
+void
+rwlock_downgrade(struct rwlock *rw)
+{
+	struct rwslot *slot;
+
+	KASSERT(rw != NULL);
+	KASSERT(rwlock_do_i_write(rw));
+
+	spinlock_acquire(&rw->rw_lock);
+	slot = &rw->rw_slots[curcpu->c_number % RW_NSLOTS];
+	spinlock_acquire(&slot->rs_lock);
+	slot->rs_readers++;
+	spinlock_release(&slot->rs_lock);
+	rwlock_writer_done(rw);
+	spinlock_release(&rw->rw_lock);
+}
+
+bool
+rwlock_do_i_write(struct rwlock *rw)
+{
+	return rw->rw_writer == curthread;
 }
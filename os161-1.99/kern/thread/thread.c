@@ -50,8 +50,13 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <clock.h>
+#include <histogram.h>
+#include <workqueue.h>
+#include <rcu.h>
 
 #include "opt-synchprobs.h"
+#include "opt-irqstats.h"
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -142,12 +147,26 @@ thread_create(const char *name)
 	thread->t_stack = NULL;
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
+	thread->t_affinity = CPUMASK_ALL;
 	thread->t_proc = NULL;
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+	thread->t_rcudepth = 0;
+
+	/* Cpu time accounting fields */
+	bzero(&thread->t_times, sizeof(thread->t_times));
+	thread->t_stamp = 0;
+	thread->t_readystamp = 0;
+
+	/* Priority fields */
+	thread->t_basepri = PRI_DEFAULT;
+	thread->t_pri = PRI_DEFAULT;
+	thread->t_blockedon = NULL;
+	thread->t_piwaitnext = NULL;
+	thread->t_heldlocks = NULL;
 
 	/* If you add to struct thread, be sure to initialize here */
 
@@ -167,6 +186,7 @@ cpu_create(unsigned hardware_number)
 {
 	struct cpu *c;
 	int result;
+	unsigned i;
 	char namebuf[16];
 
 	c = kmalloc(sizeof(*c));
@@ -180,6 +200,31 @@ cpu_create(unsigned hardware_number)
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
+	c->c_migrate_wchan = wchan_create("migrate");
+	if (c->c_migrate_wchan == NULL) {
+		panic("cpu_create: wchan_create failed\n");
+	}
+	threadlist_init(&c->c_migrating);
+	hist_init(&c->c_schedlat);
+#if OPT_IRQSTATS
+	c->c_irqoff_stamp = 0;
+	c->c_irqoff_max = 0;
+	c->c_irqoff_count = 0;
+#endif
+
+	c->c_work_head = c->c_work_tail = NULL;
+	spinlock_init(&c->c_work_lock);
+	c->c_work_wchan = wchan_create("work");
+	if (c->c_work_wchan == NULL) {
+		panic("cpu_create: wchan_create failed\n");
+	}
+
+	for (i=0; i<CPUCOUNTER_MAX; i++) {
+		c->c_counters[i] = 0;
+	}
+
+	c->c_rcu_qs = 0;
+	c->c_rcu_online = false;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -194,6 +239,9 @@ cpu_create(unsigned hardware_number)
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
 
+	/* Only the boot cpu is running yet; see cpu_hatch. */
+	c->c_rcu_online = (c->c_number == 0);
+
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
 	if (c->c_curthread == NULL) {
@@ -266,19 +314,34 @@ thread_destroy(struct thread *thread)
  * Clean up zombies. (Zombies are threads that have exited but still
  * need to have thread_destroy called on them.)
  *
- * The list of zombies is per-cpu.
+ * The list of zombies is per-cpu. Take the whole list at once with
+ * interrupts off, then destroy them with interrupts back on, since
+ * freeing stacks isn't quick and nothing else can see them any more.
  */
 static
 void
 exorcise(void)
 {
+	struct threadlist dead;
 	struct thread *z;
+	int spl;
+
+	if (threadlist_isempty(&curcpu->c_zombies)) {
+		/* Not worth turning interrupts off to find out */
+		return;
+	}
 
-	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
+	threadlist_init(&dead);
+	spl = splhigh();
+	threadlist_join(&dead, &curcpu->c_zombies);
+	splx(spl);
+
+	while ((z = threadlist_remhead(&dead)) != NULL) {
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
 		thread_destroy(z);
 	}
+	threadlist_cleanup(&dead);
 }
 
 /*
@@ -380,6 +443,9 @@ thread_bootstrap(void)
 	/* cpu_create() should have set t_proc. */
 	KASSERT(curthread->t_proc != NULL);
 
+	/* Devices can't interrupt yet, but will need this when they do. */
+	workqueue_start(curcpu->c_self);
+
 	/* Done */
 }
 
@@ -398,6 +464,12 @@ cpu_hatch(unsigned software_number)
 	KASSERT(curthread != NULL);
 	KASSERT(curcpu->c_number == software_number);
 
+	/* Interrupt handlers on this cpu will need this right away. */
+	workqueue_start(curcpu->c_self);
+
+	/* From here on rcu_synchronize has to wait for us. */
+	curcpu->c_rcu_online = true;
+
 	spl0();
 
 	kprintf("cpu%u: %s\n", software_number, cpu_identify());
@@ -407,23 +479,77 @@ cpu_hatch(unsigned software_number)
 }
 
 /*
- * Start up secondary cpus. Called from boot().
+ * Put T on run queue RQ behind every thread of the same or higher
+ * priority. When everyone has the same priority, which is the usual
+ * case, this is just addtail.
  */
+static
 void
-thread_start_cpus(void)
+thread_enqueue(struct threadlist *rq, struct thread *t)
 {
-	unsigned i;
+	struct thread *prev;
 
-	kprintf("cpu0: %s\n", cpu_identify());
+	THREADLIST_FORALL_REV(prev, *rq) {
+		if (prev->t_pri >= t->t_pri) {
+			threadlist_insertafter(rq, prev, t);
+			return;
+		}
+	}
+	threadlist_addhead(rq, t);
+}
 
-	cpu_startup_sem = sem_create("cpu_hatch", 0);
-	mainbus_start_cpus();
-	
-	for (i=0; i<cpuarray_num(&allcpus) - 1; i++) {
-		P(cpu_startup_sem);
+/*
+ * Choose a cpu for thread T from among those it's allowed to run on:
+ * an idle one if possible, otherwise the one with the shortest run
+ * queue. The run queues are looked at without locking them, so this
+ * is only a hint, but that's all it needs to be.
+ */
+static
+struct cpu *
+thread_pickcpu(struct thread *t)
+{
+	struct cpu *c, *best;
+	unsigned i, numcpus;
+
+	best = NULL;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		if (!CPUMASK_HAS(t->t_affinity, i)) {
+			continue;
+		}
+		c = cpuarray_get(&allcpus, i);
+		if (c->c_isidle) {
+			return c;
+		}
+		if (best == NULL ||
+		    c->c_runqueue.tl_count < best->c_runqueue.tl_count) {
+			best = c;
+		}
 	}
-	sem_destroy(cpu_startup_sem);
-	cpu_startup_sem = NULL;
+	/* thread_setaffinity doesn't allow masks with no cpus in them */
+	KASSERT(best != NULL);
+	return best;
+}
+
+/*
+ * Find an idle cpu thread T may run on, or return NULL if there isn't
+ * one. Like thread_pickcpu, this is only a hint.
+ */
+static
+struct cpu *
+thread_findidle(struct thread *t)
+{
+	struct cpu *c;
+	unsigned i, numcpus;
+
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (CPUMASK_HAS(t->t_affinity, i) && c->c_isidle) {
+			return c;
+		}
+	}
+	return NULL;
 }
 
 /*
@@ -447,10 +573,29 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 	}
 	else {
 		spinlock_acquire(&targetcpu->c_runqueue_lock);
+
+		/*
+		 * If the thread isn't allowed on its cpu any more, send
+		 * it somewhere it is allowed. This is only safe if the
+		 * old cpu isn't still running on the thread's stack,
+		 * which it can be if it went idle right after the
+		 * thread went to sleep. (See the long comment in
+		 * thread_consider_migration.) In that case leave it be;
+		 * it'll move the next time it yields.
+		 */
+		if (!CPUMASK_HAS(target->t_affinity, targetcpu->c_number) &&
+		    targetcpu->c_curthread != target) {
+			spinlock_release(&targetcpu->c_runqueue_lock);
+			targetcpu = thread_pickcpu(target);
+			target->t_cpu = targetcpu;
+			spinlock_acquire(&targetcpu->c_runqueue_lock);
+		}
 	}
 
+	target->t_readystamp = gettime_nsecs();
+
 	isidle = targetcpu->c_isidle;
-	threadlist_addtail(&targetcpu->c_runqueue, target);
+	thread_enqueue(&targetcpu->c_runqueue, target);
 	if (isidle) {
 		/*
 		 * Other processor is idle; send interrupt to make
@@ -464,6 +609,143 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 	}
 }
 
+/*
+ * Make all the threads in GROUP runnable on TARGETCPU, which they
+ * must all be allowed on, with one trip through its run queue lock
+ * and at most one IPI. Leaves GROUP empty.
+ */
+static
+void
+thread_make_runnable_group(struct cpu *targetcpu, struct threadlist *group)
+{
+	struct thread *t;
+	uint64_t now;
+
+	now = gettime_nsecs();
+	THREADLIST_FORALL(t, *group) {
+		DEBUGASSERT(t->t_cpu == targetcpu);
+		t->t_readystamp = now;
+	}
+
+	spinlock_acquire(&targetcpu->c_runqueue_lock);
+	while ((t = threadlist_remhead(group)) != NULL) {
+		thread_enqueue(&targetcpu->c_runqueue, t);
+	}
+	if (targetcpu->c_isidle) {
+		/*
+		 * Other processor is idle; send interrupt to make
+		 * sure it unidles.
+		 */
+		ipi_send(targetcpu, IPI_UNIDLE);
+	}
+	spinlock_release(&targetcpu->c_runqueue_lock);
+}
+
+/*
+ * Per-cpu migration thread. Threads that find in thread_switch that
+ * they're no longer allowed on this cpu are left on c_migrating and
+ * this thread is woken; it sends them on to a cpu they may use. This
+ * can't be done from thread_switch itself because the thread is still
+ * running on its stack until the switch completes.
+ */
+static
+void
+thread_migrator(void *data1, unsigned long data2)
+{
+	struct cpu *c = data1;
+	struct threadlist leaving;
+	struct thread *t;
+
+	(void)data2;
+
+	KASSERT(curcpu->c_self == c);
+	threadlist_init(&leaving);
+
+	while (1) {
+		wchan_lock(c->c_migrate_wchan);
+		spinlock_acquire(&c->c_runqueue_lock);
+		while ((t = threadlist_remhead(&c->c_migrating)) != NULL) {
+			threadlist_addtail(&leaving, t);
+		}
+		spinlock_release(&c->c_runqueue_lock);
+		if (threadlist_isempty(&leaving)) {
+			wchan_sleep(c->c_migrate_wchan);
+			continue;
+		}
+		wchan_unlock(c->c_migrate_wchan);
+
+		while ((t = threadlist_remhead(&leaving)) != NULL) {
+			t->t_cpu = thread_pickcpu(t);
+			thread_make_runnable(t, false);
+		}
+	}
+}
+
+/*
+ * Fork a kernel thread that is pinned to cpu C before it ever runs.
+ * Per-cpu service threads need this: if one could be migrated it
+ * might need another cpu's migration thread to get home. We pin
+ * ourselves to C for the duration of thread_fork and let the new
+ * thread inherit that; with interrupts off we can't be switched out
+ * in the meantime.
+ */
+int
+thread_fork_oncpu(const char *name, struct cpu *c,
+		  void (*entrypoint)(void *data1, unsigned long data2),
+		  void *data1, unsigned long data2)
+{
+	cpumask_t mask;
+	int spl, result;
+
+	spl = splhigh();
+	mask = curthread->t_affinity;
+	curthread->t_affinity = CPUMASK_CPU(c->c_number);
+	result = thread_fork(name, NULL, entrypoint, data1, data2);
+	curthread->t_affinity = mask;
+	splx(spl);
+	return result;
+}
+
+/*
+ * Start the migration thread for cpu C.
+ */
+static
+void
+thread_start_migrator(struct cpu *c)
+{
+	int result;
+
+	result = thread_fork_oncpu("migrate", c, thread_migrator, c, 0);
+	if (result) {
+		panic("thread_start_migrator: thread_fork failed: %s\n",
+		      strerror(result));
+	}
+}
+
+/*
+ * Start up secondary cpus. Called from boot().
+ */
+void
+thread_start_cpus(void)
+{
+	unsigned i;
+
+	kprintf("cpu0: %s\n", cpu_identify());
+
+	cpu_startup_sem = sem_create("cpu_hatch", 0);
+	mainbus_start_cpus();
+	
+	for (i=0; i<cpuarray_num(&allcpus) - 1; i++) {
+		P(cpu_startup_sem);
+	}
+	sem_destroy(cpu_startup_sem);
+	cpu_startup_sem = NULL;
+
+	for (i=0; i<cpuarray_num(&allcpus); i++) {
+		thread_start_migrator(cpuarray_get(&allcpus, i));
+	}
+}
+
 /*
  * Create a new thread based on an existing one.
  *
@@ -472,15 +754,19 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
  *
  * The new thread is created in the process P. If P is null, the
  * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * as the caller, unless the scheduler intervenes first or the
+ * caller's affinity (which the new thread inherits) doesn't include
+ * that CPU. (Or, for thread_fork_idle, on an idle CPU if there is one.)
  */
+static
 int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+thread_fork_common(const char *name,
+		   struct proc *proc,
+		   void (*entrypoint)(void *data1, unsigned long data2),
+		   void *data1, unsigned long data2, bool toidle)
 {
 	struct thread *newthread;
+	struct cpu *idlecpu;
 	int result;
 
 #ifdef UW
@@ -506,6 +792,14 @@ thread_fork(const char *name,
 
 	/* Thread subsystem fields */
 	newthread->t_cpu = curthread->t_cpu;
+	newthread->t_affinity = curthread->t_affinity;
+	newthread->t_basepri = newthread->t_pri = curthread->t_basepri;
+	if (toidle) {
+		idlecpu = thread_findidle(newthread);
+		if (idlecpu != NULL) {
+			newthread->t_cpu = idlecpu;
+		}
+	}
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -528,12 +822,97 @@ thread_fork(const char *name,
 	/* Set up the switchframe so entrypoint() gets called */
 	switchframe_init(newthread, entrypoint, data1, data2);
 
-	/* Lock the current cpu's run queue and make the new thread runnable */
+	/* Lock the chosen cpu's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
 	return 0;
 }
 
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	return thread_fork_common(name, proc, entrypoint, data1, data2,
+				  false);
+}
+
+int
+thread_fork_idle(const char *name,
+		 struct proc *proc,
+		 void (*entrypoint)(void *data1, unsigned long data2),
+		 void *data1, unsigned long data2)
+{
+	return thread_fork_common(name, proc, entrypoint, data1, data2,
+				  true);
+}
+
+/*
+ * Cpu time accounting.
+ *
+ * Each thread's time is charged in intervals: t_stamp is when the
+ * current one started, and whoever ends it (the trap code on the
+ * user/kernel boundary, or thread_switch) adds the elapsed time to
+ * the appropriate counter. The clock isn't there early in boot, in
+ * which case gettime_nsecs returns 0 and nothing gets charged.
+ */
+static
+void
+thread_charge(struct thread *t, uint64_t *counter)
+{
+	uint64_t now;
+
+	now = gettime_nsecs();
+	if (t->t_stamp != 0 && now > t->t_stamp) {
+		*counter += now - t->t_stamp;
+	}
+	t->t_stamp = now;
+}
+
+void
+thread_account_user(void)
+{
+	thread_charge(curthread, &curthread->t_times.ct_utime);
+}
+
+void
+thread_account_system(void)
+{
+	thread_charge(curthread, &curthread->t_times.ct_stime);
+}
+
+/*
+ * Called with the run queue lock held when thread T has just been
+ * switched to: charge the time it spent on the run queue as wait
+ * time, record it in this cpu's latency histogram, and start a new
+ * interval.
+ */
+static
+void
+thread_account_switchin(struct thread *t)
+{
+	uint64_t now;
+
+	now = gettime_nsecs();
+	if (t->t_readystamp != 0 && now >= t->t_readystamp) {
+		t->t_times.ct_wtime += now - t->t_readystamp;
+		hist_add(&curcpu->c_schedlat, now - t->t_readystamp);
+	}
+	t->t_readystamp = 0;
+	t->t_stamp = now;
+}
+
+void
+cputimes_add(struct cputimes *to, const struct cputimes *from)
+{
+	to->ct_utime += from->ct_utime;
+	to->ct_stime += from->ct_stime;
+	to->ct_wtime += from->ct_wtime;
+	to->ct_nvcsw += from->ct_nvcsw;
+	to->ct_nivcsw += from->ct_nivcsw;
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -542,12 +921,17 @@ thread_fork(const char *name,
  *
  * If NEWSTATE is S_SLEEP, the thread is queued on the wait channel
  * WC. Otherwise WC should be NULL.
+ *
+ * If NEWSTATE is S_READY but the thread may no longer run on this
+ * CPU, it is handed to this CPU's migration thread instead of being
+ * put back on the run queue.
  */
 static
 void
 thread_switch(threadstate_t newstate, struct wchan *wc)
 {
 	struct thread *cur, *next;
+	bool migrate;
 	int spl;
 
 	DEBUGASSERT(curcpu->c_curthread == curthread);
@@ -570,22 +954,53 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 	/* Check the stack guard band. */
 	thread_checkstack(cur);
 
+	/* Sleeping or yielding in an RCU read section is not allowed. */
+	KASSERT(cur->t_rcudepth == 0);
+
+	/*
+	 * If we're leaving this cpu, wake its migration thread so
+	 * there's something to switch to. This has to happen before
+	 * we take the run queue lock. The migration thread can't run
+	 * until we've switched away, because it only runs here and
+	 * interrupts are off, so it can't miss us.
+	 */
+	migrate = newstate == S_READY &&
+		!CPUMASK_HAS(cur->t_affinity, curcpu->c_number);
+	if (migrate) {
+		wchan_wakeone(curcpu->c_migrate_wchan);
+	}
+
 	/* Lock the run queue. */
 	spinlock_acquire(&curcpu->c_runqueue_lock);
 
 	/* Micro-optimization: if nothing to do, just return */
-	if (newstate == S_READY && threadlist_isempty(&curcpu->c_runqueue)) {
+	if (newstate == S_READY && !migrate &&
+	    threadlist_isempty(&curcpu->c_runqueue)) {
 		spinlock_release(&curcpu->c_runqueue_lock);
 		splx(spl);
 		return;
 	}
 
+	/* Charge the time up to now to the outgoing thread. */
+	thread_charge(cur, &cur->t_times.ct_stime);
+	if (newstate == S_SLEEP) {
+		cur->t_times.ct_nvcsw++;
+	}
+	else if (newstate == S_READY) {
+		cur->t_times.ct_nivcsw++;
+	}
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
 		panic("Illegal S_RUN in thread_switch\n");
 	    case S_READY:
-		thread_make_runnable(cur, true /*have lock*/);
+		if (migrate) {
+			threadlist_addtail(&curcpu->c_migrating, cur);
+		}
+		else {
+			thread_make_runnable(cur, true /*have lock*/);
+		}
 		break;
 	    case S_SLEEP:
 		cur->t_wchan_name = wc->wc_name;
@@ -635,12 +1050,22 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
+#if OPT_IRQSTATS
+			/* Idling turns interrupts on; don't count it */
+			spl_irqoff_end();
+			cpu_idle();
+			spl_irqoff_begin();
+#else
 			cpu_idle();
+#endif
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
 
+	/* Switching threads is an RCU quiescent state. */
+	rcu_quiescent();
+
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
 	 * curthread and it may not be, depending on how curthread and
@@ -705,17 +1130,20 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Start charging time to this thread. */
+	thread_account_switchin(cur);
+
 	/* Unlock the run queue. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
 	/* Activate our address space in the MMU. */
 	as_activate();
 
-	/* Clean up dead threads. */
-	exorcise();
-
 	/* Turn interrupts back on. */
 	splx(spl);
+
+	/* Clean up dead threads. */
+	exorcise();
 }
 
 /*
@@ -738,18 +1166,21 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Start charging time to this thread. */
+	thread_account_switchin(cur);
+
 	/* Release the runqueue lock acquired in thread_switch. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
 	/* Activate our address space in the MMU. */
 	as_activate();
 
-	/* Clean up dead threads. */
-	exorcise();
-
 	/* Enable interrupts. */
 	spl0();
 
+	/* Clean up dead threads. */
+	exorcise();
+
 #if OPT_SYNCHPROBS
 	/* Yield a random number of times to get a good mix of threads. */
 	{
@@ -817,6 +1248,45 @@ thread_yield(void)
 	thread_switch(S_READY, NULL);
 }
 
+/*
+ * Set the affinity mask of thread T. The mask is only ever looked at
+ * by the scheduler as a whole word, so no lock is needed to change
+ * it; a thread that's caught in the middle on the way to sleep or
+ * onto a run queue just moves the next time around.
+ */
+int
+thread_setaffinity(struct thread *t, cpumask_t mask)
+{
+	unsigned numcpus;
+
+	numcpus = cpuarray_num(&allcpus);
+	if (numcpus < 32) {
+		mask &= CPUMASK_CPU(numcpus) - 1;
+	}
+	if (mask == 0) {
+		return EINVAL;
+	}
+
+	t->t_affinity = mask;
+	if (t == curthread && !CPUMASK_HAS(mask, curcpu->c_number)) {
+		/* thread_switch hands us to the migration thread */
+		thread_yield();
+	}
+	return 0;
+}
+
+unsigned
+thread_numcpus(void)
+{
+	return cpuarray_num(&allcpus);
+}
+
+struct cpu *
+thread_getcpu(unsigned n)
+{
+	return cpuarray_get(&allcpus, n);
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -829,10 +1299,75 @@ thread_yield(void)
 void
 schedule(void)
 {
+	struct threadlist *rq = &curcpu->c_runqueue;
+	struct threadlist all;
+	struct thread *t;
+	bool sorted = true;
+	int lastpri = PRI_MAX;
+
+	spinlock_acquire(&curcpu->c_runqueue_lock);
+
+	/*
+	 * Priorities can still change behind the run queue's back
+	 * (a boost that races with the thread being queued misses
+	 * thread_reprioritize), so put the queue back in order.
+	 * Usually it already is.
+	 */
+	THREADLIST_FORALL(t, *rq) {
+		if (t->t_pri > lastpri) {
+			sorted = false;
+			break;
+		}
+		lastpri = t->t_pri;
+	}
+	if (!sorted) {
+		threadlist_init(&all);
+		threadlist_join(&all, rq);
+		while ((t = threadlist_remhead(&all)) != NULL) {
+			thread_enqueue(rq, t);
+		}
+		threadlist_cleanup(&all);
+	}
+
+	spinlock_release(&curcpu->c_runqueue_lock);
+}
+
+void
+thread_setpriority(int pri)
+{
+	KASSERT(pri >= PRI_MIN && pri <= PRI_MAX);
+
+	curthread->t_basepri = pri;
+	/* Let the lock code work out whether we're still boosted. */
+	lock_pi_update();
+}
+
+void
+thread_reprioritize(struct thread *t)
+{
+	struct cpu *c;
+	struct thread *t2;
+	bool found = false;
+
 	/*
-	 * You can write this. If we do nothing, threads will run in
-	 * round-robin fashion.
+	 * T can be moved to another cpu while we look; if so, it's
+	 * being queued there after the boost and is in order already.
 	 */
+	c = t->t_cpu;
+	spinlock_acquire(&c->c_runqueue_lock);
+	if (t->t_cpu == c) {
+		THREADLIST_FORALL(t2, c->c_runqueue) {
+			if (t2 == t) {
+				found = true;
+				break;
+			}
+		}
+	}
+	if (found) {
+		threadlist_remove(&c->c_runqueue, t);
+		thread_enqueue(&c->c_runqueue, t);
+	}
+	spinlock_release(&c->c_runqueue_lock);
 }
 
 /*
@@ -856,7 +1391,7 @@ void
 thread_consider_migration(void)
 {
 	unsigned my_count, total_count, one_share, to_send;
-	unsigned i, numcpus;
+	unsigned i, numcpus, tries;
 	struct cpu *c;
 	struct threadlist victims;
 	struct thread *t;
@@ -893,8 +1428,12 @@ thread_consider_migration(void)
 			continue;
 		}
 		spinlock_acquire(&c->c_runqueue_lock);
-		while (c->c_runqueue.tl_count < one_share && to_send > 0) {
+		/* Look at each victim at most once per destination cpu. */
+		tries = victims.tl_count;
+		while (c->c_runqueue.tl_count < one_share && to_send > 0 &&
+		       tries > 0) {
 			t = threadlist_remhead(&victims);
+			tries--;
 			/*
 			 * Ordinarily, curthread will not appear on
 			 * the run queue. However, it can under the
@@ -923,6 +1462,16 @@ thread_consider_migration(void)
 				continue;
 			}
 
+			/*
+			 * Threads that aren't allowed on this cpu
+			 * also go to the end of the list; another cpu
+			 * may take them, or they stay home.
+			 */
+			if (!CPUMASK_HAS(t->t_affinity, c->c_number)) {
+				threadlist_addtail(&victims, t);
+				continue;
+			}
+
 			t->t_cpu = c;
 			threadlist_addtail(&c->c_runqueue, t);
 			DEBUG(DB_THREADS,
@@ -957,6 +1506,128 @@ thread_consider_migration(void)
 	threadlist_cleanup(&victims);
 }
 
+/*
+ * Print each cpu's current thread and run queue, with affinity masks.
+ *
+ * kprintf can't be called with a run queue lock held (it may sleep,
+ * and even when it doesn't it's very slow) so take a copy of each
+ * queue under the lock and print that.
+ */
+#define RQ_SHOW 16
+
+struct rq_entry {
+	char name[16];
+	cpumask_t affinity;
+};
+
+static
+void
+rq_snap(struct rq_entry *e, struct thread *t)
+{
+	snprintf(e->name, sizeof(e->name), "%s", t->t_name);
+	e->affinity = t->t_affinity;
+}
+
+void
+thread_printrunqueues(void)
+{
+	struct rq_entry cur, q[RQ_SHOW];
+	struct thread *t;
+	struct cpu *c;
+	unsigned i, j, n, count, numcpus;
+	bool isidle;
+
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+
+		n = 0;
+		spinlock_acquire(&c->c_runqueue_lock);
+		rq_snap(&cur, c->c_curthread);
+		isidle = c->c_isidle;
+		count = c->c_runqueue.tl_count;
+		THREADLIST_FORALL(t, c->c_runqueue) {
+			if (n == RQ_SHOW) {
+				break;
+			}
+			rq_snap(&q[n++], t);
+		}
+		spinlock_release(&c->c_runqueue_lock);
+
+		kprintf("cpu%u: %s %s (affinity 0x%x), %u ready\n",
+			i, isidle ? "idle, last" : "running",
+			cur.name, cur.affinity, count);
+		for (j=0; j<n; j++) {
+			kprintf("    %-16s 0x%08x\n", q[j].name, q[j].affinity);
+		}
+		if (count > n) {
+			kprintf("    ... %u more\n", count - n);
+		}
+	}
+}
+
+/*
+ * Print (and maybe reset) the scheduling latency histograms. As with
+ * the run queues, copy each one under the lock and print the copy.
+ */
+void
+thread_printschedlat(bool reset)
+{
+	struct histogram h, all;
+	struct cpu *c;
+	unsigned i, numcpus;
+
+	hist_init(&all);
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+
+		spinlock_acquire(&c->c_runqueue_lock);
+		h = c->c_schedlat;
+		if (reset) {
+			hist_init(&c->c_schedlat);
+		}
+		spinlock_release(&c->c_runqueue_lock);
+
+		kprintf("cpu%u:\n", i);
+		hist_print(&h);
+		hist_merge(&all, &h);
+	}
+	if (numcpus > 1) {
+		kprintf("all cpus:\n");
+		hist_print(&all);
+	}
+	if (reset) {
+		kprintf("Scheduling latency histograms reset.\n");
+	}
+}
+
+#if OPT_IRQSTATS
+/*
+ * Print the per-cpu interrupts-off statistics. The fields belong to
+ * each cpu and are only changed with its interrupts off, so reading
+ * them from here can race; that's harmless for statistics, and
+ * resetting them races the same way.
+ */
+void
+cpu_printirqstats(bool reset)
+{
+	struct cpu *c;
+	unsigned i, numcpus;
+
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		kprintf("cpu%u: interrupts off %u times, longest %lluns\n",
+			i, c->c_irqoff_count, c->c_irqoff_max);
+		if (reset) {
+			c->c_irqoff_count = 0;
+			c->c_irqoff_max = 0;
+		}
+	}
+}
+#endif /* OPT_IRQSTATS */
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -1028,6 +1699,73 @@ wchan_sleep(struct wchan *wc)
 	thread_switch(S_SLEEP, wc);
 }
 
+/*
+ * wchan_timedsleep's timeout. If the thread is still on the channel,
+ * nobody has awakened it, so take it off and wake it ourselves.
+ * Otherwise it's already on its way, or was moved elsewhere by
+ * wchan_requeue, and isn't ours to wake.
+ */
+struct wchan_timer {
+	struct wchan *wt_wc;
+	struct thread *wt_thread;
+	bool wt_fired;
+};
+
+static
+void
+wchan_timeout(void *data)
+{
+	struct wchan_timer *wt = data;
+	struct wchan *wc = wt->wt_wc;
+	struct thread *t;
+	bool found = false;
+
+	spinlock_acquire(&wc->wc_lock);
+	THREADLIST_FORALL(t, wc->wc_threads) {
+		if (t == wt->wt_thread) {
+			found = true;
+			break;
+		}
+	}
+	if (found) {
+		threadlist_remove(&wc->wc_threads, t);
+		wt->wt_fired = true;
+	}
+	spinlock_release(&wc->wc_lock);
+
+	if (found) {
+		thread_make_runnable(t, false);
+	}
+}
+
+/*
+ * Like wchan_sleep, with a time limit. The timeout is set while the
+ * channel is still locked, so it can't go off until we're on the
+ * channel's list; and it's cancelled before we return, which waits
+ * for it if it's going off right now, so WT can be on our stack.
+ */
+int
+wchan_timedsleep(struct wchan *wc, unsigned ticks)
+{
+	struct wchan_timer wt;
+	struct timeout to;
+
+	/* may not sleep in an interrupt handler */
+	KASSERT(!curthread->t_in_interrupt);
+	KASSERT(spinlock_do_i_hold(&wc->wc_lock));
+
+	wt.wt_wc = wc;
+	wt.wt_thread = curthread;
+	wt.wt_fired = false;
+	timeout_init(&to, wchan_timeout, &wt);
+	timeout_add(&to, ticks);
+
+	thread_switch(S_SLEEP, wc);
+
+	timeout_cancel(&to);
+	return wt.wt_fired ? ETIMEDOUT : 0;
+}
+
 /*
  * Wake up one thread sleeping on a wait channel.
  */
@@ -1053,6 +1791,62 @@ wchan_wakeone(struct wchan *wc)
 	thread_make_runnable(target, false);
 }
 
+/*
+ * Wake up the highest priority thread sleeping on a wait channel.
+ * Sleepers are in the order they went to sleep, so the first one
+ * found at the top priority is the oldest.
+ */
+void
+wchan_wakepri(struct wchan *wc)
+{
+	struct thread *t, *target = NULL;
+
+	spinlock_acquire(&wc->wc_lock);
+	THREADLIST_FORALL(t, wc->wc_threads) {
+		if (target == NULL || t->t_pri > target->t_pri) {
+			target = t;
+		}
+	}
+	if (target != NULL) {
+		threadlist_remove(&wc->wc_threads, target);
+	}
+	spinlock_release(&wc->wc_lock);
+
+	if (target == NULL) {
+		/* Nobody was sleeping. */
+		return;
+	}
+
+	thread_make_runnable(target, false);
+}
+
+/*
+ * Move everyone sleeping on FROM to TO; in constant time if there's
+ * no FUNC to call for each of them.
+ */
+unsigned
+wchan_requeue(struct wchan *from, struct wchan *to,
+	      void (*func)(struct thread *, void *), void *data)
+{
+	struct thread *t;
+	unsigned n;
+
+	KASSERT(from != to);
+
+	spinlock_acquire(&from->wc_lock);
+	spinlock_acquire(&to->wc_lock);
+	n = from->wc_threads.tl_count;
+	if (func != NULL) {
+		THREADLIST_FORALL(t, from->wc_threads) {
+			func(t, data);
+		}
+	}
+	threadlist_join(&to->wc_threads, &from->wc_threads);
+	spinlock_release(&to->wc_lock);
+	spinlock_release(&from->wc_lock);
+	return n;
+}
+
 /*
  * Wake up all threads sleeping on a wait channel.
  */
@@ -1060,18 +1854,19 @@ void
 wchan_wakeall(struct wchan *wc)
 {
 	struct thread *target;
-	struct threadlist list;
+	struct threadlist list, group, rest;
+	struct cpu *targetcpu;
 
 	threadlist_init(&list);
+	threadlist_init(&group);
+	threadlist_init(&rest);
 
 	/*
 	 * Lock the channel and grab all the threads, moving them to a
 	 * private list.
 	 */
 	spinlock_acquire(&wc->wc_lock);
-	while ((target = threadlist_remhead(&wc->wc_threads)) != NULL) {
-		threadlist_addtail(&list, target);
-	}
+	threadlist_join(&list, &wc->wc_threads);
 	/*
 	 * Nobody else can wake up these threads now, so we don't need
 	 * to hang onto the lock.
@@ -1079,14 +1874,39 @@ wchan_wakeall(struct wchan *wc)
 	spinlock_release(&wc->wc_lock);
 
 	/*
-	 * We could conceivably sort by cpu first to cause fewer lock
-	 * ops and fewer IPIs, but for now at least don't bother. Just
-	 * make each thread runnable.
+	 * Sort by cpu so each cpu's run queue gets locked once and
+	 * gets at most one IPI: take the cpu of the first thread,
+	 * pull out everything else headed there, and hand the lot
+	 * over. That's one pass per distinct cpu, which is cheap next
+	 * to a lock round trip per thread.
+	 *
+	 * Threads that aren't allowed on their cpu any more go the
+	 * long way through thread_make_runnable, which finds them a
+	 * new one.
 	 */
 	while ((target = threadlist_remhead(&list)) != NULL) {
-		thread_make_runnable(target, false);
+		targetcpu = target->t_cpu;
+		if (!CPUMASK_HAS(target->t_affinity, targetcpu->c_number)) {
+			thread_make_runnable(target, false);
+			continue;
+		}
+		threadlist_addtail(&group, target);
+		while ((target = threadlist_remhead(&list)) != NULL) {
+			if (target->t_cpu == targetcpu &&
+			    CPUMASK_HAS(target->t_affinity,
+					targetcpu->c_number)) {
+				threadlist_addtail(&group, target);
+			}
+			else {
+				threadlist_addtail(&rest, target);
+			}
+		}
+		threadlist_join(&list, &rest);
+		thread_make_runnable_group(targetcpu, &group);
 	}
 
+	threadlist_cleanup(&rest);
+	threadlist_cleanup(&group);
 	threadlist_cleanup(&list);
 }
 
@@ -238,3 +238,31 @@ threadlist_remove(struct threadlist *tl, struct thread *t)
 	DEBUGASSERT(tl->tl_count > 0);
 	tl->tl_count--;
 }
+
+void
+threadlist_join(struct threadlist *to, struct threadlist *from)
+{
+	struct threadlistnode *first, *last;
+
+	DEBUGASSERT(to != NULL);
+	DEBUGASSERT(from != NULL);
+
+	if (from->tl_count == 0) {
+		return;
+	}
+
+	first = from->tl_head.tln_next;
+	last = from->tl_tail.tln_prev;
+
+	/* Hook FROM's threads onto the end of TO */
+	first->tln_prev = to->tl_tail.tln_prev;
+	first->tln_prev->tln_next = first;
+	last->tln_next = &to->tl_tail;
+	to->tl_tail.tln_prev = last;
+	to->tl_count += from->tl_count;
+
+	/* And leave FROM empty */
+	from->tl_head.tln_next = &from->tl_tail;
+	from->tl_tail.tln_prev = &from->tl_head;
+	from->tl_count = 0;
+}
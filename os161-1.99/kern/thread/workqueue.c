@@ -0,0 +1,105 @@
+/*
+ * Deferred work. See workqueue.h for details.
+ *
+ * The queue itself lives in struct cpu. Its spinlock is taken from
+ * interrupt handlers, which is fine since spinlocks turn interrupts
+ * off.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <workqueue.h>
+
+void
+work_init(struct work *w, void (*func)(void *), void *data)
+{
+	w->w_next = NULL;
+	w->w_func = func;
+	w->w_data = data;
+	w->w_queued = false;
+}
+
+void
+work_queue(struct work *w)
+{
+	struct cpu *c;
+
+	c = curcpu->c_self;
+
+	spinlock_acquire(&c->c_work_lock);
+	KASSERT(!w->w_queued);
+	w->w_queued = true;
+	w->w_next = NULL;
+	if (c->c_work_tail == NULL) {
+		c->c_work_head = w;
+	}
+	else {
+		c->c_work_tail->w_next = w;
+	}
+	c->c_work_tail = w;
+	spinlock_release(&c->c_work_lock);
+
+	wchan_wakeone(c->c_work_wchan);
+}
+
+/*
+ * The worker thread. Take the whole queue at once, then run it with
+ * no locks held.
+ *
+ * The wchan is locked before looking at the queue, and work_queue
+ * adds to the queue before waking the wchan, so a wakeup can't be
+ * missed.
+ */
+static
+void
+workqueue_thread(void *data1, unsigned long data2)
+{
+	struct cpu *c = data1;
+	struct work *w, *next;
+
+	(void)data2;
+
+	KASSERT(curcpu->c_self == c);
+
+	while (1) {
+		wchan_lock(c->c_work_wchan);
+		spinlock_acquire(&c->c_work_lock);
+		w = c->c_work_head;
+		c->c_work_head = c->c_work_tail = NULL;
+		spinlock_release(&c->c_work_lock);
+		if (w == NULL) {
+			wchan_sleep(c->c_work_wchan);
+			continue;
+		}
+		wchan_unlock(c->c_work_wchan);
+
+		for (; w != NULL; w = next) {
+			next = w->w_next;
+			/*
+			 * Clear w_queued first: the function may
+			 * cause the item to be queued again.
+			 */
+			w->w_queued = false;
+			w->w_func(w->w_data);
+		}
+	}
+}
+
+void
+workqueue_start(struct cpu *c)
+{
+	char name[16];
+	int result;
+
+	snprintf(name, sizeof(name), "work%u", c->c_number);
+	result = thread_fork_oncpu(name, c, workqueue_thread, c, 0);
+	if (result) {
+		panic("workqueue_start: thread_fork failed: %s\n",
+		      strerror(result));
+	}
+}
@@ -293,6 +293,21 @@ dev_namefile(struct vnode *v, struct uio *uio)
 	return 0;
 }
 
+/*
+ * For poll() and select(). Hand off to d_poll, if there is one.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, struct poller *pl, int *revents)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_poll == NULL) {
+		return vnode_poll_ready(v, events, pl, revents);
+	}
+	return d->d_poll(d, events, pl, revents);
+}
+
 /*
  * Operations that are completely meaningless on devices.
  */
@@ -430,6 +445,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	dev_mmap,
 	dev_truncate,
 	dev_namefile,
+	dev_poll,
 	null_creat,
 	null_symlink,
 	null_mkdir,
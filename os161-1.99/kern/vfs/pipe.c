@@ -0,0 +1,624 @@
+/*
+ * Pipes. See pipe.h for the interface.
+ *
+ * A pipe is a ring buffer of PIPE_SIZE bytes with a vnode for each
+ * end. Both vnodes live inside struct pipe, which goes away when the
+ * second of them is reclaimed.
+ *
+ * The ring is "lock-light": the spinlock only covers the indices and
+ * the flags, and is never held while copying. A reader looks at how
+ * much data there is, drops the spinlock, and uiomoves it straight
+ * out of the ring; a writer does the same with the free space. That's
+ * safe because only the reader moves p_head and only the writer adds
+ * to p_count, so the bytes each side is copying can't be touched by
+ * the other until it hands them over. Multiple readers (or multiple
+ * writers) queue up on a sleep lock, p_rlock (or p_wlock), held for
+ * the whole read (or write), so writes aren't interleaved.
+ *
+ * Readers and writers sleep on separate wait channels. Wakeups are
+ * batched: a writer that needs room sleeps until there's at least
+ * PIPE_WAKE bytes free (or enough for what it has left), and readers
+ * only wake it once that's true; writers wake readers once PIPE_WAKE
+ * bytes are waiting, or at the end of the write. So a big transfer
+ * costs a couple of context switches per PIPE_WAKE bytes rather than
+ * one per byte or per small chunk.
+ *
+ * Threads in poll() wait on each end's pollq, and get woken at the
+ * same points as sleeping readers or writers on that end would be.
+ * The write end only counts as writable with PIPE_WAKE bytes free,
+ * which is enough that a write then won't block.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <lib.h>
+#include <stat.h>
+#include <uio.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <wchan.h>
+#include <poll.h>
+#include <vm.h>
+#include <vnode.h>
+#include <pipe.h>
+
+#define PIPE_SIZE	(4 * PAGE_SIZE)	/* bytes in the ring */
+#define PIPE_WAKE	(PIPE_SIZE / 4)	/* wakeup watermark */
+
+struct pipe {
+	char *p_buf;			/* the ring */
+	struct lock *p_rlock;		/* one reader at a time */
+	struct lock *p_wlock;		/* one writer at a time */
+	struct wchan *p_rwchan;		/* readers wait here for data */
+	struct wchan *p_wwchan;		/* writers wait here for room */
+	struct pollq p_rpollq;		/* pollers of the read end */
+	struct pollq p_wpollq;		/* pollers of the write end */
+
+	struct spinlock p_lock;		/* protects the rest */
+	unsigned p_head;		/* offset of the first byte of data */
+	unsigned p_count;		/* bytes of data */
+	bool p_rwaiting;		/* a reader is asleep */
+	bool p_wwaiting;		/* a writer is asleep */
+	bool p_rclosed;			/* read end has been closed */
+	bool p_wclosed;			/* write end has been closed */
+	unsigned p_vnodes;		/* vnodes not yet reclaimed */
+
+	struct vnode p_readvn;
+	struct vnode p_writevn;
+};
+
+/*
+ * Free a pipe, or the part of it pipe_create managed to make.
+ */
+static
+void
+pipe_destroy(struct pipe *p)
+{
+	if (p->p_wwchan != NULL) {
+		wchan_destroy(p->p_wwchan);
+	}
+	if (p->p_rwchan != NULL) {
+		wchan_destroy(p->p_rwchan);
+	}
+	if (p->p_wlock != NULL) {
+		lock_destroy(p->p_wlock);
+	}
+	if (p->p_rlock != NULL) {
+		lock_destroy(p->p_rlock);
+	}
+	if (p->p_buf != NULL) {
+		kfree(p->p_buf);
+	}
+	pollq_cleanup(&p->p_wpollq);
+	pollq_cleanup(&p->p_rpollq);
+	spinlock_cleanup(&p->p_lock);
+	kfree(p);
+}
+
+/*
+ * Sleep on WC. Called with the spinlock held; returns with it held.
+ */
+static
+void
+pipe_sleep(struct pipe *p, struct wchan *wc)
+{
+	wchan_lock(wc);
+	spinlock_release(&p->p_lock);
+	wchan_sleep(wc);
+	spinlock_acquire(&p->p_lock);
+}
+
+/*
+ * Copy LEN bytes between UIO and the ring starting at offset START,
+ * wrapping around the end of the buffer if need be.
+ */
+static
+int
+pipe_uiomove(struct pipe *p, unsigned start, size_t len, struct uio *uio)
+{
+	size_t first;
+	int result;
+
+	first = PIPE_SIZE - start;
+	if (first > len) {
+		first = len;
+	}
+	result = uiomove(p->p_buf + start, first, uio);
+	if (result == 0 && len > first) {
+		result = uiomove(p->p_buf, len - first, uio);
+	}
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// vnode operations
+
+/*
+ * Nothing to do; pipe_create opens both ends itself.
+ */
+static
+int
+pipe_open(struct vnode *v, int flags)
+{
+	(void)v;
+	(void)flags;
+	return 0;
+}
+
+/*
+ * Last close of one end: tell anyone waiting on the other end.
+ */
+static
+int
+pipe_close(struct vnode *v)
+{
+	struct pipe *p = v->vn_data;
+
+	spinlock_acquire(&p->p_lock);
+	if (v == &p->p_readvn) {
+		p->p_rclosed = true;
+		p->p_wwaiting = false;
+		spinlock_release(&p->p_lock);
+		wchan_wakeall(p->p_wwchan);
+		pollq_wakeup(&p->p_wpollq);
+	}
+	else {
+		KASSERT(v == &p->p_writevn);
+		p->p_wclosed = true;
+		p->p_rwaiting = false;
+		spinlock_release(&p->p_lock);
+		wchan_wakeall(p->p_rwchan);
+		pollq_wakeup(&p->p_rpollq);
+	}
+	return 0;
+}
+
+/*
+ * Last reference to one end. When both are gone, so is the pipe.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *p = v->vn_data;
+	unsigned left;
+
+	VOP_CLEANUP(v);
+
+	spinlock_acquire(&p->p_lock);
+	KASSERT(p->p_vnodes > 0);
+	left = --p->p_vnodes;
+	spinlock_release(&p->p_lock);
+
+	if (left == 0) {
+		pipe_destroy(p);
+	}
+	return 0;
+}
+
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	unsigned start;
+	size_t len, resid;
+	bool room, wake;
+	int result;
+
+	KASSERT(v == &p->p_readvn);
+	KASSERT(uio->uio_rw == UIO_READ);
+
+	if (uio->uio_resid == 0) {
+		return 0;
+	}
+
+	lock_acquire(p->p_rlock);
+	spinlock_acquire(&p->p_lock);
+	while (p->p_count == 0 && !p->p_wclosed) {
+		p->p_rwaiting = true;
+		pipe_sleep(p, p->p_rwchan);
+	}
+
+	/* Take whatever is there; if that's nothing, it's end of file. */
+	len = p->p_count;
+	if (len > uio->uio_resid) {
+		len = uio->uio_resid;
+	}
+	start = p->p_head;
+	spinlock_release(&p->p_lock);
+
+	resid = uio->uio_resid;
+	result = pipe_uiomove(p, start, len, uio);
+	len = resid - uio->uio_resid;
+
+	spinlock_acquire(&p->p_lock);
+	p->p_head = (p->p_head + len) % PIPE_SIZE;
+	p->p_count -= len;
+	room = PIPE_SIZE - p->p_count >= PIPE_WAKE;
+	wake = p->p_wwaiting && room;
+	if (wake) {
+		p->p_wwaiting = false;
+	}
+	spinlock_release(&p->p_lock);
+
+	if (wake) {
+		wchan_wakeall(p->p_wwchan);
+	}
+	if (room && len > 0) {
+		pollq_wakeup(&p->p_wpollq);
+	}
+	lock_release(p->p_rlock);
+	return result;
+}
+
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	unsigned start;
+	size_t len, want, resid;
+	bool ready, wake;
+	int result = 0;
+
+	KASSERT(v == &p->p_writevn);
+	KASSERT(uio->uio_rw == UIO_WRITE);
+
+	lock_acquire(p->p_wlock);
+	while (uio->uio_resid > 0) {
+		spinlock_acquire(&p->p_lock);
+
+		/* Wait for a worthwhile amount of room. */
+		want = uio->uio_resid < PIPE_WAKE ? uio->uio_resid : PIPE_WAKE;
+		while (!p->p_rclosed && PIPE_SIZE - p->p_count < want) {
+			p->p_wwaiting = true;
+			pipe_sleep(p, p->p_wwchan);
+		}
+		if (p->p_rclosed) {
+			spinlock_release(&p->p_lock);
+			result = EPIPE;
+			break;
+		}
+
+		len = PIPE_SIZE - p->p_count;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		start = (p->p_head + p->p_count) % PIPE_SIZE;
+		spinlock_release(&p->p_lock);
+
+		resid = uio->uio_resid;
+		result = pipe_uiomove(p, start, len, uio);
+		len = resid - uio->uio_resid;
+
+		spinlock_acquire(&p->p_lock);
+		p->p_count += len;
+		ready = p->p_count > 0 &&
+			(p->p_count >= PIPE_WAKE || uio->uio_resid == 0 ||
+			 result != 0);
+		wake = p->p_rwaiting && ready;
+		if (wake) {
+			p->p_rwaiting = false;
+		}
+		spinlock_release(&p->p_lock);
+
+		if (wake) {
+			wchan_wakeall(p->p_rwchan);
+		}
+		if (ready && len > 0) {
+			pollq_wakeup(&p->p_rpollq);
+		}
+		if (result) {
+			break;
+		}
+	}
+	lock_release(p->p_wlock);
+	return result;
+}
+
+/*
+ * Used for several operations with the same type signature that
+ * don't make sense on pipes.
+ */
+static
+int
+pipe_badio(struct vnode *v, struct uio *uio)
+{
+	(void)v;
+	(void)uio;
+	return EINVAL;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *p = v->vn_data;
+
+	bzero(statbuf, sizeof(*statbuf));
+	statbuf->st_mode = S_IFIFO | 0600;
+	statbuf->st_nlink = 1;
+	statbuf->st_blksize = PIPE_SIZE;
+
+	spinlock_acquire(&p->p_lock);
+	statbuf->st_size = p->p_count;
+	spinlock_release(&p->p_lock);
+	return 0;
+}
+
+static
+int
+pipe_poll(struct vnode *v, int events, struct poller *pl, int *revents)
+{
+	struct pipe *p = v->vn_data;
+
+	(void)events;
+
+	if (v == &p->p_readvn) {
+		poller_add(pl, &p->p_rpollq);
+		spinlock_acquire(&p->p_lock);
+		*revents = 0;
+		if (p->p_count > 0) {
+			*revents |= POLLIN;
+		}
+		if (p->p_wclosed) {
+			*revents |= POLLHUP;
+		}
+		spinlock_release(&p->p_lock);
+	}
+	else {
+		KASSERT(v == &p->p_writevn);
+		poller_add(pl, &p->p_wpollq);
+		spinlock_acquire(&p->p_lock);
+		*revents = 0;
+		if (PIPE_SIZE - p->p_count >= PIPE_WAKE) {
+			*revents |= POLLOUT;
+		}
+		if (p->p_rclosed) {
+			*revents |= POLLERR;
+		}
+		spinlock_release(&p->p_lock);
+	}
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+int
+pipe_tryseek(struct vnode *v, off_t pos)
+{
+	(void)v;
+	(void)pos;
+	return ESPIPE;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return EINVAL;
+}
+
+static
+int
+pipe_mmap(struct vnode *v)
+{
+	(void)v;
+	return EUNIMP;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+/*
+ * Operations that are meaningless on pipes, which aren't directories.
+ */
+
+static
+int
+pipe_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
+	   struct vnode **result)
+{
+	(void)v;
+	(void)name;
+	(void)excl;
+	(void)mode;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_symlink(struct vnode *v, const char *contents, const char *name)
+{
+	(void)v;
+	(void)contents;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_mkdir(struct vnode *v, const char *name, mode_t mode)
+{
+	(void)v;
+	(void)name;
+	(void)mode;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_link(struct vnode *v, const char *name, struct vnode *file)
+{
+	(void)v;
+	(void)name;
+	(void)file;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_nameop(struct vnode *v, const char *name)
+{
+	(void)v;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_rename(struct vnode *v, const char *n1, struct vnode *v2, const char *n2)
+{
+	(void)v;
+	(void)n1;
+	(void)v2;
+	(void)n2;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookup(struct vnode *v, char *pathname, struct vnode **result)
+{
+	(void)v;
+	(void)pathname;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookparent(struct vnode *v, char *pathname, struct vnode **result,
+		char *namebuf, size_t buflen)
+{
+	(void)v;
+	(void)pathname;
+	(void)result;
+	(void)namebuf;
+	(void)buflen;
+	return ENOTDIR;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	VOP_MAGIC,
+
+	pipe_open,
+	pipe_close,
+	pipe_reclaim,
+	pipe_read,
+	pipe_badio,     /* readlink */
+	pipe_badio,     /* getdirentry */
+	pipe_write,
+	pipe_ioctl,
+	pipe_stat,
+	pipe_gettype,
+	pipe_tryseek,
+	pipe_fsync,
+	pipe_mmap,
+	pipe_truncate,
+	pipe_badio,     /* namefile */
+	pipe_poll,
+	pipe_creat,
+	pipe_symlink,
+	pipe_mkdir,
+	pipe_link,
+	pipe_nameop,    /* remove */
+	pipe_nameop,    /* rmdir */
+	pipe_rename,
+	pipe_lookup,
+	pipe_lookparent,
+};
+
+////////////////////////////////////////////////////////////
+
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *p;
+	int result;
+
+	p = kmalloc(sizeof(*p));
+	if (p == NULL) {
+		return ENOMEM;
+	}
+	spinlock_init(&p->p_lock);
+	pollq_init(&p->p_rpollq);
+	pollq_init(&p->p_wpollq);
+	p->p_rlock = NULL;
+	p->p_wlock = NULL;
+	p->p_rwchan = NULL;
+	p->p_wwchan = NULL;
+	p->p_buf = kmalloc(PIPE_SIZE);
+	if (p->p_buf == NULL) {
+		goto fail;
+	}
+	p->p_rlock = lock_create("pipe-read");
+	if (p->p_rlock == NULL) {
+		goto fail;
+	}
+	p->p_wlock = lock_create("pipe-write");
+	if (p->p_wlock == NULL) {
+		goto fail;
+	}
+	p->p_rwchan = wchan_create("pipe-read");
+	if (p->p_rwchan == NULL) {
+		goto fail;
+	}
+	p->p_wwchan = wchan_create("pipe-write");
+	if (p->p_wwchan == NULL) {
+		goto fail;
+	}
+	p->p_head = 0;
+	p->p_count = 0;
+	p->p_rwaiting = false;
+	p->p_wwaiting = false;
+	p->p_rclosed = false;
+	p->p_wclosed = false;
+	p->p_vnodes = 2;
+
+	result = VOP_INIT(&p->p_readvn, &pipe_vnode_ops, NULL, p);
+	KASSERT(result == 0);
+	result = VOP_INIT(&p->p_writevn, &pipe_vnode_ops, NULL, p);
+	KASSERT(result == 0);
+
+	/* What vfs_open would have done. */
+	VOP_INCOPEN(&p->p_readvn);
+	VOP_INCOPEN(&p->p_writevn);
+
+	*readvn = &p->p_readvn;
+	*writevn = &p->p_writevn;
+	return 0;
+
+ fail:
+	pipe_destroy(p);
+	return ENOMEM;
+}
@@ -43,6 +43,7 @@
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <rcu.h>
 
 /*
  * Structure for a single named device.
@@ -60,6 +61,13 @@
  * kd_fs      - Filesystem object mounted on, or associated with, this
  *              device. NULL if there is no filesystem. 
  *
+ * kd_volname - Volume name of kd_fs, or NULL.
+ *
+ * kd_root    - Root vnode of kd_fs, NULL if there is no filesystem.
+ *              We hold a reference to it for as long as it's here,
+ *              so readers can hand it out without calling into the
+ *              filesystem.
+ *
  * A filesystem can be associated with a device without having been
  * mounted if the device was created that way. In this case,
  * kd_rawname is NULL (prohibiting mount/unmount), and, as there is
@@ -80,6 +88,8 @@ struct knowndev {
 	struct device *kd_device;
 	struct vnode *kd_vnode;
 	struct fs *kd_fs;
+	const char *kd_volname;
+	struct vnode *kd_root;
 };
 
 DECLARRAY(knowndev);
@@ -87,6 +97,25 @@ DEFARRAY(knowndev, /*no inline*/);
 
 static struct knowndevarray *knowndevs;
 
+/*
+ * Lookups by name (vfs_getroot, vfs_getdevname) happen all the time
+ * and the table hardly ever changes, so they don't use knowndevs or
+ * the big lock. They read knowndevtab, a copy of the whole table
+ * published with RCU (see rcu.h). Changes are made to knowndevs
+ * under the big lock as before, and then a fresh copy is published
+ * with knowndevtab_publish.
+ *
+ * The names, devices, and device vnodes are never freed, so a copy
+ * can share them. A filesystem is taken out of the published copy,
+ * and a grace period allowed to pass, before it's unmounted.
+ */
+struct knowndevtab {
+	unsigned kt_num;
+	struct knowndev kt_devs[];
+};
+
+static struct knowndevtab *knowndevtab;
+
 /* The big lock for all FS ops. Remove for filesystem assignment. */
 static struct lock *vfs_biglock;
 static unsigned vfs_biglock_depth;
@@ -102,8 +131,13 @@ vfs_bootstrap(void)
 	if (knowndevs==NULL) {
 		panic("vfs: Could not create knowndevs array\n");
 	}
+	knowndevtab = kmalloc(sizeof(struct knowndevtab));
+	if (knowndevtab==NULL) {
+		panic("vfs: Could not create knowndevs table\n");
+	}
+	knowndevtab->kt_num = 0;
 
-	vfs_biglock = lock_create("vfs_biglock");
+	vfs_biglock = lock_create_flags("vfs_biglock", LOCK_ADAPTIVE);
 	if (vfs_biglock==NULL) {
 		panic("vfs: Could not create vfs big lock\n");
 	}
@@ -145,6 +179,50 @@ vfs_biglock_do_i_hold(void)
 	return lock_do_i_hold(vfs_biglock);
 }
 
+/*
+ * Allocate a copy of the device table with room for NUM devices, to
+ * be filled in by knowndevtab_publish. This is separate so callers
+ * can get the allocation out of the way before changing anything.
+ */
+static
+struct knowndevtab *
+knowndevtab_create(unsigned num)
+{
+	struct knowndevtab *kt;
+
+	kt = kmalloc(sizeof(struct knowndevtab) +
+		     num * sizeof(struct knowndev));
+	if (kt==NULL) {
+		return NULL;
+	}
+	kt->kt_num = num;
+	return kt;
+}
+
+/*
+ * Copy knowndevs into KT, make it the table readers see, and free the
+ * old one once nobody can still be reading it.
+ */
+static
+void
+knowndevtab_publish(struct knowndevtab *kt)
+{
+	struct knowndevtab *old;
+	unsigned i;
+
+	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(kt->kt_num == knowndevarray_num(knowndevs));
+
+	for (i=0; i<kt->kt_num; i++) {
+		kt->kt_devs[i] = *knowndevarray_get(knowndevs, i);
+	}
+
+	old = knowndevtab;
+	rcu_assign_pointer(knowndevtab, kt);
+	rcu_synchronize();
+	kfree(old);
+}
+
 /*
  * Global sync function - call FSOP_SYNC on all devices.
  */
@@ -172,18 +250,24 @@ vfs_sync(void)
 /*
  * Given a device name (lhd0, emu0, somevolname, null, etc.), hand
  * back an appropriate vnode.
+ *
+ * This doesn't need the big lock; see knowndevtab above. The root
+ * and device vnodes are referenced while the table is held, so they
+ * can't go away before we've taken our own reference.
  */
 int
 vfs_getroot(const char *devname, struct vnode **result)
 {
+	struct knowndevtab *kt;
 	struct knowndev *kd;
-	unsigned i, num;
+	unsigned i;
+	int ret = ENODEV;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	rcu_read_lock();
+	kt = rcu_dereference(knowndevtab);
 
-	num = knowndevarray_num(knowndevs);
-	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
+	for (i=0; i<kt->kt_num; i++) {
+		kd = &kt->kt_devs[i];
 
 		/*
 		 * If this device has a mounted filesystem, and
@@ -195,19 +279,20 @@ vfs_getroot(const char *devname, struct vnode **result)
 		 */
 
 		if (kd->kd_fs!=NULL) {
-			const char *volname;
-			volname = FSOP_GETVOLNAME(kd->kd_fs);
-
 			if (!strcmp(kd->kd_name, devname) ||
-			    (volname!=NULL && !strcmp(volname, devname))) {
-				*result = FSOP_GETROOT(kd->kd_fs);
-				return 0;
+			    (kd->kd_volname!=NULL &&
+			     !strcmp(kd->kd_volname, devname))) {
+				VOP_INCREF(kd->kd_root);
+				*result = kd->kd_root;
+				ret = 0;
+				break;
 			}
 		}
 		else {
 			if (kd->kd_rawname!=NULL &&
 			    !strcmp(kd->kd_name, devname)) {
-				return ENXIO;
+				ret = ENXIO;
+				break;
 			}
 		}
 
@@ -222,7 +307,8 @@ vfs_getroot(const char *devname, struct vnode **result)
 			KASSERT(kd->kd_device != NULL);
 			VOP_INCREF(kd->kd_vnode);
 			*result = kd->kd_vnode;
-			return 0;
+			ret = 0;
+			break;
 		}
 
 		/*
@@ -233,7 +319,8 @@ vfs_getroot(const char *devname, struct vnode **result)
 			KASSERT(kd->kd_device != NULL);
 			VOP_INCREF(kd->kd_vnode);
 			*result = kd->kd_vnode;
-			return 0;
+			ret = 0;
+			break;
 		}
 
 		/*
@@ -243,11 +330,14 @@ vfs_getroot(const char *devname, struct vnode **result)
 		 */
 	}
 
+	rcu_read_unlock();
+
 	/*
-	 * If we got here, the device specified by devname doesn't exist.
+	 * If we got to the end, the device specified by devname
+	 * doesn't exist, and RET is still ENODEV.
 	 */
 
-	return ENODEV;
+	return ret;
 }
 
 /*
@@ -256,29 +346,31 @@ vfs_getroot(const char *devname, struct vnode **result)
 const char *
 vfs_getdevname(struct fs *fs)
 {
-	struct knowndev *kd;
-	unsigned i, num;
+	struct knowndevtab *kt;
+	const char *name = NULL;
+	unsigned i;
 
 	KASSERT(fs != NULL);
 
-	KASSERT(vfs_biglock_do_i_hold());
-
-	num = knowndevarray_num(knowndevs);
-	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
+	rcu_read_lock();
+	kt = rcu_dereference(knowndevtab);
 
-		if (kd->kd_fs == fs) {
+	for (i=0; i<kt->kt_num; i++) {
+		if (kt->kt_devs[i].kd_fs == fs) {
 			/*
 			 * This is not a race condition: as long as the
 			 * guy calling us holds a reference to the fs,
-			 * the fs cannot go away, and the device can't
-			 * go away until the fs goes away.
+			 * the fs cannot go away, and the device (and
+			 * its name) can't go away until the fs goes
+			 * away.
 			 */
-			return kd->kd_name;
+			name = kt->kt_devs[i].kd_name;
+			break;
 		}
 	}
 
-	return NULL;
+	rcu_read_unlock();
+	return name;
 }
 
 /*
@@ -373,6 +465,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 {
 	char *name=NULL, *rawname=NULL;
 	struct knowndev *kd=NULL;
+	struct knowndevtab *kt=NULL;
 	struct vnode *vnode=NULL;
 	const char *volname=NULL;
 	unsigned index;
@@ -406,6 +499,8 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 	kd->kd_device = dev;
 	kd->kd_vnode = vnode;
 	kd->kd_fs = fs;
+	kd->kd_volname = NULL;
+	kd->kd_root = NULL;
 
 	if (fs!=NULL) {
 		volname = FSOP_GETVOLNAME(fs);
@@ -416,15 +511,32 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		return EEXIST;
 	}
 
+	kt = knowndevtab_create(knowndevarray_num(knowndevs) + 1);
+	if (kt==NULL) {
+		goto nomem;
+	}
+
 	result = knowndevarray_add(knowndevs, kd, &index);
+	if (result) {
+		kfree(kt);
+		vfs_biglock_release();
+		return result;
+	}
 
-	if (result == 0 && dev != NULL) {
+	if (dev != NULL) {
 		/* use index+1 as the device number, so 0 is reserved */
 		dev->d_devnumber = index+1;
 	}
 
+	if (fs != NULL) {
+		kd->kd_volname = volname;
+		kd->kd_root = FSOP_GETROOT(fs);
+	}
+
+	knowndevtab_publish(kt);
+
 	vfs_biglock_release();
-	return result;
+	return 0;
 
  nomem:
 
@@ -511,6 +623,7 @@ vfs_mount(const char *devname, void *data,
 {
 	const char *volname;
 	struct knowndev *kd;
+	struct knowndevtab *kt;
 	struct fs *fs;
 	int result;
 
@@ -529,17 +642,29 @@ vfs_mount(const char *devname, void *data,
 	KASSERT(kd->kd_rawname != NULL);
 	KASSERT(kd->kd_device != NULL);
 
+	/* Get this now so we can't fail after mounting. */
+	kt = knowndevtab_create(knowndevarray_num(knowndevs));
+	if (kt == NULL) {
+		vfs_biglock_release();
+		return ENOMEM;
+	}
+
 	result = mountfunc(data, kd->kd_device, &fs);
 	if (result) {
+		kfree(kt);
 		vfs_biglock_release();
 		return result;
 	}
 
 	KASSERT(fs != NULL);
 
+	volname = FSOP_GETVOLNAME(fs);
+
 	kd->kd_fs = fs;
+	kd->kd_volname = volname;
+	kd->kd_root = FSOP_GETROOT(fs);
+	knowndevtab_publish(kt);
 
-	volname = FSOP_GETVOLNAME(fs);
 	kprintf("vfs: Mounted %s: on %s\n",
 		volname ? volname : kd->kd_name, kd->kd_name);
 
@@ -547,6 +672,58 @@ vfs_mount(const char *devname, void *data,
 	return 0;
 }
 
+/*
+ * Unmount the filesystem on KD, which has been synced. First take it
+ * out of the table readers see and let go of its root, so nobody can
+ * start using it while we're unmounting it; if the unmount fails,
+ * put it back.
+ */
+static
+int
+knowndev_unmount(struct knowndev *kd)
+{
+	struct knowndevtab *hide, *restore;
+	struct fs *fs;
+	struct vnode *root;
+	const char *volname;
+	unsigned num;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(kd->kd_fs != NULL);
+
+	num = knowndevarray_num(knowndevs);
+	hide = knowndevtab_create(num);
+	restore = knowndevtab_create(num);
+	if (hide == NULL || restore == NULL) {
+		kfree(hide);
+		kfree(restore);
+		return ENOMEM;
+	}
+
+	fs = kd->kd_fs;
+	volname = kd->kd_volname;
+	root = kd->kd_root;
+
+	kd->kd_fs = NULL;
+	kd->kd_volname = NULL;
+	kd->kd_root = NULL;
+	knowndevtab_publish(hide);
+	VOP_DECREF(root);
+
+	result = FSOP_UNMOUNT(fs);
+	if (result) {
+		kd->kd_fs = fs;
+		kd->kd_volname = volname;
+		kd->kd_root = FSOP_GETROOT(fs);
+		knowndevtab_publish(restore);
+		return result;
+	}
+
+	kfree(restore);
+	return 0;
+}
+
 /*
  * Unmount a filesystem/device by name.
  * First calls FSOP_SYNC on the filesystem; then calls FSOP_UNMOUNT.
@@ -576,16 +753,14 @@ vfs_unmount(const char *devname)
 		goto fail;
 	}
 
-	result = FSOP_UNMOUNT(kd->kd_fs);
+	/* this drops the filesystem */
+	result = knowndev_unmount(kd);
 	if (result) {
 		goto fail;
 	}
 
 	kprintf("vfs: Unmounted %s:\n", kd->kd_name);
 
-	/* now drop the filesystem */
-	kd->kd_fs = NULL;
-
 	KASSERT(result==0);
 
  fail:
@@ -633,7 +808,8 @@ vfs_unmountall(void)
 			}
 		}
 
-		result = FSOP_UNMOUNT(dev->kd_fs);
+		/* this drops the filesystem */
+		result = knowndev_unmount(dev);
 		if (result == EBUSY) {
 			kprintf("vfs: Cannot unmount %s: (busy)\n", 
 				dev->kd_name);
@@ -645,9 +821,6 @@ vfs_unmountall(void)
 				dev->kd_name, strerror(result));
 			continue;
 		}
-
-		/* now drop the filesystem */
-		dev->kd_fs = NULL;
 	}
 
 	vfs_biglock_release();
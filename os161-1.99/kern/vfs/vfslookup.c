@@ -39,7 +39,12 @@
 #include <vfs.h>
 #include <fs.h>
 #include <vnode.h>
+#include <rcu.h>
 
+/*
+ * Read with RCU (see rcu.h) so lookups needn't take the big lock;
+ * changed under the big lock.
+ */
 static struct vnode *bootfs_vnode = NULL;
 
 /*
@@ -51,8 +56,13 @@ change_bootfs(struct vnode *newvn)
 {
 	struct vnode *oldvn;
 
+	KASSERT(vfs_biglock_do_i_hold());
+
 	oldvn = bootfs_vnode;
-	bootfs_vnode = newvn;
+	rcu_assign_pointer(bootfs_vnode, newvn);
+
+	/* Someone may still be about to take a reference to it. */
+	rcu_synchronize();
 
 	if (oldvn != NULL) {
 		VOP_DECREF(oldvn);
@@ -123,6 +133,9 @@ vfs_clearbootfs(void)
 /*
  * Common code to pull the device name, if any, off the front of a
  * path and choose the vnode to begin the name lookup relative to.
+ *
+ * This doesn't need the big lock: the device table and bootfs_vnode
+ * are read with RCU, and the filesystems lock for themselves.
  */
 
 static
@@ -133,8 +146,6 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	struct vnode *vn;
 	int result;
 
-	KASSERT(vfs_biglock_do_i_hold());
-
 	/*
 	 * Locate the first colon or slash.
 	 */
@@ -188,11 +199,16 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	KASSERT(colon==0 || slash==0);
 
 	if (path[0]=='/') {
-		if (bootfs_vnode==NULL) {
+		rcu_read_lock();
+		vn = rcu_dereference(bootfs_vnode);
+		if (vn!=NULL) {
+			VOP_INCREF(vn);
+		}
+		rcu_read_unlock();
+		if (vn==NULL) {
 			return ENOENT;
 		}
-		VOP_INCREF(bootfs_vnode);
-		*startvn = bootfs_vnode;
+		*startvn = vn;
 	}
 	else {
 		KASSERT(path[0]==':');
@@ -235,11 +251,8 @@ vfs_lookparent(char *path, struct vnode **retval,
 	struct vnode *startvn;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
@@ -257,7 +270,6 @@ vfs_lookparent(char *path, struct vnode **retval,
 
 	VOP_DECREF(startvn);
 
-	vfs_biglock_release();
 	return result;
 }
 
@@ -267,23 +279,18 @@ vfs_lookup(char *path, struct vnode **retval)
 	struct vnode *startvn;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (strlen(path)==0) {
 		*retval = startvn;
-		vfs_biglock_release();
 		return 0;
 	}
 
 	result = VOP_LOOKUP(startvn, path, retval);
 
 	VOP_DECREF(startvn);
-	vfs_biglock_release();
 	return result;
 }
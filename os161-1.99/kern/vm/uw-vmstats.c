@@ -8,6 +8,12 @@
  * (i.e., outside of these routines) by acquiring stats_lock.
  * All of the functions whose names do not begin
  * with '_' ensure atomicity locally.
+ *
+ * The counts themselves are per-cpu counters (see cpucounter.h), so
+ * counting needs no lock at all; stats_lock only serializes setting
+ * them up and resetting them. Until vmstats_init sets them up, counts
+ * go in the plain array stats_early under stats_lock instead, so the
+ * VM can count (and vmstats_print can be called) before then.
  */
 
 #include <types.h>
@@ -15,9 +21,14 @@
 #include <synch.h>
 #include <spl.h>
 #include <uw-vmstats.h>
+#include <cpucounter.h>
 
-/* Counters for tracking statistics */
-static unsigned int stats_counts[VMSTAT_COUNT];
+/* Index of the first of our per-cpu counters, once we have them */
+static unsigned int stats_base;
+static volatile bool stats_allocated = false;
+
+/* Counts from before the per-cpu counters exist */
+static unsigned int stats_early[VMSTAT_COUNT];
 
 struct spinlock stats_lock = SPINLOCK_INITIALIZER;
 
@@ -37,13 +48,18 @@ static const char *stats_names[] = {
 
 
 /* ---------------------------------------------------------------------- */
-/* Assumes vmstat_init has already been called */
 void
 vmstats_inc(unsigned int index)
 {
+  if (stats_allocated) {
+    /* Per-cpu counter; no lock needed */
+    _vmstats_inc(index);
+  }
+  else {
     spinlock_acquire(&stats_lock);
       _vmstats_inc(index);
     spinlock_release(&stats_lock);
+  }
 }
 
 /* ---------------------------------------------------------------------- */
@@ -65,7 +81,12 @@ void
 _vmstats_inc(unsigned int index)
 {
   KASSERT(index < VMSTAT_COUNT);
-  stats_counts[index]++;
+  if (stats_allocated) {
+    cpucounter_inc(stats_base + index);
+  }
+  else {
+    stats_early[index]++;
+  }
 }
 
 /* ---------------------------------------------------------------------- */
@@ -80,14 +101,20 @@ _vmstats_init(void)
     panic("Should really fix this before proceeding\n");
   }
 
+  if (!stats_allocated) {
+    stats_base = cpucounter_alloc(VMSTAT_COUNT);
+  }
+
   for (i=0; i<VMSTAT_COUNT; i++) {
-    stats_counts[i] = 0;
+    cpucounter_zero(stats_base + i);
+    stats_early[i] = 0;
   }
+  /* Only now, so nobody counts in a counter that isn't zeroed yet */
+  stats_allocated = true;
 
 }
 
 /* ---------------------------------------------------------------------- */
-/* Assumes vmstat_init has already been called */
 /* NOTE: We do not grab the spinlock here because kprintf may block
  * and we can't block while holding a spinlock.
  * Just use this when there is only one thread remaining.
@@ -102,6 +129,15 @@ vmstats_print(void)
   int tlb_faults = 0;
   int elf_plus_swap_reads = 0;
   int disk_reads = 0;
+  unsigned int stats_counts[VMSTAT_COUNT];
+
+  /* Add up the per-cpu counts once, so everything below agrees */
+  for (i=0; i<VMSTAT_COUNT; i++) {
+    stats_counts[i] = stats_early[i];
+    if (stats_allocated) {
+      stats_counts[i] += cpucounter_sum(stats_base + i);
+    }
+  }
 
   kprintf("VMSTATS:\n");
   for (i=0; i<VMSTAT_COUNT; i++) {
@@ -69,6 +69,9 @@ static int timing = 0;
 #define MAXBG 128
 static pid_t bgpids[MAXBG];
 
+/* most commands in one pipeline */
+#define MAXPIPE 16
+
 /*
  * can_bg
  * just checks for an open slot.
@@ -292,12 +295,120 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * dopipeline
+ * runs "a | b | ..." in the foreground. ARGS is the whole command line;
+ * each "|" becomes the end of one command's argv, and a pipe connects
+ * that command's standard output to the next one's standard input.
+ * waits for all of them and returns the status of the last, as usual.
+ */
+static
+int
+dopipeline(char **args, int nargs)
+{
+	char **cmds[MAXPIPE];
+	pid_t pids[MAXPIPE];
+	int ncmds, nstarted, i;
+	int infd, fds[2];
+	int status;
+
+	ncmds = 0;
+	cmds[ncmds++] = args;
+	for (i=0; i<nargs; i++) {
+		if (strcmp(args[i], "|")) {
+			continue;
+		}
+		if (ncmds >= MAXPIPE) {
+			printf("Too many commands in pipeline\n");
+			return 1;
+		}
+		args[i] = NULL;
+		cmds[ncmds++] = &args[i+1];
+	}
+	for (i=0; i<ncmds; i++) {
+		if (cmds[i][0] == NULL) {
+			printf("Invalid null command\n");
+			return 1;
+		}
+	}
+
+	/* infd is the read end of the pipe from the previous command */
+	infd = -1;
+	for (nstarted=0; nstarted<ncmds; nstarted++) {
+		fds[0] = fds[1] = -1;
+		if (nstarted < ncmds-1 && pipe(fds) < 0) {
+			warn("pipe");
+			break;
+		}
+
+		/*
+		 * As in docommand, the child borrows our address space
+		 * until it execs; dup2 and close only change its own
+		 * descriptors, so they're fine to do in the meantime.
+		 */
+		pids[nstarted] = vfork();
+		if (pids[nstarted] < 0) {
+			warn("vfork");
+			if (fds[0] >= 0) {
+				close(fds[0]);
+				close(fds[1]);
+			}
+			break;
+		}
+		if (pids[nstarted] == 0) {
+			/* child */
+			if (infd >= 0) {
+				dup2(infd, STDIN_FILENO);
+				close(infd);
+			}
+			if (fds[1] >= 0) {
+				dup2(fds[1], STDOUT_FILENO);
+				close(fds[1]);
+				close(fds[0]);
+			}
+			execv(cmds[nstarted][0], cmds[nstarted]);
+			warn("%s", cmds[nstarted][0]);
+			_exit(1);
+		}
+
+		/* parent: the child has its own copies now */
+		if (infd >= 0) {
+			close(infd);
+		}
+		if (fds[1] >= 0) {
+			close(fds[1]);
+		}
+		infd = fds[0];
+	}
+
+	/*
+	 * If we stopped early, closing this lets the last command we
+	 * did start see end of file or EPIPE instead of hanging.
+	 */
+	if (infd >= 0) {
+		close(infd);
+	}
+
+	status = _MKWAIT_EXIT(255);
+	for (i=0; i<nstarted; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			warn("waitpid");
+			status = -1;
+		}
+	}
+	if (nstarted < ncmds) {
+		return _MKWAIT_EXIT(255);
+	}
+	return status;
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
  * simply returns.  checks to see if it's a builtin, running it if it is.
  * otherwise, it's a standard command.  check for the '&', try to background
- * the job if possible, otherwise just run it and wait on it.
+ * the job if possible, otherwise just run it and wait on it.  a command
+ * line with "|" in it is a pipeline, which dopipeline handles.
  */
 static
 int
@@ -329,6 +440,12 @@ docommand(char *buf)
 		return 0;
 	}
 
+	for (i=0; i<nargs; i++) {
+		if (!strcmp(args[i], "|")) {
+			return dopipeline(args, nargs);
+		}
+	}
+
 	for (i=0; builtins[i].name; i++) {
 		if (!strcmp(builtins[i].name, args[0])) {
 			return builtins[i].func(nargs, args);
@@ -354,11 +471,17 @@ docommand(char *buf)
 		__time(&startsecs, &startnsecs);
 	}
 
-	pid = fork();
+	/*
+	 * The child only execs, so it can borrow our address space
+	 * instead of copying it. It must not return from here or
+	 * touch anything of ours but its own arguments before execv
+	 * or _exit (which is when we get to continue).
+	 */
+	pid = vfork();
 	switch (pid) {
 		case -1:
 			/* error */
-			warn("fork");
+			warn("vfork");
 			return _MKWAIT_EXIT(255);
 		case 0:
 			/* child */
@@ -0,0 +1,24 @@
+#ifndef _ARING_H_
+#define _ARING_H_
+
+/*
+ * Get the syscall ring structures and ARING_* constants from the
+ * kernel. See kern/aring.h for how the ring is used.
+ */
+#include <sys/types.h>
+#include <kern/aring.h>
+
+/*
+ * aring_setup registers RING, with SQ and CQ of ENTRIES each (a power
+ * of two, at most ARING_MAXENTRIES), replacing any ring registered
+ * before; RING must be zeroed first. A NULL RING just unregisters.
+ * Registration isn't passed on by fork and ends at execv.
+ *
+ * aring_enter runs up to TOSUBMIT queued entries and returns how
+ * many it ran; the completions are in the ring when it returns.
+ */
+int aring_setup(struct aring *ring, struct aring_sqe *sq,
+		struct aring_cqe *cq, unsigned entries);
+int aring_enter(unsigned tosubmit);
+
+#endif /* _ARING_H_ */
@@ -0,0 +1,20 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Get struct pollfd and the POLL* bits from the kernel.
+ */
+#include <sys/types.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+
+/*
+ * poll waits until at least one of the NFDS descriptors in FDS is
+ * ready for what its events field asks for, or TIMEOUT milliseconds
+ * go by (forever if TIMEOUT is negative; not at all if it's 0). It
+ * fills in each revents and returns how many are nonzero. NFDS may be
+ * at most OPEN_MAX.
+ */
+int poll(struct pollfd *fds, unsigned nfds, int timeout);
+
+#endif /* _POLL_H_ */
@@ -0,0 +1,23 @@
+#ifndef _SYS_RESOURCE_H_
+#define _SYS_RESOURCE_H_
+
+/*
+ * Get struct rusage and the RUSAGE_* codes from the kernel.
+ */
+#include <sys/types.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+
+/*
+ * getrusage reports the cpu time used by the calling process
+ * (RUSAGE_SELF) or by its children that have been waited for
+ * (RUSAGE_CHILDREN). Only ru_utime, ru_stime, ru_nvcsw and ru_nivcsw
+ * are filled in; the rest are zero.
+ *
+ * wait4 is waitpid that also reports the usage of the child waited
+ * for. USAGE may be NULL.
+ */
+int getrusage(int who, struct rusage *usage);
+pid_t wait4(pid_t pid, int *status, int options, struct rusage *usage);
+
+#endif /* _SYS_RESOURCE_H_ */
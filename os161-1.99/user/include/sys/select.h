@@ -0,0 +1,23 @@
+#ifndef _SYS_SELECT_H_
+#define _SYS_SELECT_H_
+
+/*
+ * Get fd_set, the FD_* macros and struct timeval from the kernel.
+ */
+#include <sys/types.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <kern/time.h>
+
+/*
+ * select waits until one of the descriptors below NFDS in READFDS is
+ * readable, or one in WRITEFDS is writable, or TIMEOUT runs out
+ * (forever if it's NULL). Any of the sets may be NULL. It leaves only
+ * the ready descriptors in the sets and returns how many there are.
+ * Descriptors in EXCEPTFDS are never ready; nothing has exceptional
+ * conditions.
+ */
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+	   struct timeval *timeout);
+
+#endif /* _SYS_SELECT_H_ */
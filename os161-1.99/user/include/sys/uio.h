@@ -0,0 +1,18 @@
+#ifndef _SYS_UIO_H_
+#define _SYS_UIO_H_
+
+/*
+ * Get struct iovec from the kernel.
+ */
+#include <sys/types.h>
+#include <kern/iovec.h>
+
+/*
+ * readv and writev are read and write with the data scattered over
+ * (or gathered from) IOVCNT buffers. The whole vector is done as one
+ * request. IOVCNT must be between 1 and IOV_MAX.
+ */
+ssize_t readv(int filehandle, const struct iovec *iov, int iovcnt);
+ssize_t writev(int filehandle, const struct iovec *iov, int iovcnt);
+
+#endif /* _SYS_UIO_H_ */
@@ -157,6 +157,19 @@ int __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
+/* Local additions. */
+int setaffinity(unsigned cpumask);		/* bit N allows cpu N */
+/* sleep if *addr == val, up to TIMEOUT ms (no limit if negative) */
+int futex_wait(volatile int *addr, int val, int timeout);
+int futex_wake(volatile int *addr, int n);	/* returns number woken */
+pid_t vfork(void);				/* until child execs/exits */
+/* read/write at POS, leaving the seek position alone */
+ssize_t pread(int filehandle, void *buf, size_t size, off_t pos);
+ssize_t pwrite(int filehandle, const void *buf, size_t size, off_t pos);
+/* readv, writev - see sys/uio.h */
+/* select - see sys/select.h; poll - see poll.h */
+/* aring_setup, aring_enter - see aring.h */
+
 /*
  * These are not themselves system calls, but wrapper routines in libc.
  */
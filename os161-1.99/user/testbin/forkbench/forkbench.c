@@ -0,0 +1,65 @@
+/*
+ * forkbench - time fork/exit/wait.
+ *
+ * Usage: forkbench [count]
+ *
+ * Forks COUNT children (default 1000) one at a time; each child exits
+ * right away and the parent waits for it before forking the next.
+ * Prints the average time per round trip. The kernel's own breakdown
+ * (time spent copying in the parent, and how long the child took to
+ * start running) is printed by the "fk" menu command.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <err.h>
+
+#define DEFAULT_COUNT 1000
+
+int
+main(int argc, char *argv[])
+{
+	unsigned count, i;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	unsigned long long total;
+	pid_t pid;
+	int status;
+
+	count = DEFAULT_COUNT;
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+	if (count == 0) {
+		errx(1, "Usage: forkbench [count]");
+	}
+
+	__time(&s0, &ns0);
+	for (i=0; i<count; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "pid %d: bad exit status %d", pid, status);
+		}
+	}
+	__time(&s1, &ns1);
+
+	total = (s1 - s0) * 1000000000ULL + ns1 - ns0;
+	printf("forkbench: %u forks in %lu.%09lu seconds\n", count,
+	       (unsigned long)(total / 1000000000ULL),
+	       (unsigned long)(total % 1000000000ULL));
+	printf("forkbench: %lu ns per fork/exit/wait\n",
+	       (unsigned long)(total / count));
+	return 0;
+}
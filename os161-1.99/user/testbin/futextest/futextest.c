@@ -0,0 +1,138 @@
+/*
+ * futextest - check futex_wait and futex_wake.
+ *
+ * Usage: futextest
+ *
+ * There's only one thread per process, so nobody else can wake us;
+ * what can be checked is that futex_wait never sleeps when it
+ * shouldn't, and gives up on time when asked to:
+ *   - futex_wait fails with EAGAIN when the word no longer holds the
+ *     value passed in;
+ *   - a wake that comes before the wait, the usual store-then-wake
+ *     protocol, keeps the wait from sleeping, since the value has
+ *     changed; a wake with nobody asleep isn't remembered, though,
+ *     and wakes nobody;
+ *   - a wait with a timeout returns ETIMEDOUT, no sooner than asked
+ *     and not much later, and a timeout of 0 returns at once;
+ *   - a misaligned word is EINVAL.
+ *
+ * Every wait is given a timeout, so a bug shows up as a failure
+ * rather than a hang. Stops at the first thing that's wrong; prints
+ * "passed" otherwise.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+#define SHORTWAIT	100	/* ms: long enough to notice a sleep */
+#define TIMEOUT		500	/* ms, for the timing test */
+#define SLACK		500	/* ms we may oversleep by */
+
+/* two, so the misaligned address used below is still ours */
+static volatile int words[2];
+
+static
+unsigned long
+now_ms(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000 + nsecs / 1000000;
+}
+
+/*
+ * futex_wait should fail with EXPECTED; ELAPSED gets how long it took,
+ * in ms.
+ */
+static
+void
+waitfails(const char *what, volatile int *addr, int val, int timeout,
+	  int expected, unsigned long *elapsed)
+{
+	unsigned long start;
+	int r;
+
+	start = now_ms();
+	r = futex_wait(addr, val, timeout);
+	if (elapsed != NULL) {
+		*elapsed = now_ms() - start;
+	}
+	if (r == 0) {
+		errx(1, "%s: futex_wait returned 0, expected %s", what,
+		     strerror(expected));
+	}
+	if (errno != expected) {
+		err(1, "%s: expected %s, got", what, strerror(expected));
+	}
+}
+
+static
+void
+wakes(const char *what, volatile int *addr, int expected)
+{
+	int r;
+
+	r = futex_wake(addr, 1);
+	if (r < 0) {
+		err(1, "%s: futex_wake", what);
+	}
+	if (r != expected) {
+		errx(1, "%s: futex_wake woke %d, expected %d", what, r,
+		     expected);
+	}
+}
+
+int
+main(void)
+{
+	volatile int *word = &words[0];
+	unsigned long elapsed;
+
+	/* Mismatch: no sleeping at all */
+	*word = 5;
+	waitfails("value mismatch", word, 4, SHORTWAIT, EAGAIN, &elapsed);
+	if (elapsed >= SHORTWAIT) {
+		errx(1, "value mismatch: futex_wait slept %lu ms", elapsed);
+	}
+
+	/* Wake before wait: the waker stores, then wakes; nobody's asleep */
+	*word = 6;
+	wakes("wake before wait", word, 0);
+	waitfails("wake before wait", word, 5, SHORTWAIT, EAGAIN, NULL);
+
+	/* ...and that wake isn't saved up for the next waiter */
+	waitfails("stale wake", word, 6, SHORTWAIT, ETIMEDOUT, NULL);
+
+	/* Timeouts */
+	waitfails("timeout", word, 6, TIMEOUT, ETIMEDOUT, &elapsed);
+	printf("futextest: %d ms timeout took %lu ms\n", TIMEOUT, elapsed);
+	if (elapsed < TIMEOUT - 10) {
+		errx(1, "timeout: returned early");
+	}
+	if (elapsed > TIMEOUT + SLACK) {
+		errx(1, "timeout: returned late");
+	}
+	waitfails("zero timeout", word, 6, 0, ETIMEDOUT, &elapsed);
+	if (elapsed >= SHORTWAIT) {
+		errx(1, "zero timeout: futex_wait slept %lu ms", elapsed);
+	}
+
+	/* A timed-out wait mustn't leave anything behind to wake */
+	wakes("after timeouts", word, 0);
+
+	/* Misaligned */
+	waitfails("misaligned", (volatile int *)((char *)word + 1), 0,
+		  SHORTWAIT, EINVAL, NULL);
+	if (futex_wake((volatile int *)((char *)word + 1), 1) >= 0 ||
+	    errno != EINVAL) {
+		errx(1, "misaligned: futex_wake didn't fail with EINVAL");
+	}
+
+	printf("futextest: passed\n");
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * pipebench - pipe throughput.
+ *
+ * Usage: pipebench [megabytes [blocksize]]
+ *
+ * Forks a child that writes MEGABYTES (default 16) down a pipe in
+ * BLOCKSIZE chunks (default 4096), while the parent reads it all back.
+ * Prints the throughput in MB/s and how many context switches the two
+ * processes did per MB, which shows how well the kernel batches its
+ * wakeups.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <err.h>
+
+#define DEFAULT_MB	16
+#define DEFAULT_BLOCK	4096
+#define MAX_BLOCK	65536
+#define MB		(1024*1024)
+
+static char buf[MAX_BLOCK];
+
+static
+void
+writer(int fd, unsigned long long total, size_t block)
+{
+	size_t len;
+	ssize_t r;
+
+	while (total > 0) {
+		len = total < block ? total : block;
+		r = write(fd, buf, len);
+		if (r < 0) {
+			err(1, "write");
+		}
+		total -= r;
+	}
+}
+
+static
+unsigned long long
+reader(int fd, size_t block)
+{
+	unsigned long long total = 0;
+	ssize_t r;
+
+	while ((r = read(fd, buf, block)) != 0) {
+		if (r < 0) {
+			err(1, "read");
+		}
+		total += r;
+	}
+	return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned mb;
+	size_t block;
+	int fds[2];
+	pid_t pid;
+	int status;
+	struct rusage self0, self1, child;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	unsigned long long nsecs, bytes, rate;
+	unsigned long csw;
+
+	mb = DEFAULT_MB;
+	block = DEFAULT_BLOCK;
+	if (argc > 1) {
+		mb = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		block = atoi(argv[2]);
+	}
+	if (argc > 3 || mb == 0 || block == 0 || block > MAX_BLOCK) {
+		errx(1, "Usage: pipebench [megabytes [blocksize]]");
+	}
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+
+	getrusage(RUSAGE_SELF, &self0);
+	__time(&s0, &ns0);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		writer(fds[1], (unsigned long long)mb * MB, block);
+		_exit(0);
+	}
+	close(fds[1]);
+	bytes = reader(fds[0], block);
+	close(fds[0]);
+	if (wait4(pid, &status, 0, &child) < 0) {
+		err(1, "wait4");
+	}
+
+	__time(&s1, &ns1);
+	getrusage(RUSAGE_SELF, &self1);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "writer: bad exit status %d", status);
+	}
+	if (bytes != (unsigned long long)mb * MB) {
+		errx(1, "read %lu bytes, expected %lu", (unsigned long)bytes,
+		     (unsigned long)mb * MB);
+	}
+
+	nsecs = (s1 - s0) * 1000000000ULL + ns1 - ns0;
+	csw = (self1.ru_nvcsw - self0.ru_nvcsw) +
+		(self1.ru_nivcsw - self0.ru_nivcsw) +
+		child.ru_nvcsw + child.ru_nivcsw;
+
+	/* thousandths of a MB per second */
+	rate = 0;
+	if (nsecs > 0) {
+		rate = (unsigned long long)mb * 1000000000000ULL / nsecs;
+	}
+
+	printf("pipebench: %u MB in %lu.%09lu seconds, %lu-byte blocks\n",
+	       mb, (unsigned long)(nsecs / 1000000000ULL),
+	       (unsigned long)(nsecs % 1000000000ULL), (unsigned long)block);
+	printf("pipebench: %lu.%03lu MB/s\n",
+	       (unsigned long)(rate / 1000), (unsigned long)(rate % 1000));
+	printf("pipebench: %lu context switches, %lu per MB\n",
+	       csw, csw / mb);
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * pollbench - poll/select over many pipes.
+ *
+ * Usage: pollbench [-s] [messages]
+ *
+ * Sets up 64 pipes and forks 4 writers, each of which owns 16 of them
+ * and sends MESSAGES (default 1000) small messages, one pipe at a
+ * time in rotation. The parent reads them all back with one poll()
+ * (or, with -s, select()) loop over the 64 read ends, the way a server
+ * would. Prints the message rate, how many descriptors were ready per
+ * call on average, and context switches per 1000 messages.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <err.h>
+
+#define NWRITERS	4
+#define PIPESPER	16
+#define NPIPES		(NWRITERS * PIPESPER)
+#define MSGSIZE		32
+#define DEFAULT_MSGS	1000
+
+static int readfds[NPIPES];
+static pid_t pids[NWRITERS];
+
+static
+void
+writer(int *fds, unsigned msgs)
+{
+	char msg[MSGSIZE];
+	unsigned i;
+	ssize_t r;
+
+	memset(msg, 'x', sizeof(msg));
+	for (i=0; i<msgs; i++) {
+		r = write(fds[i % PIPESPER], msg, sizeof(msg));
+		if (r != (ssize_t)sizeof(msg)) {
+			err(1, "write");
+		}
+	}
+}
+
+/*
+ * Start writer W, with its own PIPESPER pipes. The read ends go in
+ * readfds; the child closes every read end it has inherited.
+ */
+static
+void
+startwriter(unsigned w, unsigned msgs)
+{
+	int writefds[PIPESPER];
+	int fds[2];
+	unsigned i;
+
+	for (i=0; i<PIPESPER; i++) {
+		if (pipe(fds) < 0) {
+			err(1, "pipe");
+		}
+		readfds[w * PIPESPER + i] = fds[0];
+		writefds[i] = fds[1];
+	}
+
+	pids[w] = fork();
+	if (pids[w] < 0) {
+		err(1, "fork");
+	}
+	if (pids[w] == 0) {
+		for (i=0; i<(w + 1) * PIPESPER; i++) {
+			close(readfds[i]);
+		}
+		writer(writefds, msgs);
+		_exit(0);
+	}
+	for (i=0; i<PIPESPER; i++) {
+		close(writefds[i]);
+	}
+}
+
+/*
+ * Read whatever is in FD. Returns 0 at end of file.
+ */
+static
+int
+drain(int fd, unsigned long *bytes)
+{
+	char buf[PIPESPER * MSGSIZE];
+	int r;
+
+	r = read(fd, buf, sizeof(buf));
+	if (r < 0) {
+		err(1, "read");
+	}
+	*bytes += r;
+	return r;
+}
+
+static
+void
+pollloop(unsigned long *bytes, unsigned long *calls, unsigned long *ready)
+{
+	struct pollfd pfds[NPIPES];
+	unsigned nopen, i;
+	int n;
+
+	for (i=0; i<NPIPES; i++) {
+		pfds[i].fd = readfds[i];
+		pfds[i].events = POLLIN;
+	}
+	nopen = NPIPES;
+	while (nopen > 0) {
+		n = poll(pfds, NPIPES, -1);
+		if (n < 0) {
+			err(1, "poll");
+		}
+		(*calls)++;
+		*ready += n;
+		for (i=0; i<NPIPES; i++) {
+			if (pfds[i].fd < 0 || pfds[i].revents == 0) {
+				continue;
+			}
+			if (drain(pfds[i].fd, bytes) == 0) {
+				close(pfds[i].fd);
+				pfds[i].fd = -1;
+				nopen--;
+			}
+		}
+	}
+}
+
+static
+void
+selectloop(unsigned long *bytes, unsigned long *calls, unsigned long *ready)
+{
+	fd_set want, set;
+	unsigned nopen, i;
+	int n, maxfd;
+
+	FD_ZERO(&want);
+	maxfd = 0;
+	for (i=0; i<NPIPES; i++) {
+		FD_SET(readfds[i], &want);
+		if (readfds[i] > maxfd) {
+			maxfd = readfds[i];
+		}
+	}
+	nopen = NPIPES;
+	while (nopen > 0) {
+		set = want;
+		n = select(maxfd + 1, &set, NULL, NULL, NULL);
+		if (n < 0) {
+			err(1, "select");
+		}
+		(*calls)++;
+		*ready += n;
+		for (i=0; i<NPIPES; i++) {
+			if (readfds[i] < 0 || !FD_ISSET(readfds[i], &set)) {
+				continue;
+			}
+			if (drain(readfds[i], bytes) == 0) {
+				FD_CLR(readfds[i], &want);
+				close(readfds[i]);
+				readfds[i] = -1;
+				nopen--;
+			}
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned msgs, w;
+	int useselect = 0;
+	int status;
+	struct rusage self0, self1, child;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	unsigned long long nsecs, rate;
+	unsigned long bytes = 0, calls = 0, ready = 0, csw, total;
+
+	msgs = DEFAULT_MSGS;
+	if (argc > 1 && !strcmp(argv[1], "-s")) {
+		useselect = 1;
+		argc--;
+		argv++;
+	}
+	if (argc > 1) {
+		msgs = atoi(argv[1]);
+	}
+	if (argc > 2 || msgs == 0) {
+		errx(1, "Usage: pollbench [-s] [messages]");
+	}
+
+	getrusage(RUSAGE_SELF, &self0);
+	__time(&s0, &ns0);
+
+	for (w=0; w<NWRITERS; w++) {
+		startwriter(w, msgs);
+	}
+	if (useselect) {
+		selectloop(&bytes, &calls, &ready);
+	}
+	else {
+		pollloop(&bytes, &calls, &ready);
+	}
+
+	csw = 0;
+	for (w=0; w<NWRITERS; w++) {
+		if (wait4(pids[w], &status, 0, &child) < 0) {
+			err(1, "wait4");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "writer %u: bad exit status %d", w, status);
+		}
+		csw += child.ru_nvcsw + child.ru_nivcsw;
+	}
+
+	__time(&s1, &ns1);
+	getrusage(RUSAGE_SELF, &self1);
+
+	total = (unsigned long)msgs * NWRITERS;
+	if (bytes != total * MSGSIZE) {
+		errx(1, "read %lu bytes, expected %lu", bytes,
+		     total * MSGSIZE);
+	}
+
+	nsecs = (s1 - s0) * 1000000000ULL + ns1 - ns0;
+	csw += (self1.ru_nvcsw - self0.ru_nvcsw) +
+		(self1.ru_nivcsw - self0.ru_nivcsw);
+	rate = 0;
+	if (nsecs > 0) {
+		rate = total * 1000000000ULL / nsecs;
+	}
+
+	printf("pollbench: %lu messages over %d pipes with %s "
+	       "in %lu.%09lu seconds\n", total, NPIPES,
+	       useselect ? "select" : "poll",
+	       (unsigned long)(nsecs / 1000000000ULL),
+	       (unsigned long)(nsecs % 1000000000ULL));
+	printf("pollbench: %lu messages/s\n", (unsigned long)rate);
+	printf("pollbench: %lu calls, %lu.%02lu descriptors ready per call\n",
+	       calls, ready / calls, ready * 100 / calls % 100);
+	printf("pollbench: %lu context switches, %lu per 1000 messages\n",
+	       csw, csw * 1000 / total);
+	return 0;
+}
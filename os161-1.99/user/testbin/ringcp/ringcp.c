@@ -0,0 +1,314 @@
+/*
+ * ringcp - copy lots of small files, with or without the syscall ring.
+ *
+ * Usage: ringcp [-r] [files] [size]
+ *
+ * Makes FILES (default 64) source files of SIZE (default 512) bytes
+ * each, then times copying every one of them to a new file the way
+ * cp does: open both, read, write, close both. Plain mode makes each
+ * of those its own system call. With -r, they're queued on a syscall
+ * ring (see aring.h) instead and run a stage at a time for up to
+ * GROUP files: all the opens with one aring_enter, then all the reads,
+ * the writes, and the closes. Prints the copy rate and how many
+ * traps into the kernel each file took. The copies are checked
+ * afterwards.
+ *
+ * There's no remove, so the files (ringcp.s* and ringcp.d*) are left
+ * behind and reused by the next run.
+ */
+
+#include <sys/types.h>
+#include <aring.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+
+#define MAXFILES	256
+#define MAXSIZE		1024
+#define DEFAULT_FILES	64
+#define DEFAULT_SIZE	512
+
+/* Files per stage: two descriptors each must fit under OPEN_MAX */
+#define GROUP		32
+#define ENTRIES		(2 * GROUP)
+
+static char srcnames[MAXFILES][16];
+static char dstnames[MAXFILES][16];
+static char bufs[GROUP][MAXSIZE];
+static char check[MAXSIZE];
+
+static struct aring ring;
+static struct aring_sqe sq[ENTRIES];
+static struct aring_cqe cq[ENTRIES];
+static int results[ENTRIES];
+
+/* system calls made during the copy */
+static unsigned long traps;
+
+static
+void
+fill(char *buf, unsigned file, unsigned size)
+{
+	unsigned i;
+
+	for (i=0; i<size; i++) {
+		buf[i] = 'a' + (file + i) % 26;
+	}
+}
+
+static
+void
+makefiles(unsigned nfiles, unsigned size)
+{
+	unsigned i;
+	int fd;
+
+	for (i=0; i<nfiles; i++) {
+		snprintf(srcnames[i], sizeof(srcnames[i]), "ringcp.s%u", i);
+		snprintf(dstnames[i], sizeof(dstnames[i]), "ringcp.d%u", i);
+		fd = open(srcnames[i], O_WRONLY|O_CREAT|O_TRUNC, 0664);
+		if (fd < 0) {
+			err(1, "%s", srcnames[i]);
+		}
+		fill(check, i, size);
+		if (write(fd, check, size) != (int)size) {
+			err(1, "%s: write", srcnames[i]);
+		}
+		close(fd);
+	}
+}
+
+static
+void
+checkfiles(unsigned nfiles, unsigned size)
+{
+	unsigned i;
+	int fd, r;
+
+	for (i=0; i<nfiles; i++) {
+		fd = open(dstnames[i], O_RDONLY);
+		if (fd < 0) {
+			err(1, "%s", dstnames[i]);
+		}
+		r = read(fd, bufs[0], MAXSIZE);
+		if (r != (int)size) {
+			errx(1, "%s: read %d bytes, expected %u", dstnames[i],
+			     r, size);
+		}
+		fill(check, i, size);
+		if (memcmp(bufs[0], check, size) != 0) {
+			errx(1, "%s: wrong contents", dstnames[i]);
+		}
+		close(fd);
+	}
+}
+
+/*
+ * The cp way.
+ */
+static
+void
+plaincopy(unsigned nfiles)
+{
+	unsigned i;
+	int from, to, len;
+
+	for (i=0; i<nfiles; i++) {
+		from = open(srcnames[i], O_RDONLY);
+		to = open(dstnames[i], O_WRONLY|O_CREAT|O_TRUNC, 0664);
+		traps += 2;
+		if (from < 0 || to < 0) {
+			err(1, "open");
+		}
+		len = read(from, bufs[0], MAXSIZE);
+		traps++;
+		if (len < 0) {
+			err(1, "%s: read", srcnames[i]);
+		}
+		if (write(to, bufs[0], len) != len) {
+			err(1, "%s: write", dstnames[i]);
+		}
+		close(from);
+		close(to);
+		traps += 3;
+	}
+}
+
+/*
+ * Queue an entry, tagged with its index in this stage.
+ */
+static
+void
+queue(unsigned op, int fd, void *buf, unsigned len, unsigned mode)
+{
+	struct aring_sqe *sqe;
+	unsigned n;
+
+	n = ring.ar_sqtail - ring.ar_sqhead;
+	sqe = &sq[ring.ar_sqtail % ENTRIES];
+	sqe->sqe_data = n;
+	sqe->sqe_off = 0;
+	sqe->sqe_buf = buf;
+	sqe->sqe_len = len;
+	sqe->sqe_fd = fd;
+	sqe->sqe_op = op;
+	sqe->sqe_flags = 0;
+	sqe->sqe_mode = mode;
+	ring.ar_sqtail++;
+}
+
+/*
+ * Run everything queued and put each result in results[], failing
+ * if any of them did.
+ */
+static
+void
+runstage(const char *what)
+{
+	struct aring_cqe *cqe;
+	unsigned n, i;
+	int r;
+
+	n = ring.ar_sqtail - ring.ar_sqhead;
+	while (ring.ar_sqhead != ring.ar_sqtail) {
+		r = aring_enter(ring.ar_sqtail - ring.ar_sqhead);
+		traps++;
+		if (r < 0) {
+			err(1, "aring_enter");
+		}
+		while (ring.ar_cqhead != ring.ar_cqtail) {
+			cqe = &cq[ring.ar_cqhead % ENTRIES];
+			if (cqe->cqe_data >= n) {
+				errx(1, "%s: bogus completion", what);
+			}
+			results[cqe->cqe_data] = cqe->cqe_res;
+			ring.ar_cqhead++;
+		}
+	}
+	for (i=0; i<n; i++) {
+		if (results[i] < 0) {
+			errno = -results[i];
+			err(1, "%s", what);
+		}
+	}
+}
+
+/*
+ * The ring way, GROUP files at a time.
+ */
+static
+void
+ringcopy(unsigned nfiles)
+{
+	int fds[2 * GROUP], lens[GROUP];
+	unsigned first, n, i;
+
+	if (aring_setup(&ring, sq, cq, ENTRIES) < 0) {
+		err(1, "aring_setup");
+	}
+	traps++;
+
+	for (first = 0; first < nfiles; first += n) {
+		n = nfiles - first;
+		if (n > GROUP) {
+			n = GROUP;
+		}
+
+		for (i=0; i<n; i++) {
+			queue(ARING_OP_OPEN, -1, srcnames[first + i],
+			      O_RDONLY, 0);
+			queue(ARING_OP_OPEN, -1, dstnames[first + i],
+			      O_WRONLY|O_CREAT|O_TRUNC, 0664);
+		}
+		runstage("open");
+		for (i=0; i<2*n; i++) {
+			fds[i] = results[i];
+		}
+
+		for (i=0; i<n; i++) {
+			queue(ARING_OP_READ, fds[2*i], bufs[i], MAXSIZE, 0);
+		}
+		runstage("read");
+		for (i=0; i<n; i++) {
+			lens[i] = results[i];
+		}
+
+		for (i=0; i<n; i++) {
+			queue(ARING_OP_WRITE, fds[2*i+1], bufs[i], lens[i], 0);
+		}
+		runstage("write");
+		for (i=0; i<n; i++) {
+			if (results[i] != lens[i]) {
+				errx(1, "%s: short write", dstnames[first + i]);
+			}
+		}
+
+		for (i=0; i<2*n; i++) {
+			queue(ARING_OP_CLOSE, fds[i], NULL, 0, 0);
+		}
+		runstage("close");
+	}
+
+	aring_setup(NULL, NULL, NULL, 0);
+	traps++;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned nfiles, size;
+	int usering = 0;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	unsigned long long nsecs, rate;
+
+	nfiles = DEFAULT_FILES;
+	size = DEFAULT_SIZE;
+	if (argc > 1 && !strcmp(argv[1], "-r")) {
+		usering = 1;
+		argc--;
+		argv++;
+	}
+	if (argc > 1) {
+		nfiles = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		size = atoi(argv[2]);
+	}
+	if (argc > 3 || nfiles == 0 || nfiles > MAXFILES || size > MAXSIZE) {
+		errx(1, "Usage: ringcp [-r] [files (max %d)] [size (max %d)]",
+		     MAXFILES, MAXSIZE);
+	}
+
+	makefiles(nfiles, size);
+
+	__time(&s0, &ns0);
+	if (usering) {
+		ringcopy(nfiles);
+	}
+	else {
+		plaincopy(nfiles);
+	}
+	__time(&s1, &ns1);
+
+	checkfiles(nfiles, size);
+
+	nsecs = (s1 - s0) * 1000000000ULL + ns1 - ns0;
+	rate = 0;
+	if (nsecs > 0) {
+		rate = nfiles * 1000000000ULL / nsecs;
+	}
+
+	printf("ringcp: %u files of %u bytes %s in %lu.%09lu seconds\n",
+	       nfiles, size, usering ? "with the ring" : "one call at a time",
+	       (unsigned long)(nsecs / 1000000000ULL),
+	       (unsigned long)(nsecs % 1000000000ULL));
+	printf("ringcp: %lu files/s\n", (unsigned long)rate);
+	printf("ringcp: %lu system calls, %lu.%02lu per file\n", traps,
+	       traps / nfiles, traps * 100 / nfiles % 100);
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * rwvtest - check pread, pwrite, readv and writev.
+ *
+ * Usage: rwvtest
+ *
+ * Writes a small file (rwvtest.dat; there's no remove, so it's left
+ * behind) with writev and checks that:
+ *   - writev gathers its buffers in order and moves the seek position;
+ *   - readv scatters the data back over its buffers, and comes up
+ *     short when the file ends first;
+ *   - pread and pwrite work at the position they're given and leave
+ *     the seek position alone; pread across the end of the file comes
+ *     up short, and at the end reads nothing;
+ *   - readv and writev fail with EINVAL for a negative, zero, or too
+ *     large buffer count, and pread on a pipe fails with ESPIPE.
+ *
+ * Stops at the first thing that's wrong; prints "passed" otherwise.
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+#define TESTFILE	"rwvtest.dat"
+#define PART1		"The quick brown fox "
+#define PART2		"jumps over "
+#define PART3		"the lazy dog."
+#define TESTDATA	PART1 PART2 PART3
+#define TESTLEN		((int)sizeof(TESTDATA) - 1)
+
+static
+void
+setiov(struct iovec *iov, const void *buf, size_t len)
+{
+	/* writev won't write to it, whatever the type says */
+	iov->iov_base = (void *)buf;
+	iov->iov_len = len;
+}
+
+static
+off_t
+where(int fd)
+{
+	off_t pos;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos < 0) {
+		err(1, "lseek");
+	}
+	return pos;
+}
+
+static
+void
+checkcount(const char *what, ssize_t got, int expected)
+{
+	if (got < 0) {
+		err(1, "%s", what);
+	}
+	if (got != expected) {
+		errx(1, "%s: got %d bytes, expected %d", what, (int)got,
+		     expected);
+	}
+}
+
+static
+void
+checkpos(const char *what, int fd, off_t expected)
+{
+	off_t pos;
+
+	pos = where(fd);
+	if (pos != expected) {
+		errx(1, "%s: seek position is %d, expected %d", what,
+		     (int)pos, (int)expected);
+	}
+}
+
+static
+void
+checkerr(const char *what, ssize_t r, int expected)
+{
+	if (r >= 0) {
+		errx(1, "%s: succeeded, expected %s", what,
+		     strerror(expected));
+	}
+	if (errno != expected) {
+		err(1, "%s: expected %s, got", what, strerror(expected));
+	}
+}
+
+static
+void
+testwritev(int fd)
+{
+	struct iovec iov[3];
+
+	setiov(&iov[0], PART1, strlen(PART1));
+	setiov(&iov[1], PART2, strlen(PART2));
+	setiov(&iov[2], PART3, strlen(PART3));
+	checkcount("writev", writev(fd, iov, 3), TESTLEN);
+	checkpos("writev", fd, TESTLEN);
+}
+
+static
+void
+testreadv(int fd)
+{
+	char a[10], b[10], c[TESTLEN];
+	struct iovec iov[3];
+
+	/* Room for more than there is: the last buffer is only partly used */
+	memset(c, 0, sizeof(c));
+	setiov(&iov[0], a, sizeof(a));
+	setiov(&iov[1], b, sizeof(b));
+	setiov(&iov[2], c, sizeof(c));
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		err(1, "lseek");
+	}
+	checkcount("readv", readv(fd, iov, 3), TESTLEN);
+	if (memcmp(a, TESTDATA, 10) != 0 ||
+	    memcmp(b, TESTDATA + 10, 10) != 0 ||
+	    memcmp(c, TESTDATA + 20, TESTLEN - 20) != 0) {
+		errx(1, "readv: data came back wrong");
+	}
+	checkpos("readv", fd, TESTLEN);
+
+	/* and at the end, nothing */
+	checkcount("readv at end of file", readv(fd, iov, 3), 0);
+}
+
+static
+void
+testpread(int fd)
+{
+	char buf[TESTLEN];
+	off_t pos;
+
+	/* Leave the seek position somewhere recognizable */
+	pos = lseek(fd, 5, SEEK_SET);
+	if (pos != 5) {
+		err(1, "lseek");
+	}
+
+	checkcount("pread", pread(fd, buf, 9, 4), 9);
+	if (memcmp(buf, TESTDATA + 4, 9) != 0) {
+		errx(1, "pread: data came back wrong");
+	}
+	checkpos("pread", fd, 5);
+
+	checkcount("pread across end of file",
+		   pread(fd, buf, sizeof(buf), TESTLEN - 4), 4);
+	if (memcmp(buf, TESTDATA + TESTLEN - 4, 4) != 0) {
+		errx(1, "pread across end of file: data came back wrong");
+	}
+	checkcount("pread at end of file",
+		   pread(fd, buf, sizeof(buf), TESTLEN), 0);
+	checkpos("pread at end of file", fd, 5);
+
+	checkerr("pread at negative position", pread(fd, buf, 1, -1),
+		 EINVAL);
+}
+
+static
+void
+testpwrite(int fd)
+{
+	char buf[TESTLEN];
+
+	checkcount("pwrite", pwrite(fd, "QUICK", 5, 4), 5);
+	checkpos("pwrite", fd, 5);
+	checkcount("pread after pwrite", pread(fd, buf, TESTLEN, 0), TESTLEN);
+	if (memcmp(buf, "The QUICK brown", 15) != 0 ||
+	    memcmp(buf + 15, TESTDATA + 15, TESTLEN - 15) != 0) {
+		errx(1, "pwrite: file contents wrong afterwards");
+	}
+}
+
+static
+void
+testerrors(int fd)
+{
+	char buf[4];
+	struct iovec iov[1];
+	int fds[2];
+
+	setiov(&iov[0], buf, sizeof(buf));
+	checkerr("readv with -1 buffers", readv(fd, iov, -1), EINVAL);
+	checkerr("writev with -1 buffers", writev(fd, iov, -1), EINVAL);
+	checkerr("readv with 0 buffers", readv(fd, iov, 0), EINVAL);
+	/* the count is checked before the array is looked at */
+	checkerr("readv with IOV_MAX+1 buffers", readv(fd, iov, IOV_MAX + 1),
+		 EINVAL);
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	checkerr("pread on a pipe", pread(fds[0], buf, sizeof(buf), 0),
+		 ESPIPE);
+	checkerr("pwrite on a pipe", pwrite(fds[1], buf, sizeof(buf), 0),
+		 ESPIPE);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int
+main(void)
+{
+	int fd;
+
+	fd = open(TESTFILE, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+
+	testwritev(fd);
+	testreadv(fd);
+	testpread(fd);
+	testpwrite(fd);
+	testerrors(fd);
+
+	close(fd);
+	printf("rwvtest: passed\n");
+	return 0;
+}
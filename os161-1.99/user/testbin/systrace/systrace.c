@@ -0,0 +1,227 @@
+/*
+ * systrace - run a program and show the system calls it makes.
+ *
+ * Usage: systrace [-s] program [args...]
+ *
+ * Needs a kernel built with options systrace. Forks; the child turns
+ * on tracing for itself through the systrace: device and execs the
+ * program, and the parent reads trace records off the device until
+ * the child has exited, printing one line per call: pid, call,
+ * arguments, result and time taken. Anything the program forks is
+ * traced too.
+ *
+ * The kernel only keeps so many records, and the parent polls for
+ * them rather than sleeping, so a busy program can outrun it; the
+ * number dropped is printed at the end.
+ *
+ * With -s, also zeroes the kernel's per-call statistics first and
+ * prints them afterwards. Those count every process, not just the
+ * one being traced.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <kern/syscall.h>
+#include <kern/systrace.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <err.h>
+
+/* Names for the calls the kernel implements; others print as numbers. */
+static const struct {
+	unsigned callno;
+	const char *name;
+} names[] = {
+	{ SYS_fork,		"fork" },
+	{ SYS_vfork,		"vfork" },
+	{ SYS_execv,		"execv" },
+	{ SYS_waitpid,		"waitpid" },
+	{ SYS_getpid,		"getpid" },
+	{ SYS_wait4,		"wait4" },
+	{ SYS_getrusage,	"getrusage" },
+	{ SYS_open,		"open" },
+	{ SYS_pipe,		"pipe" },
+	{ SYS_dup2,		"dup2" },
+	{ SYS_close,		"close" },
+	{ SYS_read,		"read" },
+	{ SYS_pread,		"pread" },
+	{ SYS_readv,		"readv" },
+	{ SYS_write,		"write" },
+	{ SYS_pwrite,		"pwrite" },
+	{ SYS_writev,		"writev" },
+	{ SYS_lseek,		"lseek" },
+	{ SYS_fsync,		"fsync" },
+	{ SYS_ioctl,		"ioctl" },
+	{ SYS_select,		"select" },
+	{ SYS_poll,		"poll" },
+	{ SYS___time,		"__time" },
+	{ SYS_reboot,		"reboot" },
+	{ SYS_setaffinity,	"setaffinity" },
+	{ SYS_futex_wait,	"futex_wait" },
+	{ SYS_futex_wake,	"futex_wake" },
+	{ SYS_aring_setup,	"aring_setup" },
+	{ SYS_aring_enter,	"aring_enter" },
+};
+
+static struct systrace_stat stats[SYSTRACE_NSYS];
+
+static
+const char *
+callname(unsigned callno)
+{
+	static char buf[16];
+	unsigned i;
+
+	for (i=0; i<sizeof(names)/sizeof(names[0]); i++) {
+		if (names[i].callno == callno) {
+			return names[i].name;
+		}
+	}
+	snprintf(buf, sizeof(buf), "#%u", callno);
+	return buf;
+}
+
+static
+void
+printrec(const struct systrace_rec *sr)
+{
+	printf("%5d %-11s (0x%x, 0x%x, 0x%x, 0x%x) = ",
+	       (int)sr->sr_pid, callname(sr->sr_callno),
+	       sr->sr_args[0], sr->sr_args[1], sr->sr_args[2],
+	       sr->sr_args[3]);
+	if (sr->sr_error != 0) {
+		printf("-1 %s", strerror(sr->sr_error));
+	}
+	else {
+		printf("%d", (int)sr->sr_retval);
+	}
+	printf(" <%u ns>\n", sr->sr_nsecs);
+}
+
+/*
+ * Print whatever records the kernel has. Returns how many there were.
+ */
+static
+unsigned
+drain(int fd)
+{
+	struct systrace_rec recs[32];
+	unsigned i, n, total;
+	int r;
+
+	total = 0;
+	do {
+		r = read(fd, recs, sizeof(recs));
+		if (r < 0) {
+			err(1, "systrace: read");
+		}
+		n = r / sizeof(recs[0]);
+		for (i=0; i<n; i++) {
+			printrec(&recs[i]);
+		}
+		total += n;
+	} while (n > 0);
+	return total;
+}
+
+static
+void
+printstats(int fd)
+{
+	unsigned n;
+
+	if (ioctl(fd, SYSTRACE_IOC_STATS, stats) < 0) {
+		err(1, "systrace: SYSTRACE_IOC_STATS");
+	}
+	printf("%-12s %10s %8s %12s %10s\n",
+	       "call", "count", "errors", "mean(ns)", "max(ns)");
+	for (n=0; n<SYSTRACE_NSYS; n++) {
+		if (stats[n].ss_count == 0) {
+			continue;
+		}
+		printf("%-12s %10u %8u %12llu %10llu\n", callname(n),
+		       stats[n].ss_count, stats[n].ss_errors,
+		       stats[n].ss_totalns / stats[n].ss_count,
+		       stats[n].ss_maxns);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct systrace_rec junk[32];
+	int fd, status, showstats = 0;
+	unsigned lost, count;
+	pid_t pid, r;
+
+	if (argc > 1 && !strcmp(argv[1], "-s")) {
+		showstats = 1;
+		argc--;
+		argv++;
+	}
+	if (argc < 2) {
+		errx(1, "Usage: systrace [-s] program [args...]");
+	}
+
+	fd = open("systrace:", O_RDONLY);
+	if (fd < 0) {
+		err(1, "systrace:");
+	}
+
+	/* throw away anything left over from before */
+	while (read(fd, junk, sizeof(junk)) > 0) {
+		/* nothing */
+	}
+	if (ioctl(fd, SYSTRACE_IOC_LOST, &lost) < 0) {
+		err(1, "systrace: SYSTRACE_IOC_LOST");
+	}
+	if (showstats && ioctl(fd, SYSTRACE_IOC_RESET, NULL) < 0) {
+		err(1, "systrace: SYSTRACE_IOC_RESET");
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		if (ioctl(fd, SYSTRACE_IOC_TRACE, NULL) < 0) {
+			err(1, "systrace: SYSTRACE_IOC_TRACE");
+		}
+		close(fd);
+		execv(argv[1], argv + 1);
+		err(1, "%s", argv[1]);
+	}
+
+	count = 0;
+	do {
+		count += drain(fd);
+		r = waitpid(pid, &status, WNOHANG);
+		if (r < 0) {
+			err(1, "waitpid");
+		}
+	} while (r == 0);
+	/* and whatever came in while we weren't looking */
+	count += drain(fd);
+
+	if (ioctl(fd, SYSTRACE_IOC_LOST, &lost) < 0) {
+		err(1, "systrace: SYSTRACE_IOC_LOST");
+	}
+	printf("systrace: %u calls traced, %u lost\n", count, lost);
+	if (WIFEXITED(status)) {
+		printf("systrace: %s exited with status %d\n", argv[1],
+		       WEXITSTATUS(status));
+	}
+	else {
+		printf("systrace: %s exited with wait status %d\n", argv[1],
+		       status);
+	}
+
+	if (showstats) {
+		printstats(fd);
+	}
+	close(fd);
+	return 0;
+}
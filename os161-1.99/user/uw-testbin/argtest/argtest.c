@@ -4,9 +4,97 @@
  *
  * Intended for the basic system calls assignment. This may help
  * debugging the argument handling of execv().
+ *
+ * It doubles as an exec benchmark: "argtest -x COUNT [args...]" execs
+ * itself COUNT times in a row, passing the arguments along each time,
+ * and then displays them as usual, along with the time per exec.
+ * (Run it by its full path, since it execs argv[0].)
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+/*
+ * While the chain is running, the arguments are
+ *    argv[0] -X LEFT COUNT SECS NSECS args...
+ * where SECS.NSECS is when it started.
+ */
+#define CHAIN_ARGS 5
+
+static char leftbuf[16], secbuf[16], nsecbuf[16];
+
+/* "-x COUNT args...": start the chain */
+static
+void
+chainstart(int argc, char *argv[])
+{
+	char **nargv;
+	time_t secs;
+	unsigned long nsecs;
+	int count, i;
+
+	if (argc < 3 || (count = atoi(argv[2])) < 1) {
+		errx(1, "Usage: %s -x COUNT [args...]", argv[0]);
+	}
+
+	nargv = malloc((argc + CHAIN_ARGS - 2 + 1) * sizeof(char *));
+	if (nargv == NULL) {
+		err(1, "malloc");
+	}
+
+	__time(&secs, &nsecs);
+	snprintf(leftbuf, sizeof(leftbuf), "%d", count - 1);
+	snprintf(secbuf, sizeof(secbuf), "%lu", (unsigned long)secs);
+	snprintf(nsecbuf, sizeof(nsecbuf), "%lu", nsecs);
+
+	nargv[0] = argv[0];
+	nargv[1] = (char *)"-X";
+	nargv[2] = leftbuf;
+	nargv[3] = argv[2];
+	nargv[4] = secbuf;
+	nargv[5] = nsecbuf;
+	for (i=3; i<=argc; i++) {
+		nargv[i + CHAIN_ARGS - 2] = argv[i];
+	}
+
+	execv(nargv[0], nargv);
+	err(1, "%s", nargv[0]);
+}
+
+/* "-X ...": exec again, or, at the end, report the time */
+static
+void
+chainnext(int argc, char *argv[])
+{
+	time_t secs;
+	unsigned long nsecs;
+	unsigned long long ns;
+	int left, count;
+
+	if (argc <= CHAIN_ARGS) {
+		errx(1, "%s: bad -X arguments", argv[0]);
+	}
+
+	left = atoi(argv[2]);
+	if (left > 0) {
+		snprintf(leftbuf, sizeof(leftbuf), "%d", left - 1);
+		argv[2] = leftbuf;
+		execv(argv[0], argv);
+		err(1, "%s", argv[0]);
+	}
+
+	__time(&secs, &nsecs);
+	count = atoi(argv[3]);
+	ns = (secs - atoi(argv[4])) * 1000000000ULL
+		+ nsecs - atoi(argv[5]);
+	printf("%d execs in %lu.%09lu seconds, %lu ns per exec\n\n", count,
+	       (unsigned long)(ns / 1000000000ULL),
+	       (unsigned long)(ns % 1000000000ULL),
+	       (unsigned long)(ns / count));
+}
 
 int
 main(int argc, char *argv[])
@@ -14,6 +102,17 @@ main(int argc, char *argv[])
 	const char *tmp;
 	int i;
 
+	if (argc > 1 && !strcmp(argv[1], "-x")) {
+		chainstart(argc, argv);
+	}
+	else if (argc > 1 && !strcmp(argv[1], "-X")) {
+		chainnext(argc, argv);
+		/* now show the arguments that were passed along */
+		argv[CHAIN_ARGS] = argv[0];
+		argv += CHAIN_ARGS;
+		argc -= CHAIN_ARGS;
+	}
+
 	printf("argc   : %d\n", argc);
 	printf("&tmp   : %p\n", &tmp);
 	printf("&i     : %p\n", &i);
@@ -5,15 +5,21 @@
  *
  *   relies on fork, execv
  *
+ *   argtesttest COUNT has /uw-testbin/argtest exec itself COUNT
+ *   times with the same arguments and waits for it, to measure
+ *   exec throughput (see argtest)
+ *
  */
 
 #include <unistd.h>
+#include <stdlib.h>
 #include <err.h>
 
 static char *xargv[4] = { (char *)"argtesttest", (char *)"first", (char *)"second", NULL };
+static char *bargv[6] = { (char *)"/uw-testbin/argtest", (char *)"-x", NULL, (char *)"first", (char *)"second", NULL };
 
 static
-void
+pid_t
 spawnv(const char *prog, char **argv)
 {
   pid_t pid = fork();
@@ -28,11 +34,24 @@ spawnv(const char *prog, char **argv)
     /* parent */
     break;
   }
+  return pid;
 }
 
 int
-main()
+main(int argc, char *argv[])
 {
+  int status;
+
+  if (argc > 1) {
+    if (atoi(argv[1]) < 1) {
+      errx(1, "Usage: argtesttest [count]");
+    }
+    bargv[2] = argv[1];
+    if (waitpid(spawnv(bargv[0], bargv), &status, 0) < 0) {
+      err(1, "waitpid");
+    }
+    return 0;
+  }
   spawnv("/testbin/argtest", xargv);
   return 0;
 }
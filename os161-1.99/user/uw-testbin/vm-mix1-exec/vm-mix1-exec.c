@@ -1,14 +1,69 @@
+/*
+ * vm-mix1-exec [count]
+ *
+ *   exec vm-mix1; given a COUNT, first exec this program COUNT
+ *   times in a row and report the time per exec, as an exec
+ *   throughput benchmark (run it by a path that works from
+ *   where it's started, since it execs argv[0])
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <err.h>
 
 static char *argv[2] = { (char *)"vm-mix1", NULL };
 
+/* while counting down: argv[0] LEFT COUNT SECS NSECS */
+static char leftbuf[16], secbuf[16], nsecbuf[16];
+static char *xargv[6];
+
 int
-main()
+main(int xargc, char *xargvin[])
 {
+   time_t secs;
+   unsigned long nsecs;
+   unsigned long long ns;
+   int left, count;
+
+   if (xargc == 2) {
+      /* start */
+      count = atoi(xargvin[1]);
+      if (count < 1) {
+         errx(1, "Usage: vm-mix1-exec [count]");
+      }
+      __time(&secs, &nsecs);
+      snprintf(leftbuf, sizeof(leftbuf), "%d", count - 1);
+      snprintf(secbuf, sizeof(secbuf), "%lu", (unsigned long)secs);
+      snprintf(nsecbuf, sizeof(nsecbuf), "%lu", nsecs);
+      xargv[0] = xargvin[0];
+      xargv[1] = leftbuf;
+      xargv[2] = xargvin[1];
+      xargv[3] = secbuf;
+      xargv[4] = nsecbuf;
+      xargv[5] = NULL;
+      execv(xargv[0], xargv);
+      err(1, "%s", xargv[0]);
+   }
+   else if (xargc == 5) {
+      left = atoi(xargvin[1]);
+      if (left > 0) {
+         snprintf(leftbuf, sizeof(leftbuf), "%d", left - 1);
+         xargvin[1] = leftbuf;
+         execv(xargvin[0], xargvin);
+         err(1, "%s", xargvin[0]);
+      }
+      __time(&secs, &nsecs);
+      count = atoi(xargvin[2]);
+      ns = (secs - atoi(xargvin[3])) * 1000000000ULL
+         + nsecs - atoi(xargvin[4]);
+      printf("%d execs in %lu.%09lu seconds, %lu ns per exec\n", count,
+             (unsigned long)(ns / 1000000000ULL),
+             (unsigned long)(ns % 1000000000ULL),
+             (unsigned long)(ns / count));
+   }
+
    execv("vm-mix1/vm-mix1", argv);
    exit(0);
 }
-